@@ -0,0 +1,100 @@
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <prometheus/client_metric.h>
+#include <prometheus/metric_family.h>
+#include <prometheus/text_serializer.h>
+#include <zlib.h>
+
+static std::string GenerateScrape(std::size_t series) {
+  using prometheus::ClientMetric;
+  using prometheus::MetricFamily;
+  using prometheus::MetricType;
+
+  std::mt19937 generator{0};
+  std::uniform_real_distribution<double> distribution{0, 1e6};
+
+  MetricFamily family;
+  family.name = "benchmark_gauge";
+  family.help = "Gauge used for compression benchmarks";
+  family.type = MetricType::Gauge;
+  for (std::size_t i = 0; i < series; ++i) {
+    ClientMetric metric;
+    metric.label.push_back({"index", std::to_string(i)});
+    metric.gauge.value = distribution(generator);
+    family.metric.push_back(metric);
+  }
+  return prometheus::TextSerializer{}.Serialize({family});
+}
+
+static bool InitGZip(z_stream& zs, int level) {
+  return deflateInit2(&zs, level, Z_DEFLATED, 16 + MAX_WBITS, 9,
+                      Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+static std::size_t Compress(z_stream& zs, const std::string& input,
+                            std::vector<unsigned char>& output) {
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  zs.avail_in = static_cast<uInt>(input.size());
+  auto size = std::size_t{0};
+  do {
+    zs.next_out = output.data();
+    zs.avail_out = static_cast<uInt>(output.size());
+    deflate(&zs, Z_FINISH);
+    size += output.size() - zs.avail_out;
+  } while (zs.avail_out == 0);
+  return size;
+}
+
+static void BM_GZip_Level(benchmark::State& state) {
+  const auto input = GenerateScrape(10 * 1024);
+  std::vector<unsigned char> output(16 * 1024);
+  auto zs = z_stream{};
+  if (!InitGZip(zs, static_cast<int>(state.range(0)))) {
+    state.SkipWithError("deflateInit2 failed");
+    return;
+  }
+  auto compressed = std::size_t{0};
+
+  while (state.KeepRunning()) {
+    deflateReset(&zs);
+    compressed = Compress(zs, input, output);
+  }
+  deflateEnd(&zs);
+  state.SetBytesProcessed(state.iterations() * input.size());
+  state.counters["ratio"] =
+      static_cast<double>(input.size()) / static_cast<double>(compressed);
+}
+BENCHMARK(BM_GZip_Level)->DenseRange(0, 9);
+
+static void BM_GZip_InitPerScrape(benchmark::State& state) {
+  const auto input = GenerateScrape(state.range(0));
+  std::vector<unsigned char> output(16 * 1024);
+
+  while (state.KeepRunning()) {
+    auto zs = z_stream{};
+    InitGZip(zs, Z_DEFAULT_COMPRESSION);
+    benchmark::DoNotOptimize(Compress(zs, input, output));
+    deflateEnd(&zs);
+  }
+  state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_GZip_InitPerScrape)->Range(1, 16 * 1024);
+
+static void BM_GZip_ResetPerScrape(benchmark::State& state) {
+  const auto input = GenerateScrape(state.range(0));
+  std::vector<unsigned char> output(16 * 1024);
+  auto zs = z_stream{};
+  InitGZip(zs, Z_DEFAULT_COMPRESSION);
+
+  while (state.KeepRunning()) {
+    deflateReset(&zs);
+    benchmark::DoNotOptimize(Compress(zs, input, output));
+  }
+  deflateEnd(&zs);
+  state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_GZip_ResetPerScrape)->Range(1, 16 * 1024);
@@ -1,7 +1,9 @@
 #include <chrono>
+#include <string>
 
 #include <benchmark/benchmark.h>
 #include <prometheus/counter.h>
+#include <prometheus/name_filter.h>
 #include <prometheus/registry.h>
 
 #include "benchmark_helpers.h"
@@ -41,3 +43,25 @@ static void BM_Registry_CreateCounter(benchmark::State& state) {
   }
 }
 BENCHMARK(BM_Registry_CreateCounter)->Range(0, 4096);
+
+static void BM_Registry_CollectSelectedFamily(benchmark::State& state) {
+  using prometheus::BuildCounter;
+  using prometheus::NameFilter;
+  using prometheus::Registry;
+  Registry registry;
+  for (auto i = 0; i < state.range(0); ++i) {
+    auto& family = BuildCounter()
+                       .Name("benchmark_counter_" + std::to_string(i))
+                       .Help("")
+                       .Register(registry);
+    for (auto j = 0; j < 10; ++j) {
+      family.Add({{"index", std::to_string(j)}});
+    }
+  }
+  const NameFilter filter{{"benchmark_counter_0"}};
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(registry.CollectFiltered(filter));
+  }
+}
+BENCHMARK(BM_Registry_CollectSelectedFamily)->Range(1, 4096);
@@ -0,0 +1,91 @@
+#include <string>
+
+#include <benchmark/benchmark.h>
+#include <prometheus/counter.h>
+#include <prometheus/detail/arena.h>
+#include <prometheus/detail/thread_pool.h>
+#include <prometheus/registry.h>
+#include <prometheus/text_serializer.h>
+
+#include "benchmark_helpers.h"
+
+static void PopulateRegistry(prometheus::Registry& registry,
+                             std::size_t families,
+                             std::size_t series_per_family) {
+  using prometheus::BuildCounter;
+  for (std::size_t i = 0; i < families; ++i) {
+    auto& family = BuildCounter()
+                       .Name("benchmark_counter_" + std::to_string(i))
+                       .Help("Counter used for scrape benchmarks")
+                       .Register(registry);
+    for (std::size_t j = 0; j < series_per_family; ++j) {
+      family.Add(GenerateRandomLabels(3)).Increment(j);
+    }
+  }
+}
+
+static void BM_Scrape_Sequential(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::TextSerializer;
+  Registry registry;
+  PopulateRegistry(registry, 64, state.range(0));
+  TextSerializer serializer;
+
+  while (state.KeepRunning()) {
+    auto metrics = registry.Collect();
+    benchmark::DoNotOptimize(serializer.Serialize(metrics));
+  }
+}
+BENCHMARK(BM_Scrape_Sequential)->Arg(16)->Arg(1024)->UseRealTime();
+
+static void BM_Scrape_Streaming(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::TextSerializer;
+  Registry registry;
+  PopulateRegistry(registry, 64, state.range(0));
+  TextSerializer serializer;
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(serializer.Serialize(registry));
+  }
+}
+BENCHMARK(BM_Scrape_Streaming)->Arg(16)->Arg(1024)->UseRealTime();
+
+static void BM_Scrape_StreamingIntoArena(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::TextSerializer;
+  using prometheus::detail::Arena;
+  using prometheus::detail::ArenaOutputBuffer;
+  Registry registry;
+  PopulateRegistry(registry, 64, state.range(0));
+  TextSerializer serializer;
+  Arena arena;
+
+  while (state.KeepRunning()) {
+    {
+      ArenaOutputBuffer body{arena};
+      serializer.Serialize(body, registry);
+      benchmark::DoNotOptimize(body.GetSize());
+    }
+    arena.Reset();
+  }
+}
+BENCHMARK(BM_Scrape_StreamingIntoArena)->Arg(16)->Arg(1024)->UseRealTime();
+
+static void BM_Scrape_Concurrent(benchmark::State& state) {
+  using prometheus::Registry;
+  using prometheus::TextSerializer;
+  using prometheus::detail::ThreadPool;
+  Registry registry;
+  PopulateRegistry(registry, 64, state.range(0));
+  TextSerializer serializer;
+  ThreadPool pool{static_cast<std::size_t>(state.range(1))};
+
+  while (state.KeepRunning()) {
+    auto metrics = registry.CollectConcurrently(pool);
+    benchmark::DoNotOptimize(serializer.Serialize(metrics, pool));
+  }
+}
+BENCHMARK(BM_Scrape_Concurrent)
+    ->Ranges({{16, 1024}, {1, 8}})
+    ->UseRealTime();
@@ -0,0 +1,79 @@
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <prometheus/client_metric.h>
+#include <prometheus/metric_family.h>
+#include <prometheus/output_buffer.h>
+#include <prometheus/protobuf_serializer.h>
+#include <prometheus/text_serializer.h>
+
+static std::vector<prometheus::MetricFamily> GenerateGauges(
+    std::size_t series) {
+  using prometheus::ClientMetric;
+  using prometheus::MetricFamily;
+  using prometheus::MetricType;
+
+  std::mt19937 generator{0};
+  std::uniform_real_distribution<double> distribution{0, 1e6};
+
+  MetricFamily family;
+  family.name = "benchmark_gauge";
+  family.help = "Gauge used for serializer benchmarks";
+  family.type = MetricType::Gauge;
+  for (std::size_t i = 0; i < series; ++i) {
+    ClientMetric metric;
+    metric.label.push_back({"index", std::to_string(i)});
+    metric.gauge.value = distribution(generator);
+    family.metric.push_back(metric);
+  }
+  return {family};
+}
+
+static void BM_TextSerializer_Gauges(benchmark::State& state) {
+  using prometheus::TextSerializer;
+  const auto families = GenerateGauges(state.range(0));
+  TextSerializer serializer;
+
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(serializer.Serialize(families));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TextSerializer_Gauges)->Range(1, 64 * 1024);
+
+static void BM_TextSerializer_GaugesIntoBuffer(benchmark::State& state) {
+  using prometheus::StringOutputBuffer;
+  using prometheus::TextSerializer;
+  const auto families = GenerateGauges(state.range(0));
+  TextSerializer serializer;
+  StringOutputBuffer buffer;
+
+  while (state.KeepRunning()) {
+    buffer.Clear();
+    serializer.Serialize(buffer, families);
+    benchmark::DoNotOptimize(buffer.GetData());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TextSerializer_GaugesIntoBuffer)->Range(1, 64 * 1024);
+
+static void BM_ProtobufSerializer_GaugesIntoBuffer(benchmark::State& state) {
+  using prometheus::ProtobufSerializer;
+  using prometheus::StringOutputBuffer;
+  const auto families = GenerateGauges(state.range(0));
+  ProtobufSerializer serializer;
+  StringOutputBuffer buffer;
+
+  while (state.KeepRunning()) {
+    buffer.Clear();
+    serializer.Serialize(buffer, families);
+    benchmark::DoNotOptimize(buffer.GetData());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.counters["bytes_per_series"] =
+      static_cast<double>(buffer.GetSize()) / state.range(0);
+}
+BENCHMARK(BM_ProtobufSerializer_GaugesIntoBuffer)->Range(1, 64 * 1024);
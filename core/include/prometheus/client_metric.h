@@ -30,6 +30,8 @@ struct PROMETHEUS_CPP_CORE_EXPORT ClientMetric {
 
   struct Counter {
     double value = 0.0;
+    // creation time in milliseconds since the Unix epoch, 0 if unknown
+    std::int64_t created_timestamp_ms = 0;
   };
   Counter counter;
 
@@ -51,6 +53,8 @@ struct PROMETHEUS_CPP_CORE_EXPORT ClientMetric {
     std::uint64_t sample_count = 0;
     double sample_sum = 0.0;
     std::vector<Quantile> quantile;
+    // creation time in milliseconds since the Unix epoch, 0 if unknown
+    std::int64_t created_timestamp_ms = 0;
   };
   Summary summary;
 
@@ -65,6 +69,8 @@ struct PROMETHEUS_CPP_CORE_EXPORT ClientMetric {
     std::uint64_t sample_count = 0;
     double sample_sum = 0.0;
     std::vector<Bucket> bucket;
+    // creation time in milliseconds since the Unix epoch, 0 if unknown
+    std::int64_t created_timestamp_ms = 0;
   };
   Histogram histogram;
 
@@ -6,7 +6,12 @@
 
 namespace prometheus {
 struct MetricFamily;
-}
+class MetricSink;
+class NameFilter;
+namespace detail {
+class ThreadPool;
+}  // namespace detail
+}  // namespace prometheus
 
 namespace prometheus {
 
@@ -20,6 +25,37 @@ class PROMETHEUS_CPP_CORE_EXPORT Collectable {
 
   /// \brief Returns a list of metrics and their samples.
   virtual std::vector<MetricFamily> Collect() const = 0;
+
+  /// \brief Returns a list of metrics and their samples, collecting
+  /// independent parts concurrently on the given pool.
+  ///
+  /// The result must be the same as the one of Collect(). The default
+  /// implementation ignores the pool and calls Collect().
+  virtual std::vector<MetricFamily> CollectConcurrently(
+      detail::ThreadPool& pool) const;
+
+  /// \brief Passes the metrics and their samples to the given sink.
+  ///
+  /// The sink must receive the same metrics as returned by Collect(). The
+  /// default implementation calls Collect() and forwards the result.
+  virtual void CollectTo(MetricSink& sink) const;
+
+  /// \brief Returns the metric families selected by the given filter and
+  /// their samples.
+  ///
+  /// Collectables should override it to skip the families which are not
+  /// selected. The default implementation calls Collect() and drops them
+  /// afterwards.
+  virtual std::vector<MetricFamily> CollectFiltered(
+      const NameFilter& filter) const;
+
+  /// \brief Passes the metric families selected by the given filter and
+  /// their samples to the given sink.
+  ///
+  /// The default implementation calls CollectTo() and drops the
+  /// families which are not selected.
+  virtual void CollectFilteredTo(MetricSink& sink,
+                                 const NameFilter& filter) const;
 };
 
 }  // namespace prometheus
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <cstdint>
+
 #include "prometheus/client_metric.h"
 #include "prometheus/detail/builder.h"
 #include "prometheus/detail/core_export.h"
 #include "prometheus/gauge.h"
+#include "prometheus/metric_sink.h"
 #include "prometheus/metric_type.h"
 
 namespace prometheus {
@@ -28,7 +31,7 @@ class PROMETHEUS_CPP_CORE_EXPORT Counter {
   static const MetricType metric_type{MetricType::Counter};
 
   /// \brief Create a counter that starts at 0.
-  Counter() = default;
+  Counter();
 
   /// \brief Increment the counter by 1.
   void Increment();
@@ -41,13 +44,23 @@ class PROMETHEUS_CPP_CORE_EXPORT Counter {
   /// \brief Get the current value of the counter.
   double Value() const;
 
+  /// \brief Get the time the counter was created in milliseconds since the
+  /// Unix epoch.
+  std::int64_t CreatedTimestampMs() const;
+
   /// \brief Get the current value of the counter.
   ///
   /// Collect is called by the Registry when collecting metrics.
   ClientMetric Collect() const;
 
+  /// \brief Pass the current value of the counter to the given sink.
+  ///
+  /// Collect is called by the Family when streaming metrics to a MetricSink.
+  void Collect(MetricSink& sink, const MetricSink::Series& series) const;
+
  private:
   Gauge gauge_{0.0};
+  const std::int64_t created_timestamp_ms_;
 };
 
 /// \brief Return a builder to configure and register a Counter metric.
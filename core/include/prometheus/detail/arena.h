@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "prometheus/detail/core_export.h"
+#include "prometheus/output_buffer.h"
+
+namespace prometheus {
+namespace detail {
+
+/// \brief Monotonic storage for the temporary data of a scrape.
+///
+/// Memory is handed out from large blocks and is only released as a whole by
+/// Reset(). Reset() keeps the blocks, so an arena reused for every scrape
+/// stops allocating once it has grown to the size of a scrape.
+///
+/// The class is not thread-safe.
+class PROMETHEUS_CPP_CORE_EXPORT Arena {
+ public:
+  /// \brief Create an arena which allocates blocks of at least the given size.
+  explicit Arena(std::size_t block_size = 64 * 1024);
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /// \brief Returns uninitialized memory of the given size.
+  ///
+  /// The memory is suitably aligned for any fundamental type and stays valid
+  /// until Reset() is called or the arena is destroyed.
+  void* Allocate(std::size_t size);
+
+  /// \brief Releases all memory handed out so far for reuse.
+  void Reset();
+
+  /// \brief Returns the number of bytes held by the arena.
+  std::size_t GetCapacity() const;
+
+ private:
+  struct Block {
+    std::unique_ptr<char[]> data;
+    std::size_t size;
+  };
+
+  std::vector<Block> blocks_;
+  std::size_t current_;
+  std::size_t offset_;
+  const std::size_t block_size_;
+};
+
+/// \brief An OutputBuffer which writes into a list of chunks allocated from
+/// an Arena.
+///
+/// The written data is never copied into a contiguous buffer. It stays valid
+/// until the arena is reset.
+class PROMETHEUS_CPP_CORE_EXPORT ArenaOutputBuffer : public OutputBuffer {
+ public:
+  explicit ArenaOutputBuffer(Arena& arena,
+                             std::size_t chunk_size = 16 * 1024);
+
+  /// \brief Returns the number of bytes written so far.
+  std::size_t GetSize() const;
+
+  /// \brief Calls the given function for each chunk of written data in order.
+  void ForEachChunk(
+      const std::function<void(const char* data, std::size_t size)>& function)
+      const;
+
+ protected:
+  void Grow(std::size_t min_size, std::size_t size) override;
+
+ private:
+  struct Chunk {
+    Chunk* next;
+    std::size_t size;
+  };
+
+  void Seal();
+  static char* GetData(const Chunk* chunk);
+
+  Arena& arena_;
+  const std::size_t chunk_size_;
+  Chunk* head_;
+  Chunk* tail_;
+  std::size_t sealed_size_;
+};
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "prometheus/detail/arena.h"
+#include "prometheus/detail/core_export.h"
+#include "prometheus/output_buffer.h"
+
+namespace prometheus {
+namespace detail {
+
+/// \brief A deflate stream producing gzip which is reused for many bodies.
+///
+/// Initializing zlib allocates several hundred kilobytes. The stream is
+/// reset instead for each body as long as the settings stay the same.
+///
+/// The class is not thread-safe.
+class PROMETHEUS_CPP_CORE_EXPORT GZipCompressor {
+ public:
+  GZipCompressor();
+  ~GZipCompressor();
+
+  GZipCompressor(const GZipCompressor&) = delete;
+  GZipCompressor& operator=(const GZipCompressor&) = delete;
+
+  /// \brief Prepares the stream to compress a new body.
+  ///
+  /// \param level The zlib compression level.
+  /// \param strategy The zlib compression strategy.
+  /// \return false if zlib failed or the library was built without
+  /// compression.
+  bool Start(int level, int strategy = 0);
+
+  /// \brief Returns the size of the current body before compression.
+  std::uint64_t GetTotalIn() const;
+
+  /// \brief Returns the size of the current body after compression.
+  std::uint64_t GetTotalOut() const;
+
+ private:
+  friend class GZipBuffer;
+
+  struct Stream;
+  std::unique_ptr<Stream> stream_;
+};
+
+/// \brief Compresses the data written to it and passes the compressed data to
+/// another buffer.
+///
+/// The given compressor has to be started and its body is finished by
+/// Finish(). The buffers are allocated from the given arena.
+class PROMETHEUS_CPP_CORE_EXPORT GZipBuffer : public OutputBuffer {
+ public:
+  /// \param deflate_time If not nullptr, the time spent compressing is added
+  /// to it. Writing the compressed data to out is not included.
+  GZipBuffer(GZipCompressor& compressor, OutputBuffer& out, Arena& arena,
+             std::chrono::steady_clock::duration* deflate_time = nullptr,
+             std::size_t buffer_size = 16 * 1024);
+
+  /// \brief Compresses the remaining data and finishes the body.
+  ///
+  /// \return false if compression failed.
+  bool Finish();
+
+ protected:
+  void Grow(std::size_t min_size, std::size_t size) override;
+
+ private:
+  int Deflate(int flush);
+
+  GZipCompressor::Stream& stream_;
+  OutputBuffer& out_;
+  Arena& arena_;
+  char* input_;
+  std::size_t input_size_;
+  char* output_;
+  std::size_t output_size_;
+  std::chrono::steady_clock::duration* deflate_time_;
+};
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "prometheus/detail/core_export.h"
+
+namespace prometheus {
+
+namespace detail {
+
+/// \brief Size of a buffer large enough for any number written by the
+/// functions below.
+constexpr std::size_t kNumberBufferSize = 32;
+
+/// \brief Write the shortest decimal representation of a finite double which
+/// parses back to the same value.
+///
+/// Uses the Grisu2 algorithm by Florian Loitsch. Integral values within
+/// 10^21 are written without fraction and exponent, e.g., 64 as "64", other
+/// values as decimal fraction or in scientific notation, e.g., "0.001",
+/// "1.5e-07" or "1e+21".
+///
+/// \param buffer Destination with room for at least kNumberBufferSize bytes.
+/// The result is not null-terminated.
+/// \param value The value to write. Must neither be infinite nor NaN.
+///
+/// \return The number of bytes written.
+PROMETHEUS_CPP_CORE_EXPORT std::size_t FormatDouble(char* buffer,
+                                                    double value);
+
+/// \brief Write the decimal representation of an unsigned integer.
+///
+/// \return The number of bytes written.
+PROMETHEUS_CPP_CORE_EXPORT std::size_t FormatUnsigned(char* buffer,
+                                                      std::uint64_t value);
+
+/// \brief Write the decimal representation of a signed integer.
+///
+/// \return The number of bytes written.
+PROMETHEUS_CPP_CORE_EXPORT std::size_t FormatSigned(char* buffer,
+                                                    std::int64_t value);
+
+}  // namespace detail
+
+}  // namespace prometheus
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "prometheus/output_buffer.h"
+
+namespace prometheus {
+
+namespace detail {
+
+/// \brief Encoding of protocol buffer fields, shared by the serializer of the
+/// exposition format and the remote write encoder.
+///
+/// All field numbers in use are below 16, so every tag fits into one byte.
+
+enum WireType : std::uint32_t {
+  kVarint = 0,
+  kFixed64 = 1,
+  kLengthDelimited = 2,
+};
+
+/// \brief Maximum number of bytes of a varint.
+constexpr std::size_t kMaxVarintSize = 10;
+
+/// \brief Size of a double field including its tag.
+constexpr std::size_t kDoubleFieldSize = 1 + 8;
+
+/// \brief Returns the number of bytes of the value encoded as varint.
+inline std::size_t VarintSize(std::uint64_t value) {
+  auto size = std::size_t{1};
+  while (value >= 0x80) {
+    value >>= 7;
+    ++size;
+  }
+  return size;
+}
+
+/// \brief Write the value as varint.
+///
+/// \param buffer Destination with room for at least kMaxVarintSize bytes.
+/// \return The number of bytes written.
+inline std::size_t EncodeVarint(char* buffer, std::uint64_t value) {
+  auto size = std::size_t{0};
+  while (value >= 0x80) {
+    buffer[size++] = static_cast<char>((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  buffer[size++] = static_cast<char>(value);
+  return size;
+}
+
+/// \brief Returns the size of a field with a payload of the given size.
+inline std::size_t LengthDelimitedSize(std::size_t size) {
+  return 1 + VarintSize(size) + size;
+}
+
+/// \brief Returns the size of a varint field.
+inline std::size_t VarintFieldSize(std::uint64_t value) {
+  return 1 + VarintSize(value);
+}
+
+inline void WriteVarint(OutputBuffer& out, std::uint64_t value) {
+  out.Commit(EncodeVarint(out.Reserve(kMaxVarintSize), value));
+}
+
+inline void WriteTag(OutputBuffer& out, std::uint32_t field, WireType type) {
+  out.Write(static_cast<char>((field << 3) | type));
+}
+
+inline void WriteVarintField(OutputBuffer& out, std::uint32_t field,
+                             std::uint64_t value) {
+  WriteTag(out, field, kVarint);
+  WriteVarint(out, value);
+}
+
+/// \brief Write a double as fixed64 in little endian byte order.
+inline void WriteDoubleField(OutputBuffer& out, std::uint32_t field,
+                             double value) {
+  WriteTag(out, field, kFixed64);
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  auto buffer = out.Reserve(8);
+  for (int i = 0; i < 8; ++i) {
+    buffer[i] = static_cast<char>(bits >> (8 * i));
+  }
+  out.Commit(8);
+}
+
+/// \brief Write the tag and the size of a field, which has to be followed by
+/// size bytes of payload.
+inline void WriteLengthDelimitedHead(OutputBuffer& out, std::uint32_t field,
+                                     std::size_t size) {
+  WriteTag(out, field, kLengthDelimited);
+  WriteVarint(out, size);
+}
+
+inline void WriteLengthDelimited(OutputBuffer& out, std::uint32_t field,
+                                 const char* data, std::size_t size) {
+  WriteLengthDelimitedHead(out, field, size);
+  out.Write(data, size);
+}
+
+inline void WriteStringField(OutputBuffer& out, std::uint32_t field,
+                             const std::string& value) {
+  WriteLengthDelimited(out, field, value.data(), value.size());
+}
+
+}  // namespace detail
+
+}  // namespace prometheus
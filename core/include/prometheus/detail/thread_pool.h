@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "prometheus/detail/core_export.h"
+
+namespace prometheus {
+namespace detail {
+
+/// \brief A fixed set of worker threads used to collect and serialize metrics
+/// concurrently.
+///
+/// The thread calling ParallelFor() takes part in running the tasks it
+/// submitted. Hence ParallelFor() can be nested inside a task without risking
+/// a deadlock, and a pool without any worker threads simply runs everything
+/// on the calling thread.
+///
+/// The class is thread-safe. No concurrent call to any API of this type causes
+/// a data race.
+class PROMETHEUS_CPP_CORE_EXPORT ThreadPool {
+ public:
+  /// \brief Create a pool with the given number of worker threads.
+  explicit ThreadPool(std::size_t num_threads);
+
+  /// \brief Stops and joins all worker threads.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// \brief Returns the number of worker threads.
+  std::size_t GetNumThreads() const;
+
+  /// \brief Calls task(i) for every i in [0, count) and waits for all calls
+  /// to finish.
+  ///
+  /// The order in which the calls are started is unspecified. If a call
+  /// throws, the first exception is rethrown once all calls have finished.
+  void ParallelFor(std::size_t count,
+                   const std::function<void(std::size_t)>& task);
+
+ private:
+  struct Batch;
+
+  static void Run(Batch& batch);
+  void Work();
+
+  std::vector<std::thread> workers_;
+  std::deque<std::shared_ptr<Batch>> queue_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_;
+};
+
+}  // namespace detail
+}  // namespace prometheus
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <map>
 #include <string>
 
@@ -18,6 +19,9 @@ namespace detail {
 PROMETHEUS_CPP_CORE_EXPORT std::size_t hash_labels(
     const std::map<std::string, std::string>& labels);
 
+/// \brief Returns the current time in milliseconds since the Unix epoch.
+PROMETHEUS_CPP_CORE_EXPORT std::int64_t CurrentTimestampMs();
+
 }  // namespace detail
 
 }  // namespace prometheus
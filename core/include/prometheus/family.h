@@ -19,6 +19,7 @@
 #include "prometheus/detail/future_std.h"
 #include "prometheus/detail/utils.h"
 #include "prometheus/metric_family.h"
+#include "prometheus/metric_sink.h"
 
 namespace prometheus {
 
@@ -135,6 +136,12 @@ class PROMETHEUS_CPP_CORE_EXPORT Family : public Collectable {
   /// \return Zero or more samples for each dimensional data.
   std::vector<MetricFamily> Collect() const override;
 
+  /// \brief Passes the current value of each dimensional data to the sink.
+  ///
+  /// Same as Collect(), but the labels are not copied. The sink is flushed
+  /// after the family has been unlocked.
+  void CollectTo(MetricSink& sink) const override;
+
  private:
   std::unordered_map<std::size_t, std::unique_ptr<T>> metrics_;
   std::unordered_map<std::size_t, std::map<std::string, std::string>> labels_;
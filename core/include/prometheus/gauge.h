@@ -5,6 +5,7 @@
 #include "prometheus/client_metric.h"
 #include "prometheus/detail/builder.h"
 #include "prometheus/detail/core_export.h"
+#include "prometheus/metric_sink.h"
 #include "prometheus/metric_type.h"
 
 namespace prometheus {
@@ -57,6 +58,11 @@ class PROMETHEUS_CPP_CORE_EXPORT Gauge {
   /// Collect is called by the Registry when collecting metrics.
   ClientMetric Collect() const;
 
+  /// \brief Pass the current value of the gauge to the given sink.
+  ///
+  /// Collect is called by the Family when streaming metrics to a MetricSink.
+  void Collect(MetricSink& sink, const MetricSink::Series& series) const;
+
  private:
   void Change(double);
   std::atomic<double> value_{0.0};
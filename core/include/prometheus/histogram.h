@@ -1,11 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 #include "prometheus/client_metric.h"
 #include "prometheus/counter.h"
 #include "prometheus/detail/builder.h"
 #include "prometheus/detail/core_export.h"
+#include "prometheus/gauge.h"
+#include "prometheus/metric_sink.h"
 #include "prometheus/metric_type.h"
 
 namespace prometheus {
@@ -65,10 +68,20 @@ class PROMETHEUS_CPP_CORE_EXPORT Histogram {
   /// Collect is called by the Registry when collecting metrics.
   ClientMetric Collect() const;
 
+  /// \brief Pass the current buckets of the histogram to the given sink.
+  ///
+  /// Collect is called by the Family when streaming metrics to a MetricSink.
+  void Collect(MetricSink& sink, const MetricSink::Series& series) const;
+
  private:
+  void CollectHistogram(ClientMetric::Histogram& histogram) const;
+
   const BucketBoundaries bucket_boundaries_;
-  std::vector<Counter> bucket_counts_;
-  Counter sum_;
+  // Gauges only ever incremented count like a Counter, but do not keep a
+  // created timestamp of their own
+  std::vector<Gauge> bucket_counts_;
+  Gauge sum_;
+  const std::int64_t created_timestamp_ms_;
 };
 
 /// \brief Return a builder to configure and register a Histogram metric.
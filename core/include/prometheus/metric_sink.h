@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "prometheus/client_metric.h"
+#include "prometheus/detail/core_export.h"
+#include "prometheus/metric_type.h"
+
+namespace prometheus {
+
+/// \brief Receives the metrics of a Collectable one time series at a time.
+///
+/// A MetricSink is the streaming counterpart of the list of MetricFamily
+/// returned by Collectable::Collect(). Collectables pass their families and
+/// samples directly to the sink, which allows consumers like a Serializer to
+/// process live metrics without building an intermediate copy of them.
+///
+/// Each time series is passed with only the value of its own metric type
+/// instead of a complete ClientMetric, so collecting a counter or a gauge
+/// costs no more than the double it holds.
+///
+/// All references passed to the sink are only valid for the duration of the
+/// call. Collectables may hold locks of the application while they call the
+/// sink, so the sink should not block. A sink passing the metrics on to a
+/// slow destination like a connection should hold them back until Flush().
+class PROMETHEUS_CPP_CORE_EXPORT MetricSink {
+ public:
+  using Labels = std::map<std::string, std::string>;
+
+  /// \brief The labels and the timestamp of one time series.
+  ///
+  /// The labels of the time series are the ones in label, followed by
+  /// constant_labels, followed by labels.
+  struct Series {
+    const std::vector<ClientMetric::Label>& label;
+    const Labels& constant_labels;
+    const Labels& labels;
+    std::int64_t timestamp_ms;
+  };
+
+  virtual ~MetricSink() = default;
+
+  /// \brief Starts a new metric family.
+  ///
+  /// All following calls to AddMetric() belong to this family until the next
+  /// call to AddFamily(). Only the overload matching the type of the family
+  /// is called.
+  virtual void AddFamily(const std::string& name, const std::string& help,
+                         MetricType type) = 0;
+
+  /// \brief Adds one time series to the current family.
+  virtual void AddMetric(const Series& series,
+                         const ClientMetric::Counter& counter) = 0;
+  virtual void AddMetric(const Series& series,
+                         const ClientMetric::Gauge& gauge) = 0;
+  virtual void AddMetric(const Series& series,
+                         const ClientMetric::Summary& summary) = 0;
+  virtual void AddMetric(const Series& series,
+                         const ClientMetric::Histogram& histogram) = 0;
+  virtual void AddMetric(const Series& series,
+                         const ClientMetric::Untyped& untyped) = 0;
+
+  /// \brief Called by a collectable between families while it holds no
+  /// locks.
+  ///
+  /// The sink may pass on what it has received so far. The default
+  /// implementation does nothing.
+  virtual void Flush() {}
+
+  /// \brief Adds the part of a materialized ClientMetric which matches the
+  /// given metric type to the current family.
+  void AddClientMetric(MetricType type, const ClientMetric& metric);
+
+  /// \brief Returns an emptied histogram to be filled and passed to
+  /// AddMetric().
+  ///
+  /// The storage of the buckets is kept by the sink, so collecting many
+  /// histograms into the same sink allocates it only once.
+  ClientMetric::Histogram& GetHistogramBuffer();
+
+  /// \brief Returns an emptied summary to be filled and passed to
+  /// AddMetric().
+  ///
+  /// The storage of the quantiles is kept by the sink, so collecting many
+  /// summaries into the same sink allocates it only once.
+  ClientMetric::Summary& GetSummaryBuffer();
+
+ private:
+  ClientMetric::Histogram histogram_buffer_;
+  ClientMetric::Summary summary_buffer_;
+};
+
+}  // namespace prometheus
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "prometheus/detail/core_export.h"
+
+namespace prometheus {
+
+/// \brief Selects metric families by name.
+///
+/// A filter without any pattern matches every name. Otherwise a name matches
+/// if it equals one of the patterns, or starts with the part before the '*'
+/// of a pattern ending in '*'. Metric names cannot contain a '*', so, e.g.,
+/// "http_*" selects all families whose name starts with "http_".
+class PROMETHEUS_CPP_CORE_EXPORT NameFilter {
+ public:
+  NameFilter() = default;
+  explicit NameFilter(const std::vector<std::string>& patterns);
+
+  /// \brief Adds a name or prefix pattern to the selected names.
+  void Add(const std::string& pattern);
+
+  /// \brief Returns true if the filter does not restrict the names.
+  bool MatchesAll() const;
+
+  /// \brief Returns true if the family with the given name is selected.
+  bool Matches(const std::string& name) const;
+
+ private:
+  std::set<std::string> names_;
+  std::vector<std::string> prefixes_;
+};
+
+}  // namespace prometheus
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "prometheus/detail/core_export.h"
+#include "prometheus/metric_family.h"
+#include "prometheus/serializer.h"
+
+namespace prometheus {
+
+/// \brief Serializes metrics in the OpenMetrics text format.
+///
+/// Counters are exposed with the _total suffix, counters, summaries and
+/// histograms with their creation time as _created sample. The exposition is
+/// terminated by the "# EOF" trailer.
+///
+/// See https://github.com/OpenObservability/OpenMetrics
+class PROMETHEUS_CPP_CORE_EXPORT OpenMetricsSerializer : public Serializer {
+ public:
+  /// \brief The content type of the serialized metrics.
+  static const char* const kContentType;
+
+  using Serializer::Serialize;
+  void Serialize(std::ostream& out,
+                 const std::vector<MetricFamily>& metrics) const override;
+  void Serialize(OutputBuffer& out,
+                 const std::vector<MetricFamily>& metrics) const override;
+  void Serialize(OutputBuffer& out, const MetricFamily& family) const override;
+  void Serialize(OutputBuffer& out,
+                 const Collectable& collectable) const override;
+  void SerializeTrailer(OutputBuffer& out) const override;
+};
+
+}  // namespace prometheus
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "prometheus/detail/core_export.h"
+
+namespace prometheus {
+
+/// \brief Destination of serialized metrics.
+///
+/// Writes are copied into a window of memory provided by the derived class.
+/// Only when the window is full the derived class is asked for a new one, so
+/// writing a few bytes costs no more than a comparison and a copy.
+class PROMETHEUS_CPP_CORE_EXPORT OutputBuffer {
+ public:
+  virtual ~OutputBuffer() = default;
+
+  OutputBuffer(const OutputBuffer&) = delete;
+  OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+  void Write(const char* data, std::size_t size) {
+    if (static_cast<std::size_t>(end_ - next_) >= size) {
+      std::memcpy(next_, data, size);
+      next_ += size;
+    } else {
+      WriteSlow(data, size);
+    }
+  }
+
+  void Write(const char* str) { Write(str, std::strlen(str)); }
+
+  void Write(const std::string& str) { Write(str.data(), str.size()); }
+
+  void Write(char c) {
+    if (next_ == end_) {
+      Grow(1, 1);
+    }
+    *next_++ = c;
+  }
+
+  /// \brief Returns memory for at least size bytes to be written directly.
+  ///
+  /// The bytes become part of the output by calling Commit() afterwards.
+  char* Reserve(std::size_t size) {
+    if (static_cast<std::size_t>(end_ - next_) < size) {
+      Grow(size, size);
+    }
+    return next_;
+  }
+
+  /// \brief Appends size bytes written to the memory returned by Reserve().
+  void Commit(std::size_t size) { next_ += size; }
+
+ protected:
+  OutputBuffer() = default;
+
+  /// \brief Makes room for more bytes by calling SetWindow().
+  ///
+  /// The new window must hold at least min_size bytes and should hold size
+  /// bytes if that is cheap. Large writes are split to fit into smaller
+  /// windows. All bytes before GetNext() have been written when this is
+  /// called.
+  virtual void Grow(std::size_t min_size, std::size_t size) = 0;
+
+  /// \brief Sets the memory the following writes are copied to.
+  void SetWindow(char* begin, char* end) {
+    next_ = begin;
+    end_ = end;
+  }
+
+  /// \brief Returns the position of the next write in the current window.
+  char* GetNext() const { return next_; }
+
+ private:
+  void WriteSlow(const char* data, std::size_t size);
+
+  char* next_ = nullptr;
+  char* end_ = nullptr;
+};
+
+/// \brief A growable contiguous buffer.
+///
+/// Clear() keeps the allocated memory, so a buffer reused for every scrape
+/// stops allocating once it has grown to the size of a scrape.
+class PROMETHEUS_CPP_CORE_EXPORT StringOutputBuffer : public OutputBuffer {
+ public:
+  StringOutputBuffer() = default;
+
+  /// \brief Returns the bytes written so far.
+  const char* GetData() const { return storage_.data(); }
+
+  /// \brief Returns the number of bytes written so far.
+  std::size_t GetSize() const;
+
+  /// \brief Returns a copy of the bytes written so far.
+  std::string ToString() const;
+
+  /// \brief Discards the bytes written so far.
+  void Clear();
+
+ protected:
+  void Grow(std::size_t min_size, std::size_t size) override;
+
+ private:
+  std::vector<char> storage_;
+};
+
+/// \brief Adapts a std::ostream to an OutputBuffer.
+///
+/// Writes are collected in an internal buffer and passed to the stream in
+/// blocks. The remaining bytes are passed on destruction or by calling
+/// Flush().
+class PROMETHEUS_CPP_CORE_EXPORT StreamOutputBuffer : public OutputBuffer {
+ public:
+  explicit StreamOutputBuffer(std::ostream& out);
+  ~StreamOutputBuffer() override;
+
+  /// \brief Passes all bytes written so far to the stream.
+  void Flush();
+
+ protected:
+  void Grow(std::size_t min_size, std::size_t size) override;
+
+ private:
+  std::ostream& out_;
+  std::vector<char> storage_;
+};
+
+}  // namespace prometheus
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "prometheus/detail/core_export.h"
+#include "prometheus/metric_family.h"
+#include "prometheus/serializer.h"
+
+namespace prometheus {
+
+/// \brief Serializes metrics in the delimited protocol buffer format.
+///
+/// Each family is written as an io.prometheus.client.MetricFamily message
+/// prefixed by its length as varint. The messages are encoded directly, so no
+/// protocol buffer library is needed.
+class PROMETHEUS_CPP_CORE_EXPORT ProtobufSerializer : public Serializer {
+ public:
+  /// \brief The content type of the serialized metrics.
+  static const char* const kContentType;
+
+  using Serializer::Serialize;
+  void Serialize(std::ostream& out,
+                 const std::vector<MetricFamily>& metrics) const override;
+  void Serialize(OutputBuffer& out,
+                 const std::vector<MetricFamily>& metrics) const override;
+  void Serialize(OutputBuffer& out, const MetricFamily& family) const override;
+  void Serialize(OutputBuffer& out,
+                 const Collectable& collectable) const override;
+};
+
+}  // namespace prometheus
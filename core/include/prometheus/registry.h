@@ -73,6 +73,39 @@ class PROMETHEUS_CPP_CORE_EXPORT Registry : public Collectable {
   /// \return Zero or more metrics and their samples.
   std::vector<MetricFamily> Collect() const override;
 
+  /// \brief Returns a list of metrics and their samples.
+  ///
+  /// Same as Collect(), but the metrics of the families are collected
+  /// concurrently on the given pool. The order of the result is the same.
+  ///
+  /// \return Zero or more metrics and their samples.
+  std::vector<MetricFamily> CollectConcurrently(
+      detail::ThreadPool& pool) const override;
+
+  /// \brief Passes the metrics and their samples to the given sink.
+  ///
+  /// Same as Collect(), but each family passes its samples straight to the
+  /// sink without building a list of metrics first. The registry is not
+  /// locked while the families are collected, and each family flushes the
+  /// sink once it has released its own lock.
+  void CollectTo(MetricSink& sink) const override;
+
+  /// \brief Returns the metric families selected by the given filter and
+  /// their samples.
+  ///
+  /// Families which are not selected are skipped by name and never
+  /// collected.
+  std::vector<MetricFamily> CollectFiltered(
+      const NameFilter& filter) const override;
+
+  /// \brief Passes the metric families selected by the given filter and
+  /// their samples to the given sink.
+  ///
+  /// Families which are not selected are skipped by name and never
+  /// collected.
+  void CollectFilteredTo(MetricSink& sink,
+                         const NameFilter& filter) const override;
+
  private:
   template <typename T>
   friend class detail::Builder;
@@ -4,17 +4,80 @@
 #include <string>
 #include <vector>
 
+#include "prometheus/collectable.h"
 #include "prometheus/detail/core_export.h"
 #include "prometheus/metric_family.h"
+#include "prometheus/output_buffer.h"
 
 namespace prometheus {
 
+namespace detail {
+class ThreadPool;
+}  // namespace detail
+
 class PROMETHEUS_CPP_CORE_EXPORT Serializer {
  public:
   virtual ~Serializer() = default;
   virtual std::string Serialize(const std::vector<MetricFamily>&) const;
   virtual void Serialize(std::ostream& out,
                          const std::vector<MetricFamily>& metrics) const = 0;
+
+  /// \brief Serializes the families into the given buffer.
+  ///
+  /// The default implementation writes through a std::ostream adapter to
+  /// Serialize(std::ostream&, const std::vector<MetricFamily>&). Serializers
+  /// should override it to write to the buffer directly.
+  virtual void Serialize(OutputBuffer& out,
+                         const std::vector<MetricFamily>& metrics) const;
+
+  /// \brief Serializes a single metric family.
+  ///
+  /// Serializing all families one after the other must give the same output
+  /// as serializing them at once. The default implementation copies the family
+  /// and forwards it to Serialize(OutputBuffer&, const
+  /// std::vector<MetricFamily>&).
+  virtual void Serialize(OutputBuffer& out, const MetricFamily& family) const;
+
+  /// \brief Serializes the families concurrently on the given pool and
+  /// concatenates the output in the order of the given families, followed by
+  /// the trailer.
+  std::string Serialize(const std::vector<MetricFamily>& metrics,
+                        detail::ThreadPool& pool) const;
+  void Serialize(OutputBuffer& out, const std::vector<MetricFamily>& metrics,
+                 detail::ThreadPool& pool) const;
+
+  /// \brief Serializes the metrics of the given collectable.
+  ///
+  /// Like Serialize(OutputBuffer&, const MetricFamily&), the output does not
+  /// include the trailer, so the metrics of several collectables can be
+  /// serialized one after the other.
+  ///
+  /// The default implementation serializes each family returned by
+  /// Collectable::Collect(). Serializers should override it to stream the
+  /// metrics through Collectable::CollectTo() instead.
+  virtual void Serialize(OutputBuffer& out,
+                         const Collectable& collectable) const;
+
+  /// \brief Serializes the metrics of the given collectable without writing
+  /// to out while the collectable may hold locks.
+  ///
+  /// The output is held back in pending and only written to out when the
+  /// collectable flushes the sink, and once it is done. A slow out, like a
+  /// connection, therefore does not keep the application from changing its
+  /// metrics. Otherwise the same as Serialize(OutputBuffer&, const
+  /// Collectable&).
+  void SerializeOutsideLocks(OutputBuffer& out, const Collectable& collectable,
+                             StringOutputBuffer& pending) const;
+
+  /// \brief Serializes the metrics of the given collectable to a string,
+  /// followed by the trailer.
+  std::string Serialize(const Collectable& collectable) const;
+
+  /// \brief Writes what has to follow the last family of a serialization.
+  ///
+  /// Serializing a list of families at once writes the trailer by itself.
+  /// The default implementation writes nothing.
+  virtual void SerializeTrailer(OutputBuffer& out) const;
 };
 
 }  // namespace prometheus
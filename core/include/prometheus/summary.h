@@ -10,6 +10,7 @@
 #include "prometheus/detail/ckms_quantiles.h"
 #include "prometheus/detail/core_export.h"
 #include "prometheus/detail/time_window_quantiles.h"
+#include "prometheus/metric_sink.h"
 #include "prometheus/metric_type.h"
 
 namespace prometheus {
@@ -83,12 +84,20 @@ class PROMETHEUS_CPP_CORE_EXPORT Summary {
   /// Collect is called by the Registry when collecting metrics.
   ClientMetric Collect() const;
 
+  /// \brief Pass the current value of the summary to the given sink.
+  ///
+  /// Collect is called by the Family when streaming metrics to a MetricSink.
+  void Collect(MetricSink& sink, const MetricSink::Series& series) const;
+
  private:
+  void CollectSummary(ClientMetric::Summary& summary) const;
+
   const Quantiles quantiles_;
   mutable std::mutex mutex_;
   std::uint64_t count_;
   double sum_;
   detail::TimeWindowQuantiles quantile_values_;
+  const std::int64_t created_timestamp_ms_;
 };
 
 /// \brief Return a builder to configure and register a Summary metric.
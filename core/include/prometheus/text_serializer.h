@@ -15,6 +15,11 @@ class PROMETHEUS_CPP_CORE_EXPORT TextSerializer : public Serializer {
   using Serializer::Serialize;
   void Serialize(std::ostream& out,
                  const std::vector<MetricFamily>& metrics) const override;
+  void Serialize(OutputBuffer& out,
+                 const std::vector<MetricFamily>& metrics) const override;
+  void Serialize(OutputBuffer& out, const MetricFamily& family) const override;
+  void Serialize(OutputBuffer& out,
+                 const Collectable& collectable) const override;
 };
 
 }  // namespace prometheus
@@ -0,0 +1,101 @@
+#include "prometheus/collectable.h"
+
+#include <algorithm>
+
+#include "prometheus/metric_family.h"
+#include "prometheus/metric_sink.h"
+#include "prometheus/name_filter.h"
+
+namespace prometheus {
+
+namespace {
+// Forwards the families selected by a filter to another sink
+class FilteringSink : public MetricSink {
+ public:
+  FilteringSink(MetricSink& sink, const NameFilter& filter)
+      : sink_(sink), filter_(filter), selected_{false} {}
+
+  void AddFamily(const std::string& name, const std::string& help,
+                 MetricType type) override {
+    selected_ = filter_.Matches(name);
+    if (selected_) {
+      sink_.AddFamily(name, help, type);
+    }
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Counter& counter) override {
+    if (selected_) {
+      sink_.AddMetric(series, counter);
+    }
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Gauge& gauge) override {
+    if (selected_) {
+      sink_.AddMetric(series, gauge);
+    }
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Summary& summary) override {
+    if (selected_) {
+      sink_.AddMetric(series, summary);
+    }
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Histogram& histogram) override {
+    if (selected_) {
+      sink_.AddMetric(series, histogram);
+    }
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Untyped& untyped) override {
+    if (selected_) {
+      sink_.AddMetric(series, untyped);
+    }
+  }
+
+  void Flush() override { sink_.Flush(); }
+
+ private:
+  MetricSink& sink_;
+  const NameFilter& filter_;
+  bool selected_;
+};
+}  // namespace
+
+std::vector<MetricFamily> Collectable::CollectConcurrently(
+    detail::ThreadPool&) const {
+  return Collect();
+}
+
+void Collectable::CollectTo(MetricSink& sink) const {
+  for (auto&& family : Collect()) {
+    sink.AddFamily(family.name, family.help, family.type);
+    for (auto&& metric : family.metric) {
+      sink.AddClientMetric(family.type, metric);
+    }
+  }
+}
+
+std::vector<MetricFamily> Collectable::CollectFiltered(
+    const NameFilter& filter) const {
+  auto families = Collect();
+  families.erase(std::remove_if(families.begin(), families.end(),
+                                [&filter](const MetricFamily& family) {
+                                  return !filter.Matches(family.name);
+                                }),
+                 families.end());
+  return families;
+}
+
+void Collectable::CollectFilteredTo(MetricSink& sink,
+                                    const NameFilter& filter) const {
+  FilteringSink filtering{sink, filter};
+  CollectTo(filtering);
+}
+
+}  // namespace prometheus
@@ -1,17 +1,34 @@
 #include "prometheus/counter.h"
 
+#include "prometheus/detail/utils.h"
+
 namespace prometheus {
 
+Counter::Counter() : created_timestamp_ms_{detail::CurrentTimestampMs()} {}
+
 void Counter::Increment() { gauge_.Increment(); }
 
 void Counter::Increment(const double val) { gauge_.Increment(val); }
 
 double Counter::Value() const { return gauge_.Value(); }
 
+std::int64_t Counter::CreatedTimestampMs() const {
+  return created_timestamp_ms_;
+}
+
 ClientMetric Counter::Collect() const {
   ClientMetric metric;
   metric.counter.value = Value();
+  metric.counter.created_timestamp_ms = created_timestamp_ms_;
   return metric;
 }
 
+void Counter::Collect(MetricSink& sink,
+                      const MetricSink::Series& series) const {
+  ClientMetric::Counter counter;
+  counter.value = Value();
+  counter.created_timestamp_ms = created_timestamp_ms_;
+  sink.AddMetric(series, counter);
+}
+
 }  // namespace prometheus
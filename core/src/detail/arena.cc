@@ -0,0 +1,122 @@
+#include "prometheus/detail/arena.h"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+namespace prometheus {
+namespace detail {
+
+namespace {
+const std::size_t alignment = alignof(std::max_align_t);
+
+std::size_t AlignUp(std::size_t size) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+}  // namespace
+
+Arena::Arena(const std::size_t block_size)
+    : current_{0}, offset_{0}, block_size_{AlignUp(block_size)} {}
+
+void* Arena::Allocate(const std::size_t size) {
+  const auto aligned_size = AlignUp(size);
+
+  if (current_ < blocks_.size() &&
+      blocks_[current_].size - offset_ >= aligned_size) {
+    auto result = blocks_[current_].data.get() + offset_;
+    offset_ += aligned_size;
+    return result;
+  }
+
+  // Move on to the next block that is large enough. Blocks kept by Reset()
+  // are reused before new ones are allocated.
+  auto next = blocks_.size() > current_ ? current_ + 1 : current_;
+  auto fits = std::find_if(blocks_.begin() + next, blocks_.end(),
+                           [aligned_size](const Block& block) {
+                             return block.size >= aligned_size;
+                           });
+  if (fits == blocks_.end()) {
+    const auto block_size = std::max(block_size_, aligned_size);
+    auto block = Block{std::unique_ptr<char[]>{new char[block_size]},
+                       block_size};
+    fits = blocks_.insert(blocks_.begin() + next, std::move(block));
+  } else {
+    std::iter_swap(blocks_.begin() + next, fits);
+    fits = blocks_.begin() + next;
+  }
+
+  current_ = next;
+  offset_ = aligned_size;
+  return fits->data.get();
+}
+
+void Arena::Reset() {
+  current_ = 0;
+  offset_ = 0;
+}
+
+std::size_t Arena::GetCapacity() const {
+  auto capacity = std::size_t{0};
+  for (const auto& block : blocks_) {
+    capacity += block.size;
+  }
+  return capacity;
+}
+
+ArenaOutputBuffer::ArenaOutputBuffer(Arena& arena,
+                                     const std::size_t chunk_size)
+    : arena_(arena),
+      chunk_size_{chunk_size},
+      head_{nullptr},
+      tail_{nullptr},
+      sealed_size_{0} {}
+
+std::size_t ArenaOutputBuffer::GetSize() const {
+  return tail_ ? sealed_size_ +
+                     static_cast<std::size_t>(GetNext() - GetData(tail_))
+               : 0;
+}
+
+void ArenaOutputBuffer::ForEachChunk(
+    const std::function<void(const char* data, std::size_t size)>& function)
+    const {
+  for (auto chunk = head_; chunk != nullptr; chunk = chunk->next) {
+    const auto size =
+        chunk == tail_ ? static_cast<std::size_t>(GetNext() - GetData(chunk))
+                       : chunk->size;
+    if (size > 0) {
+      function(GetData(chunk), size);
+    }
+  }
+}
+
+void ArenaOutputBuffer::Grow(std::size_t min_size, std::size_t) {
+  Seal();
+
+  const auto capacity = std::max(chunk_size_, min_size);
+  auto memory = arena_.Allocate(sizeof(Chunk) + capacity);
+  auto chunk = new (memory) Chunk{nullptr, 0};
+  if (tail_) {
+    tail_->next = chunk;
+  } else {
+    head_ = chunk;
+  }
+  tail_ = chunk;
+
+  auto data = GetData(chunk);
+  SetWindow(data, data + capacity);
+}
+
+void ArenaOutputBuffer::Seal() {
+  if (tail_) {
+    tail_->size = static_cast<std::size_t>(GetNext() - GetData(tail_));
+    sealed_size_ += tail_->size;
+  }
+}
+
+char* ArenaOutputBuffer::GetData(const Chunk* chunk) {
+  return reinterpret_cast<char*>(const_cast<Chunk*>(chunk) + 1);
+}
+
+}  // namespace detail
+}  // namespace prometheus
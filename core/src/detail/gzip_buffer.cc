@@ -0,0 +1,157 @@
+#include "prometheus/detail/gzip_buffer.h"
+
+#include "prometheus/detail/future_std.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace prometheus {
+namespace detail {
+
+#ifdef HAVE_ZLIB
+struct GZipCompressor::Stream {
+  z_stream stream{};
+  bool initialized = false;
+  int level = 0;
+  int strategy = 0;
+};
+
+GZipCompressor::GZipCompressor() : stream_{make_unique<Stream>()} {}
+
+GZipCompressor::~GZipCompressor() {
+  if (stream_->initialized) {
+    deflateEnd(&stream_->stream);
+  }
+}
+
+bool GZipCompressor::Start(const int level, const int strategy) {
+  auto& s = *stream_;
+  if (s.initialized) {
+    if (level == s.level && strategy == s.strategy &&
+        deflateReset(&s.stream) == Z_OK) {
+      return true;
+    }
+    deflateEnd(&s.stream);
+    s.initialized = false;
+  }
+
+  const auto windowSize = 16 + MAX_WBITS;
+  const auto memoryLevel = 9;
+  s.stream = z_stream{};
+  if (deflateInit2(&s.stream, level, Z_DEFLATED, windowSize, memoryLevel,
+                   strategy) != Z_OK) {
+    return false;
+  }
+
+  s.initialized = true;
+  s.level = level;
+  s.strategy = strategy;
+  return true;
+}
+
+std::uint64_t GZipCompressor::GetTotalIn() const {
+  return stream_->stream.total_in;
+}
+
+std::uint64_t GZipCompressor::GetTotalOut() const {
+  return stream_->stream.total_out;
+}
+
+GZipBuffer::GZipBuffer(GZipCompressor& compressor, OutputBuffer& out,
+                       Arena& arena,
+                       std::chrono::steady_clock::duration* deflate_time,
+                       const std::size_t buffer_size)
+    : stream_(*compressor.stream_),
+      out_(out),
+      arena_(arena),
+      input_{static_cast<char*>(arena.Allocate(buffer_size))},
+      input_size_{buffer_size},
+      output_{static_cast<char*>(arena.Allocate(buffer_size))},
+      output_size_{buffer_size},
+      deflate_time_{deflate_time} {
+  SetWindow(input_, input_ + input_size_);
+}
+
+bool GZipBuffer::Finish() {
+  int ret;
+  do {
+    ret = Deflate(Z_FINISH);
+  } while (ret == Z_OK);
+  return ret == Z_STREAM_END;
+}
+
+void GZipBuffer::Grow(const std::size_t min_size, std::size_t) {
+  Deflate(Z_NO_FLUSH);
+  if (min_size > input_size_) {
+    input_size_ = min_size;
+    input_ = static_cast<char*>(arena_.Allocate(input_size_));
+  }
+  SetWindow(input_, input_ + input_size_);
+}
+
+int GZipBuffer::Deflate(const int flush) {
+  auto& stream = stream_.stream;
+  stream.next_in = reinterpret_cast<Bytef*>(input_);
+  stream.avail_in = static_cast<uInt>(GetNext() - input_);
+  SetWindow(input_, input_ + input_size_);
+
+  int ret;
+  do {
+    stream.next_out = reinterpret_cast<Bytef*>(output_);
+    stream.avail_out = static_cast<uInt>(output_size_);
+
+    const auto start = std::chrono::steady_clock::now();
+    ret = deflate(&stream, flush);
+    if (deflate_time_) {
+      *deflate_time_ += std::chrono::steady_clock::now() - start;
+    }
+
+    out_.Write(output_, output_size_ - stream.avail_out);
+  } while (ret == Z_OK && stream.avail_out == 0);
+  return ret;
+}
+#else
+// Without zlib no stream can be started, so nothing is ever compressed
+struct GZipCompressor::Stream {};
+
+GZipCompressor::GZipCompressor() : stream_{make_unique<Stream>()} {}
+
+GZipCompressor::~GZipCompressor() = default;
+
+bool GZipCompressor::Start(int, int) { return false; }
+
+std::uint64_t GZipCompressor::GetTotalIn() const { return 0; }
+
+std::uint64_t GZipCompressor::GetTotalOut() const { return 0; }
+
+GZipBuffer::GZipBuffer(GZipCompressor& compressor, OutputBuffer& out,
+                       Arena& arena,
+                       std::chrono::steady_clock::duration* deflate_time,
+                       const std::size_t buffer_size)
+    : stream_(*compressor.stream_),
+      out_(out),
+      arena_(arena),
+      input_{static_cast<char*>(arena.Allocate(buffer_size))},
+      input_size_{buffer_size},
+      output_{nullptr},
+      output_size_{0},
+      deflate_time_{deflate_time} {
+  SetWindow(input_, input_ + input_size_);
+}
+
+bool GZipBuffer::Finish() { return false; }
+
+void GZipBuffer::Grow(const std::size_t min_size, std::size_t) {
+  if (min_size > input_size_) {
+    input_size_ = min_size;
+    input_ = static_cast<char*>(arena_.Allocate(input_size_));
+  }
+  SetWindow(input_, input_ + input_size_);
+}
+
+int GZipBuffer::Deflate(int) { return -1; }
+#endif
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,351 @@
+#include "prometheus/detail/number_format.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace prometheus {
+
+namespace detail {
+
+namespace {
+
+// Grisu2 as described in "Printing Floating-Point Numbers Quickly and
+// Accurately with Integers" by Florian Loitsch (PLDI 2010). The result always
+// parses back to the original value and is the shortest one in the vast
+// majority of cases.
+
+const std::uint64_t kSignificandMask = 0x000FFFFFFFFFFFFFULL;
+const std::uint64_t kExponentMask = 0x7FF0000000000000ULL;
+const std::uint64_t kHiddenBit = 0x0010000000000000ULL;
+const int kSignificandSize = 52;
+const int kExponentBias = 0x3FF + kSignificandSize;
+const int kMinExponent = -kExponentBias;
+
+// Powers of ten from 10^-348 to 10^340 in steps of 8, normalized to a 64 bit
+// significand and a binary exponent.
+const std::uint64_t kCachedPowersF[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+const std::int16_t kCachedPowersE[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954,
+    -927, -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635,
+    -608, -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316,
+    -289, -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30, 56,
+    83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348, 375, 402, 428, 455,
+    481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800, 827, 853,
+    880, 907, 933, 960, 986, 1013, 1039, 1066
+};
+
+const std::uint64_t kPow10[] = {1ULL,
+                                10ULL,
+                                100ULL,
+                                1000ULL,
+                                10000ULL,
+                                100000ULL,
+                                1000000ULL,
+                                10000000ULL,
+                                100000000ULL,
+                                1000000000ULL,
+                                10000000000ULL,
+                                100000000000ULL,
+                                1000000000000ULL,
+                                10000000000000ULL,
+                                100000000000000ULL,
+                                1000000000000000ULL,
+                                10000000000000000ULL,
+                                100000000000000000ULL,
+                                1000000000000000000ULL,
+                                10000000000000000000ULL};
+
+// A floating point number f * 2^e with a 64 bit significand
+struct DiyFp {
+  std::uint64_t f;
+  int e;
+};
+
+DiyFp FromDouble(double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  const auto biased_exponent =
+      static_cast<int>((bits & kExponentMask) >> kSignificandSize);
+  const auto significand = bits & kSignificandMask;
+  if (biased_exponent != 0) {
+    return DiyFp{significand + kHiddenBit, biased_exponent - kExponentBias};
+  }
+  return DiyFp{significand, kMinExponent + 1};
+}
+
+DiyFp Subtract(const DiyFp& lhs, const DiyFp& rhs) {
+  return DiyFp{lhs.f - rhs.f, lhs.e};
+}
+
+DiyFp Multiply(const DiyFp& lhs, const DiyFp& rhs) {
+  const std::uint64_t mask = 0xFFFFFFFFULL;
+  const auto a = lhs.f >> 32;
+  const auto b = lhs.f & mask;
+  const auto c = rhs.f >> 32;
+  const auto d = rhs.f & mask;
+  const auto ac = a * c;
+  const auto bc = b * c;
+  const auto ad = a * d;
+  const auto bd = b * d;
+  auto tmp = (bd >> 32) + (ad & mask) + (bc & mask);
+  tmp += 1ULL << 31;  // round
+  return DiyFp{ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), lhs.e + rhs.e + 64};
+}
+
+DiyFp Normalize(DiyFp value) {
+  while ((value.f & (1ULL << 63)) == 0) {
+    value.f <<= 1;
+    value.e--;
+  }
+  return value;
+}
+
+// Computes the normalized boundaries m- and m+ halfway to the neighboring
+// doubles. Both share the exponent of m+.
+void NormalizedBoundaries(const DiyFp& value, DiyFp* minus, DiyFp* plus) {
+  auto upper = DiyFp{(value.f << 1) + 1, value.e - 1};
+  while ((upper.f & (kHiddenBit << 1)) == 0) {
+    upper.f <<= 1;
+    upper.e--;
+  }
+  upper.f <<= 64 - kSignificandSize - 2;
+  upper.e -= 64 - kSignificandSize - 2;
+
+  auto lower = value.f == kHiddenBit
+                   ? DiyFp{(value.f << 2) - 1, value.e - 2}
+                   : DiyFp{(value.f << 1) - 1, value.e - 1};
+  lower.f <<= lower.e - upper.e;
+  lower.e = upper.e;
+
+  *minus = lower;
+  *plus = upper;
+}
+
+// Returns a cached power of ten c = 10^-k such that the binary exponent of
+// c * 2^e lies in [-60, -32].
+DiyFp GetCachedPower(int e, int* k) {
+  const auto dk = (-61 - e) * 0.30102999566398114 + 347;
+  auto ik = static_cast<int>(dk);
+  if (dk - ik > 0.0) {
+    ik++;
+  }
+  const auto index = static_cast<unsigned>((ik >> 3) + 1);
+  *k = -(-348 + static_cast<int>(index << 3));
+  return DiyFp{kCachedPowersF[index], kCachedPowersE[index]};
+}
+
+int CountDecimalDigits(std::uint32_t n) {
+  auto digits = 1;
+  while (n >= 10) {
+    n /= 10;
+    digits++;
+  }
+  return digits;
+}
+
+void GrisuRound(char* buffer, int length, std::uint64_t delta,
+                std::uint64_t rest, std::uint64_t ten_kappa,
+                std::uint64_t wp_w) {
+  while (rest < wp_w && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < wp_w ||  // closer
+          wp_w - rest > rest + ten_kappa - wp_w)) {
+    buffer[length - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+void DigitGen(const DiyFp& w, const DiyFp& mp, std::uint64_t delta,
+              char* buffer, int* length, int* k) {
+  const auto one = DiyFp{1ULL << -mp.e, mp.e};
+  const auto wp_w = Subtract(mp, w);
+  auto p1 = static_cast<std::uint32_t>(mp.f >> -one.e);
+  auto p2 = mp.f & (one.f - 1);
+  auto kappa = CountDecimalDigits(p1);
+  *length = 0;
+
+  while (kappa > 0) {
+    const auto divisor = static_cast<std::uint32_t>(kPow10[kappa - 1]);
+    const auto digit = p1 / divisor;
+    p1 %= divisor;
+    if (digit != 0 || *length != 0) {
+      buffer[(*length)++] = static_cast<char>('0' + digit);
+    }
+    kappa--;
+    const auto rest = (static_cast<std::uint64_t>(p1) << -one.e) + p2;
+    if (rest <= delta) {
+      *k += kappa;
+      GrisuRound(buffer, *length, delta, rest, kPow10[kappa] << -one.e,
+                 wp_w.f);
+      return;
+    }
+  }
+
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+    const auto digit = static_cast<char>(p2 >> -one.e);
+    if (digit != 0 || *length != 0) {
+      buffer[(*length)++] = static_cast<char>('0' + digit);
+    }
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < delta) {
+      *k += kappa;
+      const auto index = -kappa;
+      GrisuRound(buffer, *length, delta, p2, one.f,
+                 wp_w.f * (index < 20 ? kPow10[index] : 0));
+      return;
+    }
+  }
+}
+
+// Writes the shortest digits of a positive value to buffer. The value equals
+// the digits times 10^k.
+void Grisu2(double value, char* buffer, int* length, int* k) {
+  const auto v = FromDouble(value);
+  DiyFp w_minus, w_plus;
+  NormalizedBoundaries(v, &w_minus, &w_plus);
+
+  const auto c_mk = GetCachedPower(w_plus.e, k);
+  const auto w = Multiply(Normalize(v), c_mk);
+  auto wp = Multiply(w_plus, c_mk);
+  auto wm = Multiply(w_minus, c_mk);
+  wm.f++;
+  wp.f--;
+  DigitGen(w, wp, wp.f - wm.f, buffer, length, k);
+}
+
+std::size_t WriteExponent(char* buffer, int exponent) {
+  auto p = buffer;
+  if (exponent < 0) {
+    *p++ = '-';
+    exponent = -exponent;
+  } else {
+    *p++ = '+';
+  }
+
+  if (exponent >= 100) {
+    *p++ = static_cast<char>('0' + exponent / 100);
+    exponent %= 100;
+  }
+  *p++ = static_cast<char>('0' + exponent / 10);
+  *p++ = static_cast<char>('0' + exponent % 10);
+  return static_cast<std::size_t>(p - buffer);
+}
+
+// Formats the digits in buffer with decimal exponent k in place.
+std::size_t Prettify(char* buffer, int length, int k) {
+  // 10^(kk-1) <= value < 10^kk
+  const auto kk = length + k;
+  const auto size = static_cast<std::size_t>(length);
+
+  if (length <= kk && kk <= 21) {
+    // 1234e7 -> 12340000000
+    std::memset(buffer + length, '0', static_cast<std::size_t>(k));
+    return static_cast<std::size_t>(kk);
+  } else if (0 < kk && kk <= 21) {
+    // 1234e-2 -> 12.34
+    std::memmove(buffer + kk + 1, buffer + kk, size - kk);
+    buffer[kk] = '.';
+    return size + 1;
+  } else if (-6 < kk && kk <= 0) {
+    // 1234e-6 -> 0.001234
+    const auto offset = static_cast<std::size_t>(2 - kk);
+    std::memmove(buffer + offset, buffer, size);
+    buffer[0] = '0';
+    buffer[1] = '.';
+    std::memset(buffer + 2, '0', offset - 2);
+    return size + offset;
+  } else if (length == 1) {
+    // 1e30
+    buffer[1] = 'e';
+    return 2 + WriteExponent(buffer + 2, kk - 1);
+  } else {
+    // 1234e30 -> 1.234e33
+    std::memmove(buffer + 2, buffer + 1, size - 1);
+    buffer[1] = '.';
+    buffer[length + 1] = 'e';
+    return size + 2 + WriteExponent(buffer + length + 2, kk - 1);
+  }
+}
+
+}  // namespace
+
+std::size_t FormatDouble(char* buffer, double value) {
+  assert(std::isfinite(value));
+
+  auto p = buffer;
+  if (std::signbit(value)) {
+    *p++ = '-';
+    value = -value;
+  }
+
+  if (value == 0.0) {
+    *p++ = '0';
+    return static_cast<std::size_t>(p - buffer);
+  }
+
+  int length, k;
+  Grisu2(value, p, &length, &k);
+  return static_cast<std::size_t>(p - buffer) + Prettify(p, length, k);
+}
+
+std::size_t FormatUnsigned(char* buffer, std::uint64_t value) {
+  char digits[20];
+  auto count = std::size_t{0};
+  do {
+    digits[count++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+
+  for (std::size_t i = 0; i < count; ++i) {
+    buffer[i] = digits[count - 1 - i];
+  }
+  return count;
+}
+
+std::size_t FormatSigned(char* buffer, std::int64_t value) {
+  if (value < 0) {
+    *buffer = '-';
+    // negate in unsigned arithmetic to support the minimum value
+    return 1 +
+           FormatUnsigned(buffer + 1, 0 - static_cast<std::uint64_t>(value));
+  }
+  return FormatUnsigned(buffer, static_cast<std::uint64_t>(value));
+}
+
+}  // namespace detail
+
+}  // namespace prometheus
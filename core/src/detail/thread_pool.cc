@@ -0,0 +1,119 @@
+#include "prometheus/detail/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+namespace prometheus {
+namespace detail {
+
+struct ThreadPool::Batch {
+  Batch(std::size_t count, const std::function<void(std::size_t)>& task)
+      : count{count}, task{task}, next{0}, done{0} {}
+
+  const std::size_t count;
+  const std::function<void(std::size_t)>& task;
+  std::atomic<std::size_t> next;
+
+  std::mutex mutex;
+  std::condition_variable finished;
+  std::size_t done;
+  std::exception_ptr error;
+};
+
+ThreadPool::ThreadPool(const std::size_t num_threads) : stopping_{false} {
+  workers_.reserve(num_threads);
+  for (std::size_t i = 0; i < num_threads; ++i) {
+    workers_.emplace_back([this] { Work(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+std::size_t ThreadPool::GetNumThreads() const { return workers_.size(); }
+
+void ThreadPool::ParallelFor(const std::size_t count,
+                             const std::function<void(std::size_t)>& task) {
+  if (count == 0) {
+    return;
+  }
+
+  if (workers_.empty() || count == 1) {
+    for (std::size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  auto batch = std::make_shared<Batch>(count, task);
+  const auto helpers = std::min(count - 1, workers_.size());
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (std::size_t i = 0; i < helpers; ++i) {
+      queue_.push_back(batch);
+    }
+  }
+  condition_.notify_all();
+
+  Run(*batch);
+
+  std::unique_lock<std::mutex> lock{batch->mutex};
+  batch->finished.wait(lock, [&batch] { return batch->done == batch->count; });
+  if (batch->error) {
+    std::rethrow_exception(batch->error);
+  }
+}
+
+void ThreadPool::Run(Batch& batch) {
+  // A worker may pick up a batch after the caller already returned from
+  // ParallelFor(). The task must not be touched unless an index was claimed.
+  for (;;) {
+    const auto index = batch.next.fetch_add(1);
+    if (index >= batch.count) {
+      return;
+    }
+
+    auto error = std::exception_ptr{};
+    try {
+      batch.task(index);
+    } catch (...) {
+      error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock{batch.mutex};
+    if (error && !batch.error) {
+      batch.error = error;
+    }
+    if (++batch.done == batch.count) {
+      batch.finished.notify_all();
+    }
+  }
+}
+
+void ThreadPool::Work() {
+  for (;;) {
+    std::shared_ptr<Batch> batch;
+    {
+      std::unique_lock<std::mutex> lock{mutex_};
+      condition_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      batch = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    Run(*batch);
+  }
+}
+
+}  // namespace detail
+}  // namespace prometheus
@@ -1,6 +1,7 @@
 #include "prometheus/detail/utils.h"
 #include "hash.h"
 
+#include <chrono>
 #include <numeric>
 
 namespace prometheus {
@@ -16,6 +17,12 @@ std::size_t hash_labels(const std::map<std::string, std::string>& labels) {
   return seed;
 }
 
+std::int64_t CurrentTimestampMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
 }  // namespace detail
 
 }  // namespace prometheus
@@ -81,6 +81,21 @@ std::vector<MetricFamily> Family<T>::Collect() const {
   return {family};
 }
 
+template <typename T>
+void Family<T>::CollectTo(MetricSink& sink) const {
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    static const auto no_label = std::vector<ClientMetric::Label>{};
+    sink.AddFamily(name_, help_, T::metric_type);
+    for (const auto& m : metrics_) {
+      m.second->Collect(
+          sink, MetricSink::Series{no_label, constant_labels_,
+                                   labels_.at(m.first), 0});
+    }
+  }
+  sink.Flush();
+}
+
 template <typename T>
 ClientMetric Family<T>::CollectMetric(std::size_t hash, T* metric) const {
   auto collected = metric->Collect();
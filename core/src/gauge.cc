@@ -45,4 +45,11 @@ ClientMetric Gauge::Collect() const {
   return metric;
 }
 
+void Gauge::Collect(MetricSink& sink,
+                    const MetricSink::Series& series) const {
+  ClientMetric::Gauge gauge;
+  gauge.value = Value();
+  sink.AddMetric(series, gauge);
+}
+
 }  // namespace prometheus
@@ -3,13 +3,19 @@
 #include <algorithm>
 #include <cassert>
 #include <iterator>
+#include <limits>
 #include <numeric>
 #include <ostream>
 
+#include "prometheus/detail/utils.h"
+
 namespace prometheus {
 
 Histogram::Histogram(const BucketBoundaries& buckets)
-    : bucket_boundaries_{buckets}, bucket_counts_{buckets.size() + 1}, sum_{} {
+    : bucket_boundaries_{buckets},
+      bucket_counts_(buckets.size() + 1),
+      sum_{},
+      created_timestamp_ms_{detail::CurrentTimestampMs()} {
   assert(std::is_sorted(std::begin(bucket_boundaries_),
                         std::end(bucket_boundaries_)));
 }
@@ -44,8 +50,20 @@ void Histogram::ObserveMultiple(const std::vector<double>& bucket_increments,
 
 ClientMetric Histogram::Collect() const {
   auto metric = ClientMetric{};
+  CollectHistogram(metric.histogram);
+  return metric;
+}
 
+void Histogram::Collect(MetricSink& sink,
+                        const MetricSink::Series& series) const {
+  auto& histogram = sink.GetHistogramBuffer();
+  CollectHistogram(histogram);
+  sink.AddMetric(series, histogram);
+}
+
+void Histogram::CollectHistogram(ClientMetric::Histogram& histogram) const {
   auto cumulative_count = 0ULL;
+  histogram.bucket.reserve(bucket_counts_.size());
   for (std::size_t i{0}; i < bucket_counts_.size(); ++i) {
     cumulative_count += bucket_counts_[i].Value();
     auto bucket = ClientMetric::Bucket{};
@@ -53,12 +71,11 @@ ClientMetric Histogram::Collect() const {
     bucket.upper_bound = (i == bucket_boundaries_.size()
                               ? std::numeric_limits<double>::infinity()
                               : bucket_boundaries_[i]);
-    metric.histogram.bucket.push_back(std::move(bucket));
+    histogram.bucket.push_back(std::move(bucket));
   }
-  metric.histogram.sample_count = cumulative_count;
-  metric.histogram.sample_sum = sum_.Value();
-
-  return metric;
+  histogram.sample_count = cumulative_count;
+  histogram.sample_sum = sum_.Value();
+  histogram.created_timestamp_ms = created_timestamp_ms_;
 }
 
 }  // namespace prometheus
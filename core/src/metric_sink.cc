@@ -0,0 +1,44 @@
+#include "prometheus/metric_sink.h"
+
+namespace prometheus {
+
+void MetricSink::AddClientMetric(const MetricType type,
+                                 const ClientMetric& metric) {
+  static const auto no_labels = Labels{};
+  const auto series =
+      Series{metric.label, no_labels, no_labels, metric.timestamp_ms};
+
+  switch (type) {
+    case MetricType::Counter:
+      AddMetric(series, metric.counter);
+      break;
+    case MetricType::Gauge:
+      AddMetric(series, metric.gauge);
+      break;
+    case MetricType::Summary:
+      AddMetric(series, metric.summary);
+      break;
+    case MetricType::Untyped:
+      AddMetric(series, metric.untyped);
+      break;
+    case MetricType::Histogram:
+      AddMetric(series, metric.histogram);
+      break;
+  }
+}
+
+ClientMetric::Histogram& MetricSink::GetHistogramBuffer() {
+  histogram_buffer_.sample_count = 0;
+  histogram_buffer_.sample_sum = 0.0;
+  histogram_buffer_.bucket.clear();
+  return histogram_buffer_;
+}
+
+ClientMetric::Summary& MetricSink::GetSummaryBuffer() {
+  summary_buffer_.sample_count = 0;
+  summary_buffer_.sample_sum = 0.0;
+  summary_buffer_.quantile.clear();
+  return summary_buffer_;
+}
+
+}  // namespace prometheus
@@ -0,0 +1,35 @@
+#include "prometheus/name_filter.h"
+
+namespace prometheus {
+
+NameFilter::NameFilter(const std::vector<std::string>& patterns) {
+  for (auto& pattern : patterns) {
+    Add(pattern);
+  }
+}
+
+void NameFilter::Add(const std::string& pattern) {
+  if (!pattern.empty() && pattern.back() == '*') {
+    prefixes_.push_back(pattern.substr(0, pattern.size() - 1));
+  } else {
+    names_.insert(pattern);
+  }
+}
+
+bool NameFilter::MatchesAll() const {
+  return names_.empty() && prefixes_.empty();
+}
+
+bool NameFilter::Matches(const std::string& name) const {
+  if (MatchesAll() || names_.count(name) > 0) {
+    return true;
+  }
+  for (auto& prefix : prefixes_) {
+    if (name.compare(0, prefix.size(), prefix) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace prometheus
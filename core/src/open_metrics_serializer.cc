@@ -0,0 +1,311 @@
+#include "prometheus/open_metrics_serializer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "prometheus/collectable.h"
+#include "prometheus/detail/number_format.h"
+#include "prometheus/metric_sink.h"
+#include "prometheus/output_buffer.h"
+
+namespace prometheus {
+
+const char* const OpenMetricsSerializer::kContentType =
+    "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+namespace {
+
+const std::string kTotalSuffix = "_total";
+
+void WriteValue(OutputBuffer& out, double value) {
+  if (std::isnan(value)) {
+    out.Write("NaN");
+  } else if (std::isinf(value)) {
+    out.Write(value < 0 ? "-Inf" : "+Inf");
+  } else {
+    auto buffer = out.Reserve(detail::kNumberBufferSize);
+    out.Commit(detail::FormatDouble(buffer, value));
+  }
+}
+
+void WriteValue(OutputBuffer& out, std::uint64_t value) {
+  auto buffer = out.Reserve(detail::kNumberBufferSize);
+  out.Commit(detail::FormatUnsigned(buffer, value));
+}
+
+// Write a timestamp in seconds as required by OpenMetrics
+void WriteTimestamp(OutputBuffer& out, std::int64_t timestamp_ms) {
+  WriteValue(out, static_cast<double>(timestamp_ms) / 1000);
+}
+
+// Write a label value or help text with backslash, newline and double quote
+// escaped
+void WriteEscaped(OutputBuffer& out, const std::string& value) {
+  auto begin = value.data();
+  auto end = begin + value.size();
+  for (auto c = begin; c != end; ++c) {
+    const char* escaped;
+    switch (*c) {
+      case '\n':
+        escaped = "\\n";
+        break;
+
+      case '\\':
+        escaped = "\\\\";
+        break;
+
+      case '"':
+        escaped = "\\\"";
+        break;
+
+      default:
+        continue;
+    }
+    out.Write(begin, static_cast<std::size_t>(c - begin));
+    out.Write(escaped, 2);
+    begin = c + 1;
+  }
+  out.Write(begin, static_cast<std::size_t>(end - begin));
+}
+
+// Write the canonical form of le and quantile label values, which always
+// contains a fraction or an exponent, e.g., "1.0" instead of "1"
+void WriteCanonicalValue(OutputBuffer& out, double value) {
+  if (!std::isfinite(value)) {
+    WriteValue(out, value);
+    return;
+  }
+  auto buffer = out.Reserve(detail::kNumberBufferSize + 2);
+  auto size = detail::FormatDouble(buffer, value);
+  if (std::find_if(buffer, buffer + size, [](char c) {
+        return c == '.' || c == 'e';
+      }) == buffer + size) {
+    buffer[size++] = '.';
+    buffer[size++] = '0';
+  }
+  out.Commit(size);
+}
+
+using Series = MetricSink::Series;
+
+void WriteLabel(OutputBuffer& out, const char*& prefix, const std::string& name,
+                const std::string& value) {
+  out.Write(prefix);
+  out.Write(name);
+  out.Write("=\"");
+  WriteEscaped(out, value);
+  out.Write('"');
+  prefix = ",";
+}
+
+// Write a line header: metric name and labels, with an optional extra label
+// holding a number
+void WriteHead(OutputBuffer& out, const std::string& name, const char* suffix,
+               const Series& series, const char* extraLabelName = nullptr,
+               double extraLabelValue = 0.0) {
+  out.Write(name);
+  out.Write(suffix);
+  if (!series.label.empty() || !series.constant_labels.empty() ||
+      !series.labels.empty() || extraLabelName) {
+    out.Write('{');
+    const char* prefix = "";
+
+    for (auto& lp : series.label) {
+      WriteLabel(out, prefix, lp.name, lp.value);
+    }
+    for (auto& lp : series.constant_labels) {
+      WriteLabel(out, prefix, lp.first, lp.second);
+    }
+    for (auto& lp : series.labels) {
+      WriteLabel(out, prefix, lp.first, lp.second);
+    }
+    if (extraLabelName) {
+      out.Write(prefix);
+      out.Write(extraLabelName);
+      out.Write("=\"");
+      WriteCanonicalValue(out, extraLabelValue);
+      out.Write('"');
+    }
+    out.Write('}');
+  }
+  out.Write(' ');
+}
+
+// Write a line trailer: timestamp
+void WriteTail(OutputBuffer& out, const Series& series) {
+  if (series.timestamp_ms != 0) {
+    out.Write(' ');
+    WriteTimestamp(out, series.timestamp_ms);
+  }
+  out.Write('\n');
+}
+
+void WriteCreated(OutputBuffer& out, const std::string& name,
+                  const Series& series, std::int64_t created_timestamp_ms) {
+  if (created_timestamp_ms == 0) {
+    return;
+  }
+  WriteHead(out, name, "_created", series);
+  WriteTimestamp(out, created_timestamp_ms);
+  WriteTail(out, series);
+}
+
+template <typename T>
+void SerializeValue(OutputBuffer& out, const std::string& name,
+                    const char* suffix, const Series& series, T value) {
+  WriteHead(out, name, suffix, series);
+  WriteValue(out, value);
+  WriteTail(out, series);
+}
+
+void SerializeSummary(OutputBuffer& out, const std::string& name,
+                      const Series& series, const ClientMetric::Summary& sum) {
+  for (auto& q : sum.quantile) {
+    WriteHead(out, name, "", series, "quantile", q.quantile);
+    WriteValue(out, q.value);
+    WriteTail(out, series);
+  }
+
+  SerializeValue(out, name, "_count", series, sum.sample_count);
+  SerializeValue(out, name, "_sum", series, sum.sample_sum);
+  WriteCreated(out, name, series, sum.created_timestamp_ms);
+}
+
+void SerializeHistogram(OutputBuffer& out, const std::string& name,
+                        const Series& series,
+                        const ClientMetric::Histogram& hist) {
+  double last = -std::numeric_limits<double>::infinity();
+  for (auto& b : hist.bucket) {
+    WriteHead(out, name, "_bucket", series, "le", b.upper_bound);
+    last = b.upper_bound;
+    WriteValue(out, b.cumulative_count);
+    WriteTail(out, series);
+  }
+
+  if (last != std::numeric_limits<double>::infinity()) {
+    WriteHead(out, name, "_bucket", series, "le",
+              std::numeric_limits<double>::infinity());
+    WriteValue(out, hist.sample_count);
+    WriteTail(out, series);
+  }
+
+  SerializeValue(out, name, "_count", series, hist.sample_count);
+  SerializeValue(out, name, "_sum", series, hist.sample_sum);
+  WriteCreated(out, name, series, hist.created_timestamp_ms);
+}
+
+// Serializes the metrics passed by a Collectable as they arrive
+class OpenMetricsSink : public MetricSink {
+ public:
+  explicit OpenMetricsSink(OutputBuffer& out) : out_(out) {}
+
+  void AddFamily(const std::string& name, const std::string& help,
+                 MetricType type) override {
+    // The samples of a counter end with _total, which is not part of the
+    // name of its family
+    name_ = name;
+    if (type == MetricType::Counter && name_.size() > kTotalSuffix.size() &&
+        name_.compare(name_.size() - kTotalSuffix.size(), kTotalSuffix.size(),
+                      kTotalSuffix) == 0) {
+      name_.resize(name_.size() - kTotalSuffix.size());
+    }
+
+    out_.Write("# TYPE ");
+    out_.Write(name_);
+    switch (type) {
+      case MetricType::Counter:
+        out_.Write(" counter\n");
+        break;
+      case MetricType::Gauge:
+        out_.Write(" gauge\n");
+        break;
+      case MetricType::Summary:
+        out_.Write(" summary\n");
+        break;
+      case MetricType::Untyped:
+        out_.Write(" unknown\n");
+        break;
+      case MetricType::Histogram:
+        out_.Write(" histogram\n");
+        break;
+    }
+    if (!help.empty()) {
+      out_.Write("# HELP ");
+      out_.Write(name_);
+      out_.Write(' ');
+      WriteEscaped(out_, help);
+      out_.Write('\n');
+    }
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Counter& counter) override {
+    SerializeValue(out_, name_, "_total", series, counter.value);
+    WriteCreated(out_, name_, series, counter.created_timestamp_ms);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Gauge& gauge) override {
+    SerializeValue(out_, name_, "", series, gauge.value);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Summary& summary) override {
+    SerializeSummary(out_, name_, series, summary);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Histogram& histogram) override {
+    SerializeHistogram(out_, name_, series, histogram);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Untyped& untyped) override {
+    SerializeValue(out_, name_, "", series, untyped.value);
+  }
+
+ private:
+  OutputBuffer& out_;
+  std::string name_;
+};
+
+void SerializeFamily(OutputBuffer& out, const MetricFamily& family) {
+  OpenMetricsSink sink{out};
+  sink.AddFamily(family.name, family.help, family.type);
+  for (auto& metric : family.metric) {
+    sink.AddClientMetric(family.type, metric);
+  }
+}
+}  // namespace
+
+void OpenMetricsSerializer::Serialize(
+    std::ostream& out, const std::vector<MetricFamily>& metrics) const {
+  StreamOutputBuffer buffer{out};
+  Serialize(buffer, metrics);
+}
+
+void OpenMetricsSerializer::Serialize(
+    OutputBuffer& out, const std::vector<MetricFamily>& metrics) const {
+  for (auto& family : metrics) {
+    SerializeFamily(out, family);
+  }
+  SerializeTrailer(out);
+}
+
+void OpenMetricsSerializer::Serialize(OutputBuffer& out,
+                                      const MetricFamily& family) const {
+  SerializeFamily(out, family);
+}
+
+void OpenMetricsSerializer::Serialize(OutputBuffer& out,
+                                      const Collectable& collectable) const {
+  OpenMetricsSink sink{out};
+  collectable.CollectTo(sink);
+}
+
+void OpenMetricsSerializer::SerializeTrailer(OutputBuffer& out) const {
+  out.Write("# EOF\n");
+}
+}  // namespace prometheus
@@ -0,0 +1,63 @@
+#include "prometheus/output_buffer.h"
+
+#include <algorithm>
+#include <ostream>
+
+namespace prometheus {
+
+void OutputBuffer::WriteSlow(const char* data, std::size_t size) {
+  for (;;) {
+    const auto count =
+        std::min(size, static_cast<std::size_t>(end_ - next_));
+    std::memcpy(next_, data, count);
+    next_ += count;
+    data += count;
+    size -= count;
+    if (size == 0) {
+      return;
+    }
+    Grow(1, size);
+  }
+}
+
+std::size_t StringOutputBuffer::GetSize() const {
+  return static_cast<std::size_t>(GetNext() - storage_.data());
+}
+
+std::string StringOutputBuffer::ToString() const {
+  return std::string(GetData(), GetSize());
+}
+
+void StringOutputBuffer::Clear() {
+  SetWindow(storage_.data(), storage_.data() + storage_.size());
+}
+
+void StringOutputBuffer::Grow(std::size_t, std::size_t size) {
+  const auto used = GetSize();
+  const auto minimum_capacity = std::size_t{1024};
+  storage_.resize(
+      std::max({storage_.size() * 2, used + size, minimum_capacity}));
+  SetWindow(storage_.data() + used, storage_.data() + storage_.size());
+}
+
+StreamOutputBuffer::StreamOutputBuffer(std::ostream& out)
+    : out_(out), storage_(4096) {
+  SetWindow(storage_.data(), storage_.data() + storage_.size());
+}
+
+StreamOutputBuffer::~StreamOutputBuffer() { Flush(); }
+
+void StreamOutputBuffer::Flush() {
+  out_.write(storage_.data(), GetNext() - storage_.data());
+  SetWindow(storage_.data(), storage_.data() + storage_.size());
+}
+
+void StreamOutputBuffer::Grow(std::size_t min_size, std::size_t) {
+  Flush();
+  if (min_size > storage_.size()) {
+    storage_.resize(min_size);
+    SetWindow(storage_.data(), storage_.data() + storage_.size());
+  }
+}
+
+}  // namespace prometheus
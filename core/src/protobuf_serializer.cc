@@ -0,0 +1,290 @@
+#include "prometheus/protobuf_serializer.h"
+
+#include <cstdint>
+
+#include "prometheus/collectable.h"
+#include "prometheus/detail/protobuf_wire.h"
+#include "prometheus/metric_sink.h"
+#include "prometheus/output_buffer.h"
+
+namespace prometheus {
+
+const char* const ProtobufSerializer::kContentType =
+    "application/vnd.google.protobuf; "
+    "proto=io.prometheus.client.MetricFamily; encoding=delimited";
+
+namespace {
+
+using detail::kDoubleFieldSize;
+using detail::LengthDelimitedSize;
+using detail::VarintFieldSize;
+using detail::WriteDoubleField;
+using detail::WriteLengthDelimitedHead;
+using detail::WriteStringField;
+using detail::WriteVarint;
+using detail::WriteVarintField;
+
+// Field numbers of the messages in io.prometheus.client (metrics.proto)
+enum : std::uint32_t {
+  kLabelPairName = 1,
+  kLabelPairValue = 2,
+  kValue = 1,  // value of Counter, Gauge and Untyped
+  kQuantileQuantile = 1,
+  kQuantileValue = 2,
+  kSampleCount = 1,  // of Summary and Histogram
+  kSampleSum = 2,
+  kQuantiles = 3,
+  kBuckets = 3,
+  kBucketCumulativeCount = 1,
+  kBucketUpperBound = 2,
+  kMetricLabel = 1,
+  kMetricGauge = 2,
+  kMetricCounter = 3,
+  kMetricSummary = 4,
+  kMetricUntyped = 5,
+  kMetricTimestampMs = 6,
+  kMetricHistogram = 7,
+  kFamilyName = 1,
+  kFamilyHelp = 2,
+  kFamilyType = 3,
+  kFamilyMetric = 4,
+};
+
+using Series = MetricSink::Series;
+
+std::size_t LabelPairSize(const std::string& name, const std::string& value) {
+  return LengthDelimitedSize(name.size()) + LengthDelimitedSize(value.size());
+}
+
+void WriteLabelPair(OutputBuffer& out, const std::string& name,
+                    const std::string& value) {
+  WriteLengthDelimitedHead(out, kMetricLabel, LabelPairSize(name, value));
+  WriteStringField(out, kLabelPairName, name);
+  WriteStringField(out, kLabelPairValue, value);
+}
+
+std::size_t LabelsSize(const Series& series) {
+  auto size = std::size_t{0};
+  for (auto& lp : series.label) {
+    size += LengthDelimitedSize(LabelPairSize(lp.name, lp.value));
+  }
+  for (auto& lp : series.constant_labels) {
+    size += LengthDelimitedSize(LabelPairSize(lp.first, lp.second));
+  }
+  for (auto& lp : series.labels) {
+    size += LengthDelimitedSize(LabelPairSize(lp.first, lp.second));
+  }
+  return size;
+}
+
+void WriteLabels(OutputBuffer& out, const Series& series) {
+  for (auto& lp : series.label) {
+    WriteLabelPair(out, lp.name, lp.value);
+  }
+  for (auto& lp : series.constant_labels) {
+    WriteLabelPair(out, lp.first, lp.second);
+  }
+  for (auto& lp : series.labels) {
+    WriteLabelPair(out, lp.first, lp.second);
+  }
+}
+
+std::size_t ValueSize(double) { return kDoubleFieldSize; }
+
+void WriteValue(OutputBuffer& out, double value) {
+  WriteDoubleField(out, kValue, value);
+}
+
+const std::size_t kQuantileSize = 2 * kDoubleFieldSize;
+
+std::size_t ValueSize(const ClientMetric::Summary& summary) {
+  return VarintFieldSize(summary.sample_count) + kDoubleFieldSize +
+         summary.quantile.size() * LengthDelimitedSize(kQuantileSize);
+}
+
+void WriteValue(OutputBuffer& out, const ClientMetric::Summary& summary) {
+  WriteVarintField(out, kSampleCount, summary.sample_count);
+  WriteDoubleField(out, kSampleSum, summary.sample_sum);
+  for (auto& q : summary.quantile) {
+    WriteLengthDelimitedHead(out, kQuantiles, kQuantileSize);
+    WriteDoubleField(out, kQuantileQuantile, q.quantile);
+    WriteDoubleField(out, kQuantileValue, q.value);
+  }
+}
+
+std::size_t BucketSize(const ClientMetric::Bucket& bucket) {
+  return VarintFieldSize(bucket.cumulative_count) + kDoubleFieldSize;
+}
+
+std::size_t ValueSize(const ClientMetric::Histogram& histogram) {
+  auto size = VarintFieldSize(histogram.sample_count) + kDoubleFieldSize;
+  for (auto& b : histogram.bucket) {
+    size += LengthDelimitedSize(BucketSize(b));
+  }
+  return size;
+}
+
+void WriteValue(OutputBuffer& out, const ClientMetric::Histogram& histogram) {
+  WriteVarintField(out, kSampleCount, histogram.sample_count);
+  WriteDoubleField(out, kSampleSum, histogram.sample_sum);
+  for (auto& b : histogram.bucket) {
+    WriteLengthDelimitedHead(out, kBuckets, BucketSize(b));
+    WriteVarintField(out, kBucketCumulativeCount, b.cumulative_count);
+    WriteDoubleField(out, kBucketUpperBound, b.upper_bound);
+  }
+}
+
+std::uint64_t ToVarint(std::int64_t value) {
+  // int64 is encoded as its two's complement
+  return static_cast<std::uint64_t>(value);
+}
+
+// Encodes the families passed by a Collectable as they arrive. The metrics of
+// the current family are kept until the family is complete, as the length of
+// the family precedes them.
+class ProtobufSink : public MetricSink {
+ public:
+  explicit ProtobufSink(OutputBuffer& out) : out_(out), type_{} {}
+
+  void AddFamily(const std::string& name, const std::string& help,
+                 MetricType type) override {
+    Finish();
+    name_ = name;
+    help_ = help;
+    type_ = type;
+    in_family_ = true;
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Counter& counter) override {
+    WriteMetric(series, kMetricCounter, counter.value);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Gauge& gauge) override {
+    WriteMetric(series, kMetricGauge, gauge.value);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Summary& summary) override {
+    WriteMetric(series, kMetricSummary, summary);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Histogram& histogram) override {
+    WriteMetric(series, kMetricHistogram, histogram);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Untyped& untyped) override {
+    WriteMetric(series, kMetricUntyped, untyped.value);
+  }
+
+  // The family is complete once the collectable flushes
+  void Flush() override { Finish(); }
+
+  // Writes the current family to the output
+  void Finish() {
+    if (!in_family_) {
+      return;
+    }
+
+    const auto type = ProtoType(type_);
+    auto size = LengthDelimitedSize(name_.size()) + VarintFieldSize(type) +
+                metrics_.GetSize();
+    if (!help_.empty()) {
+      size += LengthDelimitedSize(help_.size());
+    }
+
+    WriteVarint(out_, size);
+    WriteStringField(out_, kFamilyName, name_);
+    if (!help_.empty()) {
+      WriteStringField(out_, kFamilyHelp, help_);
+    }
+    WriteVarintField(out_, kFamilyType, type);
+    out_.Write(metrics_.GetData(), metrics_.GetSize());
+
+    metrics_.Clear();
+    in_family_ = false;
+  }
+
+ private:
+  static std::uint64_t ProtoType(MetricType type) {
+    switch (type) {
+      case MetricType::Counter:
+        return 0;
+      case MetricType::Gauge:
+        return 1;
+      case MetricType::Summary:
+        return 2;
+      case MetricType::Untyped:
+        return 3;
+      case MetricType::Histogram:
+        return 4;
+    }
+    return 3;
+  }
+
+  template <typename T>
+  void WriteMetric(const Series& series, std::uint32_t field, const T& value) {
+    const auto value_size = ValueSize(value);
+    auto size = LabelsSize(series) + LengthDelimitedSize(value_size);
+    if (series.timestamp_ms != 0) {
+      size += VarintFieldSize(ToVarint(series.timestamp_ms));
+    }
+
+    WriteLengthDelimitedHead(metrics_, kFamilyMetric, size);
+    WriteLabels(metrics_, series);
+    WriteLengthDelimitedHead(metrics_, field, value_size);
+    WriteValue(metrics_, value);
+    if (series.timestamp_ms != 0) {
+      WriteVarintField(metrics_, kMetricTimestampMs,
+                       ToVarint(series.timestamp_ms));
+    }
+  }
+
+  OutputBuffer& out_;
+  StringOutputBuffer metrics_;
+  std::string name_;
+  std::string help_;
+  MetricType type_;
+  bool in_family_ = false;
+};
+
+void SerializeFamily(ProtobufSink& sink, const MetricFamily& family) {
+  sink.AddFamily(family.name, family.help, family.type);
+  for (auto& metric : family.metric) {
+    sink.AddClientMetric(family.type, metric);
+  }
+}
+}  // namespace
+
+void ProtobufSerializer::Serialize(
+    std::ostream& out, const std::vector<MetricFamily>& metrics) const {
+  StreamOutputBuffer buffer{out};
+  Serialize(buffer, metrics);
+}
+
+void ProtobufSerializer::Serialize(
+    OutputBuffer& out, const std::vector<MetricFamily>& metrics) const {
+  ProtobufSink sink{out};
+  for (auto& family : metrics) {
+    SerializeFamily(sink, family);
+  }
+  sink.Finish();
+}
+
+void ProtobufSerializer::Serialize(OutputBuffer& out,
+                                   const MetricFamily& family) const {
+  ProtobufSink sink{out};
+  SerializeFamily(sink, family);
+  sink.Finish();
+}
+
+void ProtobufSerializer::Serialize(OutputBuffer& out,
+                                   const Collectable& collectable) const {
+  ProtobufSink sink{out};
+  collectable.CollectTo(sink);
+  sink.Finish();
+}
+}  // namespace prometheus
@@ -1,8 +1,10 @@
 #include "prometheus/registry.h"
 
 #include "prometheus/counter.h"
+#include "prometheus/detail/thread_pool.h"
 #include "prometheus/gauge.h"
 #include "prometheus/histogram.h"
+#include "prometheus/name_filter.h"
 #include "prometheus/summary.h"
 
 #include <iterator>
@@ -19,6 +21,36 @@ void CollectAll(std::vector<MetricFamily>& results, const T& families) {
   }
 }
 
+template <typename T>
+void CollectMatching(std::vector<MetricFamily>& results, const T& families,
+                     const NameFilter& filter) {
+  for (auto&& collectable : families) {
+    if (!filter.Matches(collectable->GetName())) {
+      continue;
+    }
+    auto metrics = collectable->Collect();
+    results.insert(results.end(), std::make_move_iterator(metrics.begin()),
+                   std::make_move_iterator(metrics.end()));
+  }
+}
+
+template <typename T>
+void GatherAll(std::vector<const Collectable*>& results, const T& families) {
+  for (auto&& collectable : families) {
+    results.push_back(collectable.get());
+  }
+}
+
+template <typename T>
+void GatherMatching(std::vector<const Collectable*>& results, const T& families,
+                    const NameFilter& filter) {
+  for (auto&& collectable : families) {
+    if (filter.Matches(collectable->GetName())) {
+      results.push_back(collectable.get());
+    }
+  }
+}
+
 bool FamilyNameExists(const std::string& /* name */) { return false; }
 
 template <typename T, typename... Args>
@@ -50,6 +82,75 @@ std::vector<MetricFamily> Registry::Collect() const {
   return results;
 }
 
+std::vector<MetricFamily> Registry::CollectConcurrently(
+    detail::ThreadPool& pool) const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto families = std::vector<const Collectable*>{};
+
+  GatherAll(families, counters_);
+  GatherAll(families, gauges_);
+  GatherAll(families, histograms_);
+  GatherAll(families, summaries_);
+
+  auto collected = std::vector<std::vector<MetricFamily>>(families.size());
+  pool.ParallelFor(families.size(), [&families, &collected](std::size_t i) {
+    collected[i] = families[i]->Collect();
+  });
+
+  auto results = std::vector<MetricFamily>{};
+  for (auto&& metrics : collected) {
+    results.insert(results.end(), std::make_move_iterator(metrics.begin()),
+                   std::make_move_iterator(metrics.end()));
+  }
+  return results;
+}
+
+void Registry::CollectTo(MetricSink& sink) const {
+  // Families are never removed, so they are collected without holding the
+  // lock. The sink may flush between families.
+  auto families = std::vector<const Collectable*>{};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    GatherAll(families, counters_);
+    GatherAll(families, gauges_);
+    GatherAll(families, histograms_);
+    GatherAll(families, summaries_);
+  }
+
+  for (auto family : families) {
+    family->CollectTo(sink);
+  }
+}
+
+std::vector<MetricFamily> Registry::CollectFiltered(
+    const NameFilter& filter) const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto results = std::vector<MetricFamily>{};
+
+  CollectMatching(results, counters_, filter);
+  CollectMatching(results, gauges_, filter);
+  CollectMatching(results, histograms_, filter);
+  CollectMatching(results, summaries_, filter);
+
+  return results;
+}
+
+void Registry::CollectFilteredTo(MetricSink& sink,
+                                 const NameFilter& filter) const {
+  auto families = std::vector<const Collectable*>{};
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    GatherMatching(families, counters_, filter);
+    GatherMatching(families, gauges_, filter);
+    GatherMatching(families, histograms_, filter);
+    GatherMatching(families, summaries_, filter);
+  }
+
+  for (auto family : families) {
+    family->CollectTo(sink);
+  }
+}
+
 template <>
 std::vector<std::unique_ptr<Family<Counter>>>& Registry::GetFamilies() {
   return counters_;
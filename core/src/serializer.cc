@@ -1,13 +1,175 @@
 #include "prometheus/serializer.h"
 
-#include <sstream>
+#include <ostream>
+#include <streambuf>
+
+#include "prometheus/detail/thread_pool.h"
+#include "prometheus/metric_sink.h"
 
 namespace prometheus {
 
+namespace {
+
+// Passes the output of a std::ostream to an OutputBuffer
+class OutputBufferStreamBuf : public std::streambuf {
+ public:
+  explicit OutputBufferStreamBuf(OutputBuffer& out) : out_(out) {}
+
+ protected:
+  int_type overflow(int_type ch) override {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+      out_.Write(traits_type::to_char_type(ch));
+    }
+    return traits_type::not_eof(ch);
+  }
+
+  std::streamsize xsputn(const char* data, std::streamsize size) override {
+    out_.Write(data, static_cast<std::size_t>(size));
+    return size;
+  }
+
+ private:
+  OutputBuffer& out_;
+};
+
+// Moves the output held back in pending to out
+void WritePending(StringOutputBuffer& pending, OutputBuffer& out) {
+  out.Write(pending.GetData(), pending.GetSize());
+  pending.Clear();
+}
+
+// Forwards everything to another sink and moves the output of the serializer
+// to out whenever it is flushed
+class PendingSink : public MetricSink {
+ public:
+  PendingSink(MetricSink& sink, StringOutputBuffer& pending, OutputBuffer& out)
+      : sink_(sink), pending_(pending), out_(out) {}
+
+  void AddFamily(const std::string& name, const std::string& help,
+                 MetricType type) override {
+    sink_.AddFamily(name, help, type);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Counter& counter) override {
+    sink_.AddMetric(series, counter);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Gauge& gauge) override {
+    sink_.AddMetric(series, gauge);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Summary& summary) override {
+    sink_.AddMetric(series, summary);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Histogram& histogram) override {
+    sink_.AddMetric(series, histogram);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Untyped& untyped) override {
+    sink_.AddMetric(series, untyped);
+  }
+
+  void Flush() override {
+    sink_.Flush();
+    WritePending(pending_, out_);
+  }
+
+ private:
+  MetricSink& sink_;
+  StringOutputBuffer& pending_;
+  OutputBuffer& out_;
+};
+
+// Wraps the sink passed by the serializer into a PendingSink
+class PendingCollectable : public Collectable {
+ public:
+  PendingCollectable(const Collectable& collectable,
+                     StringOutputBuffer& pending, OutputBuffer& out)
+      : collectable_(collectable), pending_(pending), out_(out) {}
+
+  std::vector<MetricFamily> Collect() const override {
+    return collectable_.Collect();
+  }
+
+  void CollectTo(MetricSink& sink) const override {
+    PendingSink pending_sink{sink, pending_, out_};
+    collectable_.CollectTo(pending_sink);
+  }
+
+ private:
+  const Collectable& collectable_;
+  StringOutputBuffer& pending_;
+  OutputBuffer& out_;
+};
+}  // namespace
+
 std::string Serializer::Serialize(
     const std::vector<MetricFamily> &metrics) const {
-  std::ostringstream ss;
-  Serialize(ss, metrics);
-  return ss.str();
+  StringOutputBuffer out;
+  Serialize(out, metrics);
+  return out.ToString();
+}
+
+void Serializer::Serialize(OutputBuffer &out,
+                           const std::vector<MetricFamily> &metrics) const {
+  OutputBufferStreamBuf buffer{out};
+  std::ostream stream{&buffer};
+  Serialize(stream, metrics);
+}
+
+void Serializer::Serialize(OutputBuffer &out,
+                           const MetricFamily &family) const {
+  Serialize(out, std::vector<MetricFamily>{family});
+}
+
+void Serializer::Serialize(OutputBuffer &out,
+                           const Collectable &collectable) const {
+  for (auto &family : collectable.Collect()) {
+    Serialize(out, family);
+  }
+}
+
+void Serializer::SerializeOutsideLocks(OutputBuffer &out,
+                                       const Collectable &collectable,
+                                       StringOutputBuffer &pending) const {
+  pending.Clear();
+  Serialize(pending, PendingCollectable{collectable, pending, out});
+  WritePending(pending, out);
+}
+
+std::string Serializer::Serialize(const Collectable &collectable) const {
+  StringOutputBuffer out;
+  Serialize(out, collectable);
+  SerializeTrailer(out);
+  return out.ToString();
+}
+
+void Serializer::SerializeTrailer(OutputBuffer &) const {}
+
+std::string Serializer::Serialize(const std::vector<MetricFamily> &metrics,
+                                  detail::ThreadPool &pool) const {
+  StringOutputBuffer out;
+  Serialize(out, metrics, pool);
+  return out.ToString();
+}
+
+void Serializer::Serialize(OutputBuffer &out,
+                           const std::vector<MetricFamily> &metrics,
+                           detail::ThreadPool &pool) const {
+  auto chunks = std::vector<StringOutputBuffer>(metrics.size());
+  pool.ParallelFor(metrics.size(), [this, &metrics, &chunks](std::size_t i) {
+    Serialize(chunks[i], metrics[i]);
+  });
+
+  for (auto &chunk : chunks) {
+    out.Write(chunk.GetData(), chunk.GetSize());
+  }
+  SerializeTrailer(out);
 }
 }  // namespace prometheus
@@ -1,5 +1,7 @@
 #include "prometheus/summary.h"
 
+#include "prometheus/detail/utils.h"
+
 namespace prometheus {
 
 Summary::Summary(const Quantiles& quantiles,
@@ -7,7 +9,8 @@ Summary::Summary(const Quantiles& quantiles,
     : quantiles_{quantiles},
       count_{0},
       sum_{0},
-      quantile_values_{quantiles_, max_age, age_buckets} {}
+      quantile_values_{quantiles_, max_age, age_buckets},
+      created_timestamp_ms_{detail::CurrentTimestampMs()} {}
 
 void Summary::Observe(const double value) {
   std::lock_guard<std::mutex> lock(mutex_);
@@ -19,19 +22,30 @@ void Summary::Observe(const double value) {
 
 ClientMetric Summary::Collect() const {
   auto metric = ClientMetric{};
+  CollectSummary(metric.summary);
+  return metric;
+}
 
+void Summary::Collect(MetricSink& sink,
+                      const MetricSink::Series& series) const {
+  auto& summary = sink.GetSummaryBuffer();
+  CollectSummary(summary);
+  sink.AddMetric(series, summary);
+}
+
+void Summary::CollectSummary(ClientMetric::Summary& summary) const {
   std::lock_guard<std::mutex> lock(mutex_);
 
+  summary.quantile.reserve(quantiles_.size());
   for (const auto& quantile : quantiles_) {
     auto metricQuantile = ClientMetric::Quantile{};
     metricQuantile.quantile = quantile.quantile;
     metricQuantile.value = quantile_values_.get(quantile.quantile);
-    metric.summary.quantile.push_back(std::move(metricQuantile));
+    summary.quantile.push_back(std::move(metricQuantile));
   }
-  metric.summary.sample_count = count_;
-  metric.summary.sample_sum = sum_;
-
-  return metric;
+  summary.sample_count = count_;
+  summary.sample_sum = sum_;
+  summary.created_timestamp_ms = created_timestamp_ms_;
 }
 
 }  // namespace prometheus
@@ -1,195 +1,266 @@
 #include "prometheus/text_serializer.h"
 
 #include <cmath>
+#include <cstdint>
 #include <limits>
-#include <locale>
-#include <ostream>
+
+#include "prometheus/collectable.h"
+#include "prometheus/detail/number_format.h"
+#include "prometheus/metric_sink.h"
+#include "prometheus/output_buffer.h"
 
 namespace prometheus {
 
 namespace {
 
 // Write a double as a string, with proper formatting for infinity and NaN
-void WriteValue(std::ostream& out, double value) {
+void WriteValue(OutputBuffer& out, double value) {
   if (std::isnan(value)) {
-    out << "Nan";
+    out.Write("Nan");
   } else if (std::isinf(value)) {
-    out << (value < 0 ? "-Inf" : "+Inf");
+    out.Write(value < 0 ? "-Inf" : "+Inf");
   } else {
-    auto saved_flags = out.setf(std::ios::fixed, std::ios::floatfield);
-    out << value;
-    out.setf(saved_flags, std::ios::floatfield);
+    auto buffer = out.Reserve(detail::kNumberBufferSize);
+    out.Commit(detail::FormatDouble(buffer, value));
   }
 }
 
-void WriteValue(std::ostream& out, const std::string& value) {
-  for (auto c : value) {
-    switch (c) {
+void WriteValue(OutputBuffer& out, std::uint64_t value) {
+  auto buffer = out.Reserve(detail::kNumberBufferSize);
+  out.Commit(detail::FormatUnsigned(buffer, value));
+}
+
+void WriteValue(OutputBuffer& out, std::int64_t value) {
+  auto buffer = out.Reserve(detail::kNumberBufferSize);
+  out.Commit(detail::FormatSigned(buffer, value));
+}
+
+void WriteValue(OutputBuffer& out, const std::string& value) {
+  auto begin = value.data();
+  auto end = begin + value.size();
+  for (auto c = begin; c != end; ++c) {
+    const char* escaped;
+    switch (*c) {
       case '\n':
-        out << '\\' << 'n';
+        escaped = "\\n";
         break;
 
       case '\\':
-        out << '\\' << c;
+        escaped = "\\\\";
         break;
 
       case '"':
-        out << '\\' << c;
+        escaped = "\\\"";
         break;
 
       default:
-        out << c;
-        break;
+        continue;
     }
+    out.Write(begin, static_cast<std::size_t>(c - begin));
+    out.Write(escaped, 2);
+    begin = c + 1;
   }
+  out.Write(begin, static_cast<std::size_t>(end - begin));
+}
+
+using Series = MetricSink::Series;
+
+template <typename T>
+void WriteLabel(OutputBuffer& out, const char*& prefix, const std::string& name,
+                const T& value) {
+  out.Write(prefix);
+  out.Write(name);
+  out.Write("=\"");
+  WriteValue(out, value);
+  out.Write('"');
+  prefix = ",";
 }
 
 // Write a line header: metric name and labels
 template <typename T = std::string>
-void WriteHead(std::ostream& out, const MetricFamily& family,
-               const ClientMetric& metric, const std::string& suffix = "",
+void WriteHead(OutputBuffer& out, const std::string& name,
+               const Series& series, const std::string& suffix = "",
                const std::string& extraLabelName = "",
                const T& extraLabelValue = T()) {
-  out << family.name << suffix;
-  if (!metric.label.empty() || !extraLabelName.empty()) {
-    out << "{";
+  out.Write(name);
+  out.Write(suffix);
+  if (!series.label.empty() || !series.constant_labels.empty() ||
+      !series.labels.empty() || !extraLabelName.empty()) {
+    out.Write('{');
     const char* prefix = "";
 
-    for (auto& lp : metric.label) {
-      out << prefix << lp.name << "=\"";
-      WriteValue(out, lp.value);
-      out << "\"";
-      prefix = ",";
+    for (auto& lp : series.label) {
+      WriteLabel(out, prefix, lp.name, lp.value);
+    }
+    for (auto& lp : series.constant_labels) {
+      WriteLabel(out, prefix, lp.first, lp.second);
+    }
+    for (auto& lp : series.labels) {
+      WriteLabel(out, prefix, lp.first, lp.second);
     }
     if (!extraLabelName.empty()) {
-      out << prefix << extraLabelName << "=\"";
-      WriteValue(out, extraLabelValue);
-      out << "\"";
+      WriteLabel(out, prefix, extraLabelName, extraLabelValue);
     }
-    out << "}";
+    out.Write('}');
   }
-  out << " ";
+  out.Write(' ');
 }
 
 // Write a line trailer: timestamp
-void WriteTail(std::ostream& out, const ClientMetric& metric) {
-  if (metric.timestamp_ms != 0) {
-    out << " " << metric.timestamp_ms;
+void WriteTail(OutputBuffer& out, const Series& series) {
+  if (series.timestamp_ms != 0) {
+    out.Write(' ');
+    WriteValue(out, series.timestamp_ms);
   }
-  out << "\n";
+  out.Write('\n');
 }
 
-void SerializeCounter(std::ostream& out, const MetricFamily& family,
-                      const ClientMetric& metric) {
-  WriteHead(out, family, metric);
-  WriteValue(out, metric.counter.value);
-  WriteTail(out, metric);
+void SerializeValue(OutputBuffer& out, const std::string& name,
+                    const Series& series, double value) {
+  WriteHead(out, name, series);
+  WriteValue(out, value);
+  WriteTail(out, series);
 }
 
-void SerializeGauge(std::ostream& out, const MetricFamily& family,
-                    const ClientMetric& metric) {
-  WriteHead(out, family, metric);
-  WriteValue(out, metric.gauge.value);
-  WriteTail(out, metric);
-}
-
-void SerializeSummary(std::ostream& out, const MetricFamily& family,
-                      const ClientMetric& metric) {
-  auto& sum = metric.summary;
-  WriteHead(out, family, metric, "_count");
-  out << sum.sample_count;
-  WriteTail(out, metric);
+void SerializeSummary(OutputBuffer& out, const std::string& name,
+                      const Series& series, const ClientMetric::Summary& sum) {
+  WriteHead(out, name, series, "_count");
+  WriteValue(out, sum.sample_count);
+  WriteTail(out, series);
 
-  WriteHead(out, family, metric, "_sum");
+  WriteHead(out, name, series, "_sum");
   WriteValue(out, sum.sample_sum);
-  WriteTail(out, metric);
+  WriteTail(out, series);
 
   for (auto& q : sum.quantile) {
-    WriteHead(out, family, metric, "", "quantile", q.quantile);
+    WriteHead(out, name, series, "", "quantile", q.quantile);
     WriteValue(out, q.value);
-    WriteTail(out, metric);
+    WriteTail(out, series);
   }
 }
 
-void SerializeUntyped(std::ostream& out, const MetricFamily& family,
-                      const ClientMetric& metric) {
-  WriteHead(out, family, metric);
-  WriteValue(out, metric.untyped.value);
-  WriteTail(out, metric);
-}
+void SerializeHistogram(OutputBuffer& out, const std::string& name,
+                        const Series& series,
+                        const ClientMetric::Histogram& hist) {
+  WriteHead(out, name, series, "_count");
+  WriteValue(out, hist.sample_count);
+  WriteTail(out, series);
 
-void SerializeHistogram(std::ostream& out, const MetricFamily& family,
-                        const ClientMetric& metric) {
-  auto& hist = metric.histogram;
-  WriteHead(out, family, metric, "_count");
-  out << hist.sample_count;
-  WriteTail(out, metric);
-
-  WriteHead(out, family, metric, "_sum");
+  WriteHead(out, name, series, "_sum");
   WriteValue(out, hist.sample_sum);
-  WriteTail(out, metric);
+  WriteTail(out, series);
 
   double last = -std::numeric_limits<double>::infinity();
   for (auto& b : hist.bucket) {
-    WriteHead(out, family, metric, "_bucket", "le", b.upper_bound);
+    WriteHead(out, name, series, "_bucket", "le", b.upper_bound);
     last = b.upper_bound;
-    out << b.cumulative_count;
-    WriteTail(out, metric);
+    WriteValue(out, b.cumulative_count);
+    WriteTail(out, series);
   }
 
   if (last != std::numeric_limits<double>::infinity()) {
-    WriteHead(out, family, metric, "_bucket", "le", "+Inf");
-    out << hist.sample_count;
-    WriteTail(out, metric);
+    WriteHead(out, name, series, "_bucket", "le", "+Inf");
+    WriteValue(out, hist.sample_count);
+    WriteTail(out, series);
   }
 }
 
-void SerializeFamily(std::ostream& out, const MetricFamily& family) {
-  if (!family.help.empty()) {
-    out << "# HELP " << family.name << " " << family.help << "\n";
+// Serializes the metrics passed by a Collectable as they arrive
+class TextSink : public MetricSink {
+ public:
+  explicit TextSink(OutputBuffer& out) : out_(out) {}
+
+  void AddFamily(const std::string& name, const std::string& help,
+                 MetricType type) override {
+    name_ = name;
+    if (!help.empty()) {
+      out_.Write("# HELP ");
+      out_.Write(name);
+      out_.Write(' ');
+      out_.Write(help);
+      out_.Write('\n');
+    }
+    out_.Write("# TYPE ");
+    out_.Write(name);
+    switch (type) {
+      case MetricType::Counter:
+        out_.Write(" counter\n");
+        break;
+      case MetricType::Gauge:
+        out_.Write(" gauge\n");
+        break;
+      case MetricType::Summary:
+        out_.Write(" summary\n");
+        break;
+      case MetricType::Untyped:
+        out_.Write(" untyped\n");
+        break;
+      case MetricType::Histogram:
+        out_.Write(" histogram\n");
+        break;
+    }
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Counter& counter) override {
+    SerializeValue(out_, name_, series, counter.value);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Gauge& gauge) override {
+    SerializeValue(out_, name_, series, gauge.value);
   }
-  switch (family.type) {
-    case MetricType::Counter:
-      out << "# TYPE " << family.name << " counter\n";
-      for (auto& metric : family.metric) {
-        SerializeCounter(out, family, metric);
-      }
-      break;
-    case MetricType::Gauge:
-      out << "# TYPE " << family.name << " gauge\n";
-      for (auto& metric : family.metric) {
-        SerializeGauge(out, family, metric);
-      }
-      break;
-    case MetricType::Summary:
-      out << "# TYPE " << family.name << " summary\n";
-      for (auto& metric : family.metric) {
-        SerializeSummary(out, family, metric);
-      }
-      break;
-    case MetricType::Untyped:
-      out << "# TYPE " << family.name << " untyped\n";
-      for (auto& metric : family.metric) {
-        SerializeUntyped(out, family, metric);
-      }
-      break;
-    case MetricType::Histogram:
-      out << "# TYPE " << family.name << " histogram\n";
-      for (auto& metric : family.metric) {
-        SerializeHistogram(out, family, metric);
-      }
-      break;
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Summary& summary) override {
+    SerializeSummary(out_, name_, series, summary);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Histogram& histogram) override {
+    SerializeHistogram(out_, name_, series, histogram);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Untyped& untyped) override {
+    SerializeValue(out_, name_, series, untyped.value);
+  }
+
+ private:
+  OutputBuffer& out_;
+  std::string name_;
+};
+
+void SerializeFamily(OutputBuffer& out, const MetricFamily& family) {
+  TextSink sink{out};
+  sink.AddFamily(family.name, family.help, family.type);
+  for (auto& metric : family.metric) {
+    sink.AddClientMetric(family.type, metric);
   }
 }
 }  // namespace
 
 void TextSerializer::Serialize(std::ostream& out,
                                const std::vector<MetricFamily>& metrics) const {
-  std::locale saved_locale = out.getloc();
-  out.imbue(std::locale::classic());
+  StreamOutputBuffer buffer{out};
+  Serialize(buffer, metrics);
+}
+
+void TextSerializer::Serialize(OutputBuffer& out,
+                               const std::vector<MetricFamily>& metrics) const {
   for (auto& family : metrics) {
     SerializeFamily(out, family);
   }
-  out.imbue(saved_locale);
+}
+
+void TextSerializer::Serialize(OutputBuffer& out,
+                               const MetricFamily& family) const {
+  SerializeFamily(out, family);
+}
+
+void TextSerializer::Serialize(OutputBuffer& out,
+                               const Collectable& collectable) const {
+  TextSink sink{out};
+  collectable.CollectTo(sink);
 }
 }  // namespace prometheus
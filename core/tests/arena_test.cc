@@ -0,0 +1,65 @@
+#include "prometheus/detail/arena.h"
+
+#include <gmock/gmock.h>
+
+#include <cstdint>
+#include <string>
+
+namespace prometheus {
+namespace detail {
+namespace {
+
+std::string Concatenate(const ArenaOutputBuffer& buffer) {
+  auto result = std::string{};
+  buffer.ForEachChunk([&result](const char* data, std::size_t size) {
+    result.append(data, size);
+  });
+  return result;
+}
+
+TEST(ArenaTest, allocates_aligned_memory) {
+  Arena arena{64};
+  auto first = arena.Allocate(1);
+  auto second = arena.Allocate(3);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(0U, reinterpret_cast<std::uintptr_t>(second) %
+                    alignof(std::max_align_t));
+}
+
+TEST(ArenaTest, reuses_blocks_after_reset) {
+  Arena arena{64};
+  auto first = arena.Allocate(48);
+  arena.Allocate(1024);
+  const auto capacity = arena.GetCapacity();
+
+  arena.Reset();
+
+  EXPECT_EQ(first, arena.Allocate(48));
+  arena.Allocate(1024);
+  EXPECT_EQ(capacity, arena.GetCapacity());
+}
+
+TEST(ArenaOutputBufferTest, collects_written_data_in_chunks) {
+  Arena arena{256};
+  ArenaOutputBuffer buffer{arena, 8};
+
+  buffer.Write("metric_name");
+  buffer.Write("{label=\"value\"} ");
+  buffer.Write("42");
+  buffer.Write('\n');
+
+  EXPECT_EQ("metric_name{label=\"value\"} 42\n", Concatenate(buffer));
+  EXPECT_EQ(30U, buffer.GetSize());
+}
+
+TEST(ArenaOutputBufferTest, empty_buffer_has_no_chunks) {
+  Arena arena;
+  ArenaOutputBuffer buffer{arena};
+
+  EXPECT_EQ("", Concatenate(buffer));
+  EXPECT_EQ(0U, buffer.GetSize());
+}
+
+}  // namespace
+}  // namespace detail
+}  // namespace prometheus
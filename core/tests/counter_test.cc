@@ -37,5 +37,12 @@ TEST(CounterTest, inc_negative_value) {
   EXPECT_EQ(counter.Value(), 5.0);
 }
 
+TEST(CounterTest, collect_creation_time) {
+  Counter counter;
+  EXPECT_GT(counter.CreatedTimestampMs(), 0);
+  EXPECT_EQ(counter.Collect().counter.created_timestamp_ms,
+            counter.CreatedTimestampMs());
+}
+
 }  // namespace
 }  // namespace prometheus
@@ -1,5 +1,7 @@
 #include "prometheus/family.h"
 
+#include <chrono>
+#include <future>
 #include <memory>
 
 #include <gmock/gmock.h>
@@ -7,6 +9,7 @@
 #include "prometheus/client_metric.h"
 #include "prometheus/detail/future_std.h"
 #include "prometheus/histogram.h"
+#include "prometheus/metric_sink.h"
 
 namespace prometheus {
 namespace {
@@ -26,6 +29,76 @@ TEST(FamilyTest, labels) {
               ::testing::ElementsAre(const_label, dynamic_label));
 }
 
+class RecordingSink : public MetricSink {
+ public:
+  void AddFamily(const std::string& name, const std::string&,
+                 MetricType type) override {
+    families.push_back(name);
+    types.push_back(type);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Counter& counter) override {
+    all_labels.push_back(series.constant_labels);
+    all_labels.back().insert(series.labels.begin(), series.labels.end());
+    values.push_back(counter.value);
+  }
+
+  void AddMetric(const Series&, const ClientMetric::Gauge&) override {}
+  void AddMetric(const Series&, const ClientMetric::Summary&) override {}
+  void AddMetric(const Series&, const ClientMetric::Histogram&) override {}
+  void AddMetric(const Series&, const ClientMetric::Untyped&) override {}
+
+  std::vector<std::string> families;
+  std::vector<MetricType> types;
+  std::vector<Labels> all_labels;
+  std::vector<double> values;
+};
+
+TEST(FamilyTest, collect_into_sink) {
+  Family<Counter> family{"total_requests",
+                         "Counts all requests",
+                         {{"component", "test"}}};
+  family.Add({{"status", "200"}}).Increment(3);
+  RecordingSink sink;
+  family.CollectTo(sink);
+  EXPECT_THAT(sink.families, ::testing::ElementsAre("total_requests"));
+  EXPECT_THAT(sink.types, ::testing::ElementsAre(MetricType::Counter));
+  ASSERT_EQ(sink.all_labels.size(), 1U);
+  EXPECT_EQ(sink.all_labels.at(0),
+            (MetricSink::Labels{{"component", "test"}, {"status", "200"}}));
+  EXPECT_THAT(sink.values, ::testing::ElementsAre(3.0));
+}
+
+// Adds a metric to the family from another thread when flushed
+class AddingSink : public RecordingSink {
+ public:
+  explicit AddingSink(Family<Counter>& family) : family_(family) {}
+
+  void Flush() override {
+    auto added = std::async(std::launch::async,
+                            [this] { family_.Add({{"status", "500"}}); });
+    unlocked = added.wait_for(std::chrono::seconds{5}) ==
+               std::future_status::ready;
+    added_ = std::move(added);
+  }
+
+  bool unlocked = false;
+
+ private:
+  Family<Counter>& family_;
+  std::future<void> added_;
+};
+
+TEST(FamilyTest, flush_sink_after_unlocking) {
+  Family<Counter> family{"total_requests", "Counts all requests", {}};
+  family.Add({{"status", "200"}});
+  AddingSink sink{family};
+  family.CollectTo(sink);
+  EXPECT_TRUE(sink.unlocked);
+  EXPECT_EQ(1U, sink.values.size());
+}
+
 TEST(FamilyTest, counter_value) {
   Family<Counter> family{"total_requests", "Counts all requests", {}};
   auto& counter = family.Add({});
@@ -0,0 +1,87 @@
+#include "prometheus/detail/gzip_buffer.h"
+
+#include <gmock/gmock.h>
+
+#include <string>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace prometheus {
+namespace detail {
+namespace {
+
+#ifdef HAVE_ZLIB
+std::string GUnzip(const std::string& data) {
+  z_stream stream{};
+  if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+    return {};
+  }
+
+  std::string result;
+  char buffer[1024];
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  int ret;
+  do {
+    stream.next_out = reinterpret_cast<Bytef*>(buffer);
+    stream.avail_out = sizeof(buffer);
+    ret = inflate(&stream, Z_NO_FLUSH);
+    result.append(buffer, sizeof(buffer) - stream.avail_out);
+  } while (ret == Z_OK);
+  inflateEnd(&stream);
+  return ret == Z_STREAM_END ? result : std::string{};
+}
+
+std::string Compress(GZipCompressor& compressor, Arena& arena,
+                     const std::string& data) {
+  StringOutputBuffer out;
+  GZipBuffer compressed{compressor, out, arena, nullptr, 64};
+  compressed.Write(data);
+  EXPECT_TRUE(compressed.Finish());
+  return out.ToString();
+}
+
+TEST(GZipBufferTest, compresses_data_larger_than_the_buffer) {
+  GZipCompressor compressor;
+  Arena arena;
+  ASSERT_TRUE(compressor.Start(6));
+  std::string data;
+  for (int i = 0; i < 100; ++i) {
+    data += "metric_name{label=\"" + std::to_string(i) + "\"} 1\n";
+  }
+
+  const auto compressed = Compress(compressor, arena, data);
+
+  EXPECT_EQ(data, GUnzip(compressed));
+  EXPECT_EQ(data.size(), compressor.GetTotalIn());
+  EXPECT_EQ(compressed.size(), compressor.GetTotalOut());
+}
+
+TEST(GZipBufferTest, restarts_the_compressor_for_each_body) {
+  GZipCompressor compressor;
+  Arena arena;
+
+  for (const auto level : {6, 6, 0}) {
+    ASSERT_TRUE(compressor.Start(level));
+    const auto compressed = Compress(compressor, arena, "metric_name 1\n");
+    EXPECT_EQ("metric_name 1\n", GUnzip(compressed));
+    EXPECT_EQ(14U, compressor.GetTotalIn());
+  }
+}
+
+TEST(GZipBufferTest, rejects_invalid_level) {
+  GZipCompressor compressor;
+  EXPECT_FALSE(compressor.Start(10));
+}
+#else
+TEST(GZipBufferTest, does_not_compress_without_zlib) {
+  GZipCompressor compressor;
+  EXPECT_FALSE(compressor.Start(6));
+}
+#endif
+
+}  // namespace
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,100 @@
+#include "prometheus/name_filter.h"
+
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include "prometheus/collectable.h"
+#include "prometheus/metric_family.h"
+#include "prometheus/metric_sink.h"
+
+namespace prometheus {
+namespace {
+
+TEST(NameFilterTest, empty_filter_matches_all) {
+  NameFilter filter;
+  EXPECT_TRUE(filter.MatchesAll());
+  EXPECT_TRUE(filter.Matches("anything"));
+}
+
+TEST(NameFilterTest, match_exact_names) {
+  NameFilter filter{{"foo", "bar"}};
+  EXPECT_FALSE(filter.MatchesAll());
+  EXPECT_TRUE(filter.Matches("foo"));
+  EXPECT_TRUE(filter.Matches("bar"));
+  EXPECT_FALSE(filter.Matches("foo_total"));
+  EXPECT_FALSE(filter.Matches("fo"));
+}
+
+TEST(NameFilterTest, match_prefixes) {
+  NameFilter filter;
+  filter.Add("http_*");
+  EXPECT_TRUE(filter.Matches("http_requests_total"));
+  EXPECT_TRUE(filter.Matches("http_"));
+  EXPECT_FALSE(filter.Matches("http"));
+  EXPECT_FALSE(filter.Matches("grpc_requests_total"));
+}
+
+TEST(NameFilterTest, lone_star_matches_all) {
+  NameFilter filter{{"*"}};
+  EXPECT_TRUE(filter.Matches("anything"));
+}
+
+class TwoFamilies : public Collectable {
+ public:
+  std::vector<MetricFamily> Collect() const override {
+    auto foo = MetricFamily{};
+    foo.name = "foo";
+    foo.type = MetricType::Gauge;
+    foo.metric.resize(2);
+    auto bar = MetricFamily{};
+    bar.name = "bar";
+    bar.type = MetricType::Gauge;
+    bar.metric.resize(1);
+    return {foo, bar};
+  }
+};
+
+class RecordingSink : public MetricSink {
+ public:
+  void AddFamily(const std::string& name, const std::string&,
+                 MetricType) override {
+    families.push_back(name);
+  }
+  void AddMetric(const Series&, const ClientMetric::Counter&) override {
+    ++series;
+  }
+  void AddMetric(const Series&, const ClientMetric::Gauge&) override {
+    ++series;
+  }
+  void AddMetric(const Series&, const ClientMetric::Summary&) override {
+    ++series;
+  }
+  void AddMetric(const Series&, const ClientMetric::Histogram&) override {
+    ++series;
+  }
+  void AddMetric(const Series&, const ClientMetric::Untyped&) override {
+    ++series;
+  }
+
+  std::vector<std::string> families;
+  int series = 0;
+};
+
+TEST(NameFilterTest, default_collect_drops_unselected_families) {
+  const TwoFamilies collectable;
+  const NameFilter filter{{"bar"}};
+
+  auto collected = collectable.CollectFiltered(filter);
+  ASSERT_EQ(collected.size(), 1U);
+  EXPECT_EQ(collected[0].name, "bar");
+
+  RecordingSink sink;
+  collectable.CollectFilteredTo(sink, filter);
+  EXPECT_THAT(sink.families, testing::ElementsAre("bar"));
+  EXPECT_EQ(sink.series, 1);
+}
+
+}  // namespace
+}  // namespace prometheus
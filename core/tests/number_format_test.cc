@@ -0,0 +1,84 @@
+#include "prometheus/detail/number_format.h"
+
+#include <gmock/gmock.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+
+namespace prometheus {
+namespace detail {
+namespace {
+
+std::string Format(double value) {
+  char buffer[kNumberBufferSize];
+  return std::string(buffer, FormatDouble(buffer, value));
+}
+
+TEST(NumberFormatTest, formats_integral_values_without_fraction) {
+  EXPECT_EQ("0", Format(0.0));
+  EXPECT_EQ("-0", Format(-0.0));
+  EXPECT_EQ("1", Format(1.0));
+  EXPECT_EQ("64", Format(64.0));
+  EXPECT_EQ("-1234", Format(-1234.0));
+  EXPECT_EQ("9007199254740992", Format(9007199254740992.0));
+  EXPECT_EQ("100000000000000000000", Format(1e20));
+}
+
+TEST(NumberFormatTest, formats_fractions) {
+  EXPECT_EQ("0.1", Format(0.1));
+  EXPECT_EQ("0.5", Format(0.5));
+  EXPECT_EQ("123.456", Format(123.456));
+  EXPECT_EQ("0.001", Format(0.001));
+  EXPECT_EQ("0.000001", Format(1e-6));
+}
+
+TEST(NumberFormatTest, formats_scientific_notation) {
+  EXPECT_EQ("1e+21", Format(1e21));
+  EXPECT_EQ("1.5e-07", Format(1.5e-7));
+  EXPECT_EQ("5e-324", Format(std::numeric_limits<double>::denorm_min()));
+  EXPECT_EQ("1.7976931348623157e+308",
+            Format(std::numeric_limits<double>::max()));
+  EXPECT_EQ("2.2250738585072014e-308",
+            Format(std::numeric_limits<double>::min()));
+}
+
+TEST(NumberFormatTest, round_trips_random_values) {
+  std::mt19937_64 generator{0};
+  for (int i = 0; i < 100000; ++i) {
+    auto bits = generator();
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    if (value != value || value - value != 0) {
+      continue;  // skip NaN and infinity
+    }
+
+    auto formatted = Format(value);
+    ASSERT_LT(formatted.size(), kNumberBufferSize);
+    EXPECT_EQ(value, std::strtod(formatted.c_str(), nullptr)) << formatted;
+  }
+}
+
+TEST(NumberFormatTest, formats_integers) {
+  char buffer[kNumberBufferSize];
+  auto format_unsigned = [&buffer](std::uint64_t value) {
+    return std::string(buffer, FormatUnsigned(buffer, value));
+  };
+  auto format_signed = [&buffer](std::int64_t value) {
+    return std::string(buffer, FormatSigned(buffer, value));
+  };
+
+  EXPECT_EQ("0", format_unsigned(0));
+  EXPECT_EQ("18446744073709551615",
+            format_unsigned(std::numeric_limits<std::uint64_t>::max()));
+  EXPECT_EQ("-1234", format_signed(-1234));
+  EXPECT_EQ("-9223372036854775808",
+            format_signed(std::numeric_limits<std::int64_t>::min()));
+}
+
+}  // namespace
+}  // namespace detail
+}  // namespace prometheus
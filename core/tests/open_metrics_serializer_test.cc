@@ -0,0 +1,156 @@
+#include "prometheus/open_metrics_serializer.h"
+
+#include <gmock/gmock.h>
+
+#include <cmath>
+#include <string>
+
+#include "prometheus/counter.h"
+#include "prometheus/family.h"
+#include "prometheus/gauge.h"
+#include "prometheus/histogram.h"
+#include "prometheus/registry.h"
+#include "prometheus/summary.h"
+
+namespace prometheus {
+namespace {
+
+class OpenMetricsSerializerTest : public testing::Test {
+ public:
+  std::string Serialize(MetricType type) const {
+    MetricFamily metricFamily;
+    metricFamily.name = name;
+    metricFamily.help = "my metric help text";
+    metricFamily.type = type;
+    metricFamily.metric = std::vector<ClientMetric>{metric};
+
+    std::vector<MetricFamily> families{metricFamily};
+
+    return serializer.Serialize(families);
+  }
+
+  std::string name = "my_metric";
+  ClientMetric metric;
+  OpenMetricsSerializer serializer;
+};
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeCounterWithCreated) {
+  name = "requests_total";
+  metric.counter.value = 2;
+  metric.counter.created_timestamp_ms = 1520879607789;
+
+  EXPECT_EQ(
+      "# TYPE requests counter\n"
+      "# HELP requests my metric help text\n"
+      "requests_total 2\n"
+      "requests_created 1520879607.789\n"
+      "# EOF\n",
+      Serialize(MetricType::Counter));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldAppendTotalToCounter) {
+  metric.counter.value = 2;
+
+  const auto serialized = Serialize(MetricType::Counter);
+  EXPECT_THAT(serialized, testing::HasSubstr("# TYPE my_metric counter\n"));
+  EXPECT_THAT(serialized, testing::HasSubstr("\nmy_metric_total 2\n"));
+  EXPECT_THAT(serialized, testing::Not(testing::HasSubstr("_created")));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeUntypedAsUnknown) {
+  metric.untyped.value = 64.0;
+
+  const auto serialized = Serialize(MetricType::Untyped);
+  EXPECT_THAT(serialized, testing::HasSubstr("# TYPE my_metric unknown\n"));
+  EXPECT_THAT(serialized, testing::HasSubstr("\nmy_metric 64\n"));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeTimestampInSeconds) {
+  metric.gauge.value = 1.5;
+  metric.timestamp_ms = 1234;
+
+  EXPECT_THAT(Serialize(MetricType::Gauge),
+              testing::HasSubstr("\nmy_metric 1.5 1.234\n"));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeNotANumber) {
+  metric.gauge.value = std::nan("");
+  EXPECT_THAT(Serialize(MetricType::Gauge),
+              testing::HasSubstr("\nmy_metric NaN\n"));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldEscapeHelpAndLabels) {
+  metric.label.resize(1, ClientMetric::Label{"k", "v\"\n\\"});
+
+  MetricFamily family;
+  family.name = name;
+  family.help = "a \"help\"\ntext";
+  family.type = MetricType::Gauge;
+  family.metric.push_back(metric);
+
+  const auto serialized = serializer.Serialize({family});
+  EXPECT_THAT(serialized,
+              testing::HasSubstr("# HELP my_metric a \\\"help\\\"\\ntext\n"));
+  EXPECT_THAT(serialized,
+              testing::HasSubstr("my_metric{k=\"v\\\"\\n\\\\\"} 0\n"));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeHistogram) {
+  Histogram histogram{{1}};
+  histogram.Observe(0);
+  histogram.Observe(200);
+  metric = histogram.Collect();
+  metric.histogram.created_timestamp_ms = 1000;
+
+  EXPECT_EQ(
+      "# TYPE my_metric histogram\n"
+      "# HELP my_metric my metric help text\n"
+      "my_metric_bucket{le=\"1.0\"} 1\n"
+      "my_metric_bucket{le=\"+Inf\"} 2\n"
+      "my_metric_count 2\n"
+      "my_metric_sum 200\n"
+      "my_metric_created 1\n"
+      "# EOF\n",
+      Serialize(MetricType::Histogram));
+}
+
+TEST_F(OpenMetricsSerializerTest, shouldSerializeSummary) {
+  Summary summary{Summary::Quantiles{{0.5, 0.05}}};
+  summary.Observe(0);
+  summary.Observe(200);
+  metric = summary.Collect();
+  metric.summary.created_timestamp_ms = 0;
+
+  EXPECT_EQ(
+      "# TYPE my_metric summary\n"
+      "# HELP my_metric my metric help text\n"
+      "my_metric{quantile=\"0.5\"} 0\n"
+      "my_metric_count 2\n"
+      "my_metric_sum 200\n"
+      "# EOF\n",
+      Serialize(MetricType::Summary));
+}
+
+TEST(OpenMetricsSerializerStreamingTest, shouldMatchCollectedMetrics) {
+  Registry registry;
+  auto& counter = BuildCounter()
+                      .Name("requests_total")
+                      .Help("all requests")
+                      .Labels({{"component", "test"}})
+                      .Register(registry);
+  counter.Add({{"status", "200"}}).Increment();
+  BuildHistogram()
+      .Name("latency_seconds")
+      .Register(registry)
+      .Add({}, Histogram::BucketBoundaries{0.1, 1})
+      .Observe(0.5);
+
+  OpenMetricsSerializer serializer;
+  const auto serialized = serializer.Serialize(registry);
+  EXPECT_EQ(serializer.Serialize(registry.Collect()), serialized);
+  EXPECT_THAT(serialized, testing::HasSubstr("requests_created{"));
+  EXPECT_THAT(serialized, testing::EndsWith("\n# EOF\n"));
+}
+
+}  // namespace
+}  // namespace prometheus
@@ -0,0 +1,72 @@
+#include "prometheus/output_buffer.h"
+
+#include <gmock/gmock.h>
+
+#include <sstream>
+#include <string>
+
+namespace prometheus {
+namespace {
+
+TEST(StringOutputBufferTest, collects_written_data) {
+  StringOutputBuffer buffer;
+  buffer.Write("metric_name");
+  buffer.Write(std::string{"{label=\"value\"}"});
+  buffer.Write(' ');
+  auto data = buffer.Reserve(2);
+  data[0] = '4';
+  data[1] = '2';
+  buffer.Commit(2);
+
+  EXPECT_EQ("metric_name{label=\"value\"} 42", buffer.ToString());
+  EXPECT_EQ(29U, buffer.GetSize());
+}
+
+TEST(StringOutputBufferTest, grows_beyond_initial_capacity) {
+  const auto large = std::string(100000, 'x');
+  StringOutputBuffer buffer;
+  buffer.Write('a');
+  buffer.Write(large);
+  buffer.Write('b');
+
+  EXPECT_EQ('a' + large + 'b', buffer.ToString());
+}
+
+TEST(StringOutputBufferTest, reuses_memory_after_clear) {
+  StringOutputBuffer buffer;
+  buffer.Write(std::string(5000, 'x'));
+  const auto data = buffer.GetData();
+
+  buffer.Clear();
+  EXPECT_EQ(0U, buffer.GetSize());
+
+  buffer.Write(std::string(5000, 'y'));
+  EXPECT_EQ(data, buffer.GetData());
+  EXPECT_EQ(std::string(5000, 'y'), buffer.ToString());
+}
+
+TEST(StreamOutputBufferTest, passes_data_to_stream) {
+  const auto large = std::string(100000, 'x');
+  std::ostringstream stream;
+  {
+    StreamOutputBuffer buffer{stream};
+    buffer.Write("head ");
+    buffer.Write(large);
+    buffer.Write(" tail");
+  }
+
+  EXPECT_EQ("head " + large + " tail", stream.str());
+}
+
+TEST(StreamOutputBufferTest, passes_data_on_flush) {
+  std::ostringstream stream;
+  StreamOutputBuffer buffer{stream};
+  buffer.Write("metric");
+  EXPECT_EQ("", stream.str());
+
+  buffer.Flush();
+  EXPECT_EQ("metric", stream.str());
+}
+
+}  // namespace
+}  // namespace prometheus
@@ -0,0 +1,189 @@
+#include "prometheus/protobuf_serializer.h"
+
+#include <gmock/gmock.h>
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <utility>
+
+#include "prometheus/counter.h"
+#include "prometheus/family.h"
+#include "prometheus/histogram.h"
+#include "prometheus/registry.h"
+#include "prometheus/summary.h"
+
+namespace prometheus {
+namespace {
+
+// Reads the fields of an encoded protocol buffer message
+class Reader {
+ public:
+  explicit Reader(const std::string& data) : data_(data), position_{0} {}
+
+  bool AtEnd() const { return position_ == data_.size(); }
+
+  std::uint64_t ReadVarint() {
+    auto value = std::uint64_t{0};
+    for (int shift = 0;; shift += 7) {
+      auto byte = static_cast<std::uint8_t>(data_.at(position_++));
+      value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+    }
+  }
+
+  // Returns the field number and checks the wire type
+  std::uint32_t ReadTag(std::uint32_t wire_type) {
+    auto tag = ReadVarint();
+    EXPECT_EQ(wire_type, tag & 7);
+    return static_cast<std::uint32_t>(tag >> 3);
+  }
+
+  double ReadDouble() {
+    auto bits = std::uint64_t{0};
+    for (int i = 0; i < 8; ++i) {
+      bits |= static_cast<std::uint64_t>(
+                  static_cast<std::uint8_t>(data_.at(position_++)))
+              << (8 * i);
+    }
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  std::string ReadBytes() {
+    auto size = ReadVarint();
+    auto result = data_.substr(position_, size);
+    EXPECT_EQ(size, result.size());
+    position_ += size;
+    return result;
+  }
+
+ private:
+  const std::string& data_;
+  std::size_t position_;
+};
+
+TEST(ProtobufSerializerTest, shouldEncodeCounter) {
+  MetricFamily family;
+  family.name = "c";
+  family.type = MetricType::Counter;
+  family.metric.resize(1);
+  family.metric[0].counter.value = 1.0;
+
+  const auto expected = std::string{
+      "\x12"                                   // length of family
+      "\x0a\x01"                               // name
+      "c"                                      //
+      "\x18\x00"                               // type
+      "\x22\x0b"                               // metric
+      "\x1a\x09"                               // counter
+      "\x09\x00\x00\x00\x00\x00\x00\xf0\x3f",  // value
+      19};
+
+  EXPECT_EQ(expected, ProtobufSerializer{}.Serialize({family}));
+}
+
+TEST(ProtobufSerializerTest, shouldEncodeHistogramWithLabelsAndTimestamp) {
+  Histogram histogram{{1}};
+  histogram.Observe(0.5);
+  histogram.Observe(300);
+
+  MetricFamily family;
+  family.name = "latency";
+  family.help = "help";
+  family.type = MetricType::Histogram;
+  family.metric.push_back(histogram.Collect());
+  family.metric[0].label.push_back({"method", "GET"});
+  family.metric[0].timestamp_ms = 1234;
+
+  const auto serialized = ProtobufSerializer{}.Serialize({family});
+
+  Reader delimited{serialized};
+  const auto message = delimited.ReadBytes();
+  EXPECT_TRUE(delimited.AtEnd());
+
+  Reader family_reader{message};
+  EXPECT_EQ(1U, family_reader.ReadTag(2));
+  EXPECT_EQ("latency", family_reader.ReadBytes());
+  EXPECT_EQ(2U, family_reader.ReadTag(2));
+  EXPECT_EQ("help", family_reader.ReadBytes());
+  EXPECT_EQ(3U, family_reader.ReadTag(0));
+  EXPECT_EQ(4U, family_reader.ReadVarint());
+  EXPECT_EQ(4U, family_reader.ReadTag(2));
+  const auto metric = family_reader.ReadBytes();
+  EXPECT_TRUE(family_reader.AtEnd());
+
+  Reader metric_reader{metric};
+  EXPECT_EQ(1U, metric_reader.ReadTag(2));
+  const auto label = metric_reader.ReadBytes();
+  Reader label_reader{label};
+  EXPECT_EQ(1U, label_reader.ReadTag(2));
+  EXPECT_EQ("method", label_reader.ReadBytes());
+  EXPECT_EQ(2U, label_reader.ReadTag(2));
+  EXPECT_EQ("GET", label_reader.ReadBytes());
+  EXPECT_TRUE(label_reader.AtEnd());
+
+  EXPECT_EQ(7U, metric_reader.ReadTag(2));
+  const auto value = metric_reader.ReadBytes();
+  EXPECT_EQ(6U, metric_reader.ReadTag(0));
+  EXPECT_EQ(1234U, metric_reader.ReadVarint());
+  EXPECT_TRUE(metric_reader.AtEnd());
+
+  Reader histogram_reader{value};
+  EXPECT_EQ(1U, histogram_reader.ReadTag(0));
+  EXPECT_EQ(2U, histogram_reader.ReadVarint());
+  EXPECT_EQ(2U, histogram_reader.ReadTag(1));
+  EXPECT_EQ(300.5, histogram_reader.ReadDouble());
+  const auto inf = std::numeric_limits<double>::infinity();
+  for (auto expected : {std::make_pair(1U, 1.0), std::make_pair(2U, inf)}) {
+    EXPECT_EQ(3U, histogram_reader.ReadTag(2));
+    const auto bucket = histogram_reader.ReadBytes();
+    Reader bucket_reader{bucket};
+    EXPECT_EQ(1U, bucket_reader.ReadTag(0));
+    EXPECT_EQ(expected.first, bucket_reader.ReadVarint());
+    EXPECT_EQ(2U, bucket_reader.ReadTag(1));
+    EXPECT_EQ(expected.second, bucket_reader.ReadDouble());
+    EXPECT_TRUE(bucket_reader.AtEnd());
+  }
+  EXPECT_TRUE(histogram_reader.AtEnd());
+}
+
+TEST(ProtobufSerializerTest, shouldDelimitEachFamily) {
+  Registry registry;
+  BuildCounter().Name("a").Register(registry).Add({{"k", "v"}}).Increment();
+  BuildCounter().Name("b").Register(registry).Add({}).Increment(2);
+
+  const auto serialized = ProtobufSerializer{}.Serialize(registry);
+
+  Reader delimited{serialized};
+  delimited.ReadBytes();
+  delimited.ReadBytes();
+  EXPECT_TRUE(delimited.AtEnd());
+}
+
+TEST(ProtobufSerializerTest, shouldMatchCollectedMetrics) {
+  Registry registry;
+  auto& counter = BuildCounter()
+                      .Name("requests_total")
+                      .Help("all requests")
+                      .Labels({{"component", "test"}})
+                      .Register(registry);
+  counter.Add({{"status", "200"}}).Increment();
+  counter.Add({{"status", "500"}}).Increment(2);
+  BuildSummary()
+      .Name("size_bytes")
+      .Register(registry)
+      .Add({{"a", "b"}}, Summary::Quantiles{{0.5, 0.05}})
+      .Observe(3);
+
+  ProtobufSerializer serializer;
+  EXPECT_EQ(serializer.Serialize(registry.Collect()),
+            serializer.Serialize(registry));
+}
+
+}  // namespace
+}  // namespace prometheus
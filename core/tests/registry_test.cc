@@ -1,8 +1,13 @@
 #include "prometheus/registry.h"
 #include "prometheus/counter.h"
+#include "prometheus/detail/thread_pool.h"
 #include "prometheus/histogram.h"
+#include "prometheus/metric_sink.h"
+#include "prometheus/name_filter.h"
 #include "prometheus/summary.h"
 
+#include <chrono>
+#include <future>
 #include <vector>
 
 #include <gmock/gmock.h>
@@ -27,6 +32,96 @@ TEST(RegistryTest, collect_single_metric_family) {
   EXPECT_EQ(collected[0].metric.at(1).label.at(0).name, "name");
 }
 
+TEST(RegistryTest, collect_concurrently_in_registration_order) {
+  Registry registry{};
+  BuildCounter().Name("counter").Register(registry).Add({});
+  BuildGauge().Name("gauge").Register(registry).Add({});
+  BuildCounter().Name("another_counter").Register(registry).Add({});
+  detail::ThreadPool pool{2};
+
+  auto collected = registry.CollectConcurrently(pool);
+  ASSERT_EQ(collected.size(), 3U);
+  EXPECT_EQ(collected[0].name, "counter");
+  EXPECT_EQ(collected[1].name, "another_counter");
+  EXPECT_EQ(collected[2].name, "gauge");
+}
+
+TEST(RegistryTest, collect_families_selected_by_name) {
+  Registry registry{};
+  BuildCounter().Name("http_requests_total").Register(registry).Add({});
+  BuildGauge().Name("http_connections").Register(registry).Add({});
+  BuildCounter().Name("grpc_requests_total").Register(registry).Add({});
+  BuildGauge().Name("temperature").Register(registry).Add({});
+
+  auto collected =
+      registry.CollectFiltered(NameFilter{{"http_*", "temperature"}});
+  ASSERT_EQ(collected.size(), 3U);
+  EXPECT_EQ(collected[0].name, "http_requests_total");
+  EXPECT_EQ(collected[1].name, "http_connections");
+  EXPECT_EQ(collected[2].name, "temperature");
+}
+
+class FamilyNameSink : public MetricSink {
+ public:
+  void AddFamily(const std::string& name, const std::string&,
+                 MetricType) override {
+    names.push_back(name);
+  }
+  void AddMetric(const Series&, const ClientMetric::Counter&) override {}
+  void AddMetric(const Series&, const ClientMetric::Gauge&) override {}
+  void AddMetric(const Series&, const ClientMetric::Summary&) override {}
+  void AddMetric(const Series&, const ClientMetric::Histogram&) override {}
+  void AddMetric(const Series&, const ClientMetric::Untyped&) override {}
+
+  std::vector<std::string> names;
+};
+
+TEST(RegistryTest, pass_families_selected_by_name_to_sink) {
+  Registry registry{};
+  BuildCounter().Name("counter").Register(registry).Add({});
+  BuildGauge().Name("gauge").Register(registry).Add({});
+  BuildHistogram()
+      .Name("histogram")
+      .Register(registry)
+      .Add({}, Histogram::BucketBoundaries{1});
+
+  FamilyNameSink sink;
+  registry.CollectFilteredTo(sink, NameFilter{{"histogram", "counter"}});
+  EXPECT_THAT(sink.names, testing::ElementsAre("counter", "histogram"));
+}
+
+// Registers a family from another thread whenever it is flushed
+class RegisteringSink : public FamilyNameSink {
+ public:
+  explicit RegisteringSink(Registry& registry) : registry_(registry) {}
+
+  void Flush() override {
+    auto registered = std::async(std::launch::async, [this] {
+      BuildGauge().Name("registered").Register(registry_);
+    });
+    unlocked.push_back(registered.wait_for(std::chrono::seconds{5}) ==
+                       std::future_status::ready);
+    registered_.push_back(std::move(registered));
+  }
+
+  std::vector<bool> unlocked;
+
+ private:
+  Registry& registry_;
+  std::vector<std::future<void>> registered_;
+};
+
+TEST(RegistryTest, register_families_while_collecting_into_sink) {
+  Registry registry{};
+  BuildCounter().Name("counter").Register(registry).Add({});
+  BuildGauge().Name("gauge").Register(registry).Add({});
+
+  RegisteringSink sink{registry};
+  registry.CollectTo(sink);
+  EXPECT_THAT(sink.names, testing::ElementsAre("counter", "gauge"));
+  EXPECT_THAT(sink.unlocked, testing::ElementsAre(true, true));
+}
+
 TEST(RegistryTest, build_histogram_family) {
   Registry registry{};
   auto& histogram_family =
@@ -1,6 +1,9 @@
 #include "prometheus/counter.h"
 #include "prometheus/detail/future_std.h"
+#include "prometheus/detail/thread_pool.h"
 #include "prometheus/family.h"
+#include "prometheus/metric_sink.h"
+#include "prometheus/output_buffer.h"
 #include "prometheus/text_serializer.h"
 
 #include "raii_locale.h"
@@ -8,7 +11,10 @@
 #include <gmock/gmock.h>
 
 #include <memory>
+#include <ostream>
 #include <sstream>
+#include <string>
+#include <vector>
 
 namespace prometheus {
 namespace {
@@ -18,7 +24,7 @@ class SerializerTest : public testing::Test {
   void SetUp() override {
     Family<Counter> family{"requests_total", "", {}};
     auto& counter = family.Add({});
-    counter.Increment();
+    counter.Increment(1.5);
 
     collected = family.Collect();
   }
@@ -44,7 +50,7 @@ TEST_F(SerializerTest, shouldSerializeLocaleIndependent) {
   }
 
   const auto serialized = textSerializer.Serialize(collected);
-  EXPECT_THAT(serialized, testing::HasSubstr("1.0"));
+  EXPECT_THAT(serialized, testing::HasSubstr("1.5"));
 }
 #endif
 
@@ -69,5 +75,84 @@ TEST_F(SerializerTest, shouldRestoreStreamState) {
   EXPECT_EQ(os.getloc(), saved_locale);
 }
 
+TEST_F(SerializerTest, shouldSerializeConcurrentlyInOrder) {
+  Family<Counter> other{"errors_total", "", {}};
+  other.Add({}).Increment(2);
+  auto other_collected = other.Collect();
+  collected.insert(collected.end(), other_collected.begin(),
+                   other_collected.end());
+  detail::ThreadPool pool{2};
+
+  EXPECT_EQ(textSerializer.Serialize(collected),
+            textSerializer.Serialize(collected, pool));
+}
+
+// Implements only the std::ostream interface of the original Serializer
+class StreamOnlySerializer : public Serializer {
+ public:
+  using Serializer::Serialize;
+  void Serialize(std::ostream& out,
+                 const std::vector<MetricFamily>& metrics) const override {
+    for (auto& family : metrics) {
+      out << family.name << "\n";
+    }
+  }
+};
+
+TEST_F(SerializerTest, shouldWriteStreamSerializerToOutputBuffer) {
+  StreamOnlySerializer serializer;
+  StringOutputBuffer buffer;
+  serializer.Serialize(buffer, collected);
+
+  EXPECT_EQ("requests_total\n", buffer.ToString());
+  EXPECT_EQ("requests_total\n", serializer.Serialize(collected));
+}
+
+// Checks how much of its output has reached out before and after flushing
+class FlushingCollectable : public Collectable {
+ public:
+  explicit FlushingCollectable(const StringOutputBuffer& out) : out_(out) {}
+
+  std::vector<MetricFamily> Collect() const override { return {}; }
+
+  void CollectTo(MetricSink& sink) const override {
+    AddGauge(sink, "flushed", 1);
+    sizes.push_back(out_.GetSize());
+    sink.Flush();
+    sizes.push_back(out_.GetSize());
+    AddGauge(sink, "unflushed", 2);
+    sizes.push_back(out_.GetSize());
+  }
+
+  mutable std::vector<std::size_t> sizes;
+
+ private:
+  static void AddGauge(MetricSink& sink, const std::string& name,
+                       double value) {
+    static const auto no_label = std::vector<ClientMetric::Label>{};
+    static const auto no_labels = MetricSink::Labels{};
+    auto gauge = ClientMetric::Gauge{};
+    gauge.value = value;
+    sink.AddFamily(name, "", MetricType::Gauge);
+    sink.AddMetric(MetricSink::Series{no_label, no_labels, no_labels, 0},
+                   gauge);
+  }
+
+  const StringOutputBuffer& out_;
+};
+
+TEST_F(SerializerTest, shouldHoldBackOutputUntilFlushed) {
+  StringOutputBuffer out;
+  StringOutputBuffer pending;
+  FlushingCollectable collectable{out};
+  textSerializer.SerializeOutsideLocks(out, collectable, pending);
+
+  const auto flushed = std::string{"# TYPE flushed gauge\nflushed 1\n"};
+  EXPECT_THAT(collectable.sizes,
+              testing::ElementsAre(0U, flushed.size(), flushed.size()));
+  EXPECT_EQ(flushed + "# TYPE unflushed gauge\nunflushed 2\n",
+            out.ToString());
+}
+
 }  // namespace
 }  // namespace prometheus
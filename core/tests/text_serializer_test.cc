@@ -8,6 +8,7 @@
 #include "prometheus/family.h"
 #include "prometheus/gauge.h"
 #include "prometheus/histogram.h"
+#include "prometheus/registry.h"
 #include "prometheus/summary.h"
 
 namespace prometheus {
@@ -69,7 +70,21 @@ TEST_F(TextSerializerTest, shouldSerializeUntyped) {
   metric.untyped.value = 64.0;
 
   const auto serialized = Serialize(MetricType::Untyped);
-  EXPECT_THAT(serialized, testing::HasSubstr(name + " 64.000000"));
+  EXPECT_THAT(serialized, testing::HasSubstr(name + " 64\n"));
+}
+
+TEST_F(TextSerializerTest, shouldSerializeShortestRoundTrip) {
+  metric.gauge.value = 0.1;
+  EXPECT_THAT(Serialize(MetricType::Gauge),
+              testing::HasSubstr(name + " 0.1\n"));
+
+  metric.gauge.value = 1.5e-7;
+  EXPECT_THAT(Serialize(MetricType::Gauge),
+              testing::HasSubstr(name + " 1.5e-07\n"));
+
+  metric.gauge.value = -1e300;
+  EXPECT_THAT(Serialize(MetricType::Gauge),
+              testing::HasSubstr(name + " -1e+300\n"));
 }
 
 TEST_F(TextSerializerTest, shouldSerializeTimestamp) {
@@ -77,7 +92,7 @@ TEST_F(TextSerializerTest, shouldSerializeTimestamp) {
   metric.timestamp_ms = 1234;
 
   const auto serialized = Serialize(MetricType::Counter);
-  EXPECT_THAT(serialized, testing::HasSubstr(name + " 64.000000 1234"));
+  EXPECT_THAT(serialized, testing::HasSubstr(name + " 64 1234\n"));
 }
 
 TEST_F(TextSerializerTest, shouldSerializeHistogramWithNoBuckets) {
@@ -86,7 +101,7 @@ TEST_F(TextSerializerTest, shouldSerializeHistogramWithNoBuckets) {
 
   const auto serialized = Serialize(MetricType::Histogram);
   EXPECT_THAT(serialized, testing::HasSubstr(name + "_count 2"));
-  EXPECT_THAT(serialized, testing::HasSubstr(name + "_sum 32.00000"));
+  EXPECT_THAT(serialized, testing::HasSubstr(name + "_sum 32\n"));
   EXPECT_THAT(serialized, testing::HasSubstr(name + "_bucket{le=\"+Inf\"} 2"));
 }
 
@@ -98,9 +113,9 @@ TEST_F(TextSerializerTest, shouldSerializeHistogram) {
 
   const auto serialized = Serialize(MetricType::Histogram);
   EXPECT_THAT(serialized, testing::HasSubstr(name + "_count 2"));
-  EXPECT_THAT(serialized, testing::HasSubstr(name + "_sum 200.00000"));
+  EXPECT_THAT(serialized, testing::HasSubstr(name + "_sum 200\n"));
   EXPECT_THAT(serialized,
-              testing::HasSubstr(name + "_bucket{le=\"1.000000\"} 1"));
+              testing::HasSubstr(name + "_bucket{le=\"1\"} 1\n"));
   EXPECT_THAT(serialized, testing::HasSubstr(name + "_bucket{le=\"+Inf\"} 2"));
 }
 
@@ -112,9 +127,34 @@ TEST_F(TextSerializerTest, shouldSerializeSummary) {
 
   const auto serialized = Serialize(MetricType::Summary);
   EXPECT_THAT(serialized, testing::HasSubstr(name + "_count 2"));
-  EXPECT_THAT(serialized, testing::HasSubstr(name + "_sum 200.00000"));
+  EXPECT_THAT(serialized, testing::HasSubstr(name + "_sum 200\n"));
   EXPECT_THAT(serialized,
-              testing::HasSubstr(name + "{quantile=\"0.500000\"} 0.000000"));
+              testing::HasSubstr(name + "{quantile=\"0.5\"} 0\n"));
+}
+
+TEST(TextSerializerStreamingTest, shouldMatchCollectedMetrics) {
+  Registry registry;
+  auto& counter = BuildCounter()
+                      .Name("requests_total")
+                      .Help("all requests")
+                      .Labels({{"component", "test"}})
+                      .Register(registry);
+  counter.Add({{"status", "200"}}).Increment();
+  counter.Add({{"status", "500"}, {"path", "/\"x\"\n"}}).Increment(2);
+  BuildHistogram()
+      .Name("latency_seconds")
+      .Register(registry)
+      .Add({}, Histogram::BucketBoundaries{0.1, 1})
+      .Observe(0.5);
+  BuildSummary()
+      .Name("size_bytes")
+      .Register(registry)
+      .Add({{"a", "b"}}, Summary::Quantiles{{0.5, 0.05}})
+      .Observe(3);
+
+  TextSerializer serializer;
+  EXPECT_EQ(serializer.Serialize(registry.Collect()),
+            serializer.Serialize(registry));
 }
 
 }  // namespace
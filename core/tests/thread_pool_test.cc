@@ -0,0 +1,64 @@
+#include "prometheus/detail/thread_pool.h"
+
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+namespace prometheus {
+namespace detail {
+namespace {
+
+TEST(ThreadPoolTest, runs_every_index_once) {
+  ThreadPool pool{4};
+  std::vector<std::atomic<int>> calls(1000);
+  for (auto& call : calls) {
+    call = 0;
+  }
+
+  pool.ParallelFor(calls.size(), [&calls](std::size_t i) { ++calls[i]; });
+
+  for (auto& call : calls) {
+    EXPECT_EQ(1, call);
+  }
+}
+
+TEST(ThreadPoolTest, runs_on_calling_thread_without_workers) {
+  ThreadPool pool{0};
+  auto sum = std::size_t{0};
+
+  pool.ParallelFor(10, [&sum](std::size_t i) { sum += i; });
+
+  EXPECT_EQ(45U, sum);
+}
+
+TEST(ThreadPoolTest, nested_calls_do_not_deadlock) {
+  ThreadPool pool{2};
+  std::atomic<std::size_t> count{0};
+
+  pool.ParallelFor(8, [&pool, &count](std::size_t) {
+    pool.ParallelFor(8, [&count](std::size_t) { ++count; });
+  });
+
+  EXPECT_EQ(64U, count);
+}
+
+TEST(ThreadPoolTest, rethrows_exception) {
+  ThreadPool pool{2};
+  std::atomic<std::size_t> count{0};
+
+  EXPECT_THROW(pool.ParallelFor(16,
+                                [&count](std::size_t i) {
+                                  ++count;
+                                  if (i == 3) {
+                                    throw std::runtime_error("failed");
+                                  }
+                                }),
+               std::runtime_error);
+  EXPECT_EQ(16U, count);
+}
+
+}  // namespace
+}  // namespace detail
+}  // namespace prometheus
@@ -1,8 +1,11 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -16,26 +19,106 @@ namespace prometheus {
 
 namespace detail {
 class MetricsHandler;
+class ThreadPool;
 }  // namespace detail
 
 class PROMETHEUS_CPP_PULL_EXPORT Exposer {
  public:
+  /// \param num_collector_threads Number of threads used to collect and
+  /// serialize families concurrently during a scrape. Zero collects and
+  /// serializes on the thread serving the scrape.
   explicit Exposer(const std::string& bind_address,
                    const std::string& uri = std::string("/metrics"),
-                   const std::size_t num_threads = 2);
+                   const std::size_t num_threads = 2,
+                   const std::size_t num_collector_threads = 0);
   explicit Exposer(std::vector<std::string> options,
-                   const std::string& uri = std::string("/metrics"));
+                   const std::string& uri = std::string("/metrics"),
+                   const std::size_t num_collector_threads = 0);
   ~Exposer();
+
+  /// \brief Add a collectable to the following scrapes of the URI passed
+  /// to the constructor.
+  ///
+  /// Collectables can be registered and removed at any time. Scrapes which
+  /// are already running are not affected.
   void RegisterCollectable(const std::weak_ptr<Collectable>& collectable);
 
+  /// \brief Add a collectable to the following scrapes of the given URI.
+  ///
+  /// Each URI serves its own set of collectables, so, e.g., cheap metrics
+  /// on "/metrics/fast" can be scraped more often than expensive ones on
+  /// "/metrics/slow". The URI is served from the first registration on. The
+  /// statistics of the exposer are only served on the URI passed to the
+  /// constructor. The ones of additional URIs are labeled by uri.
+  void RegisterCollectable(const std::weak_ptr<Collectable>& collectable,
+                           const std::string& uri);
+
+  /// \brief Remove a collectable from the following scrapes of the URI
+  /// passed to the constructor.
+  ///
+  /// Removes all registrations of the collectable, even if it has been
+  /// destroyed already.
+  void RemoveCollectable(const std::weak_ptr<Collectable>& collectable);
+
+  /// \brief Remove a collectable from the following scrapes of the given
+  /// URI.
+  void RemoveCollectable(const std::weak_ptr<Collectable>& collectable,
+                         const std::string& uri);
+
+  /// \brief Set how scrapes of all URIs are compressed if the scraper
+  /// accepts gzip.
+  ///
+  /// Has no effect if the library was built without compression.
+  ///
+  /// \param level The zlib compression level from 0 (no compression) to 9
+  /// (best compression), -1 selects the zlib default of 6.
+  /// \param strategy The zlib compression strategy, e.g., 0 for
+  /// Z_DEFAULT_STRATEGY, 1 for Z_FILTERED, 2 for Z_HUFFMAN_ONLY or 3 for
+  /// Z_RLE.
+  void SetCompression(int level, int strategy = 0);
+
+  /// \brief Reuse rendered scrapes of all URIs for the given time.
+  ///
+  /// Scrapes arriving at the same time share one collection, and the
+  /// response is served from the cache to the following scrapes until it is
+  /// older than ttl. Each format is rendered once per ttl, and compressed
+  /// responses are compressed once from the cached plain response. Caching
+  /// is disabled by default or if ttl is zero.
+  void SetCacheTtl(std::chrono::milliseconds ttl);
+
+  /// \brief Serve scrapes of all URIs from snapshots pre-rendered in the
+  /// background.
+  ///
+  /// A background thread per URI collects the metrics in the given interval and
+  /// renders them in every format and encoding requested so far. Scrapes
+  /// are answered with the latest snapshot without collecting, so their
+  /// latency no longer depends on the number of metrics. The first scrape of
+  /// each format and encoding is rendered on demand, and its first snapshot
+  /// right afterwards. Pre-rendering is disabled by default or if interval
+  /// is zero.
+  void SetPreRenderInterval(std::chrono::milliseconds interval);
+
   std::vector<int> GetListeningPorts() const;
 
  private:
+  // Returns the handler of the given URI, which is added if necessary. Must
+  // be called with mutex_ held.
+  detail::MetricsHandler& GetMetricsHandler(const std::string& uri);
+
   std::unique_ptr<CivetServer> server_;
-  std::vector<std::weak_ptr<Collectable>> collectables_;
   std::shared_ptr<Registry> exposer_registry_;
-  std::unique_ptr<detail::MetricsHandler> metrics_handler_;
+  // Shared by the handlers of all URIs
+  std::unique_ptr<detail::ThreadPool> collector_pool_;
+  std::mutex mutex_;
+  std::map<std::string, std::unique_ptr<detail::MetricsHandler>>
+      metrics_handlers_;
   std::string uri_;
+
+  // Applied to the handlers of URIs added later
+  int compression_level_;
+  int compression_strategy_;
+  std::chrono::milliseconds cache_ttl_;
+  std::chrono::milliseconds pre_render_interval_;
 };
 
 }  // namespace prometheus
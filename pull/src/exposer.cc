@@ -1,6 +1,7 @@
 #include "prometheus/exposer.h"
 
 #include <chrono>
+#include <map>
 #include <string>
 #include <thread>
 
@@ -13,27 +14,102 @@
 namespace prometheus {
 
 Exposer::Exposer(const std::string& bind_address, const std::string& uri,
-                 const std::size_t num_threads)
+                 const std::size_t num_threads,
+                 const std::size_t num_collector_threads)
     : Exposer(
           std::vector<std::string>{"listening_ports", bind_address,
                                    "num_threads", std::to_string(num_threads)},
-          uri) {}
+          uri, num_collector_threads) {}
 
-Exposer::Exposer(std::vector<std::string> options, const std::string& uri)
+Exposer::Exposer(std::vector<std::string> options, const std::string& uri,
+                 const std::size_t num_collector_threads)
     : server_(detail::make_unique<CivetServer>(std::move(options))),
       exposer_registry_(std::make_shared<Registry>()),
-      metrics_handler_(
-          new detail::MetricsHandler{collectables_, *exposer_registry_}),
-      uri_(uri) {
+      collector_pool_(
+          num_collector_threads > 0
+              ? detail::make_unique<detail::ThreadPool>(num_collector_threads)
+              : nullptr),
+      uri_(uri),
+      // Z_DEFAULT_COMPRESSION and Z_DEFAULT_STRATEGY
+      compression_level_{-1},
+      compression_strategy_{0},
+      cache_ttl_{0},
+      pre_render_interval_{0} {
   RegisterCollectable(exposer_registry_);
-  server_->addHandler(uri, metrics_handler_.get());
 }
 
-Exposer::~Exposer() { server_->removeHandler(uri_); }
+Exposer::~Exposer() {
+  for (auto& handler : metrics_handlers_) {
+    server_->removeHandler(handler.first);
+  }
+}
+
+detail::MetricsHandler& Exposer::GetMetricsHandler(const std::string& uri) {
+  auto& handler = metrics_handlers_[uri];
+  if (!handler) {
+    // The statistics of the default URI keep the series they had before
+    // additional URIs could be served
+    auto labels = std::map<std::string, std::string>{};
+    if (uri != uri_) {
+      labels.emplace("uri", uri);
+    }
+    handler = detail::make_unique<detail::MetricsHandler>(
+        *exposer_registry_, labels, collector_pool_.get());
+    handler->SetCompression(compression_level_, compression_strategy_);
+    handler->SetCacheTtl(cache_ttl_);
+    handler->SetPreRenderInterval(pre_render_interval_);
+    server_->addHandler(uri, handler.get());
+  }
+  return *handler;
+}
 
 void Exposer::RegisterCollectable(
     const std::weak_ptr<Collectable>& collectable) {
-  collectables_.push_back(collectable);
+  RegisterCollectable(collectable, uri_);
+}
+
+void Exposer::RegisterCollectable(
+    const std::weak_ptr<Collectable>& collectable, const std::string& uri) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  GetMetricsHandler(uri).RegisterCollectable(collectable);
+}
+
+void Exposer::RemoveCollectable(const std::weak_ptr<Collectable>& collectable) {
+  RemoveCollectable(collectable, uri_);
+}
+
+void Exposer::RemoveCollectable(const std::weak_ptr<Collectable>& collectable,
+                                const std::string& uri) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto handler = metrics_handlers_.find(uri);
+  if (handler != metrics_handlers_.end()) {
+    handler->second->RemoveCollectable(collectable);
+  }
+}
+
+void Exposer::SetCompression(const int level, const int strategy) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  compression_level_ = level;
+  compression_strategy_ = strategy;
+  for (auto& handler : metrics_handlers_) {
+    handler.second->SetCompression(level, strategy);
+  }
+}
+
+void Exposer::SetCacheTtl(const std::chrono::milliseconds ttl) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  cache_ttl_ = ttl;
+  for (auto& handler : metrics_handlers_) {
+    handler.second->SetCacheTtl(ttl);
+  }
+}
+
+void Exposer::SetPreRenderInterval(const std::chrono::milliseconds interval) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  pre_render_interval_ = interval;
+  for (auto& handler : metrics_handlers_) {
+    handler.second->SetPreRenderInterval(interval);
+  }
 }
 
 std::vector<int> Exposer::GetListeningPorts() const {
@@ -2,43 +2,219 @@
 #include "prometheus/counter.h"
 #include "prometheus/summary.h"
 
+#include <algorithm>
 #include <cstring>
-
-#ifdef HAVE_ZLIB
-#include <zlib.h>
-#endif
+#include <functional>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
 
 #include "metrics_collector.h"
+#include "prometheus/detail/future_std.h"
+#include "prometheus/detail/gzip_buffer.h"
+#include "prometheus/metric_sink.h"
+#include "prometheus/name_filter.h"
+#include "prometheus/open_metrics_serializer.h"
+#include "prometheus/protobuf_serializer.h"
 #include "prometheus/serializer.h"
 #include "prometheus/text_serializer.h"
+#include "response_buffer.h"
 
 namespace prometheus {
 namespace detail {
 
-MetricsHandler::MetricsHandler(
-    const std::vector<std::weak_ptr<Collectable>>& collectables,
-    Registry& registry)
-    : collectables_(collectables),
+static Histogram::BucketBoundaries PhaseBuckets() {
+  return {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+          0.05,   0.1,     0.25,   0.5,   1,      2.5,   5,     10};
+}
+
+// Returns the given labels with one more label
+static std::map<std::string, std::string> WithLabel(
+    std::map<std::string, std::string> labels, const std::string& name,
+    const std::string& value) {
+  labels.emplace(name, value);
+  return labels;
+}
+
+MetricsHandler::MetricsHandler(Registry& registry,
+                               const std::map<std::string, std::string>& labels,
+                               ThreadPool* collector_pool)
+    : collectables_(std::make_shared<const Collectables>()),
       bytes_transferred_family_(
           BuildCounter()
               .Name("exposer_transferred_bytes_total")
               .Help("Transferred bytes to metrics services")
               .Register(registry)),
-      bytes_transferred_(bytes_transferred_family_.Add({})),
+      bytes_transferred_(bytes_transferred_family_.Add(labels)),
       num_scrapes_family_(BuildCounter()
                               .Name("exposer_scrapes_total")
                               .Help("Number of times metrics were scraped")
                               .Register(registry)),
-      num_scrapes_(num_scrapes_family_.Add({})),
+      num_scrapes_(num_scrapes_family_.Add(labels)),
       request_latencies_family_(
           BuildSummary()
               .Name("exposer_request_latencies")
               .Help("Latencies of serving scrape requests, in microseconds")
               .Register(registry)),
       request_latencies_(request_latencies_family_.Add(
-          {}, Summary::Quantiles{{0.5, 0.05}, {0.9, 0.01}, {0.99, 0.001}})) {}
+          labels,
+          Summary::Quantiles{{0.5, 0.05}, {0.9, 0.01}, {0.99, 0.001}})),
+      cache_requests_family_(
+          BuildCounter()
+              .Name("exposer_cached_scrapes_total")
+              .Help("Number of scrapes served while caching is enabled, by "
+                    "whether the response was cached, shared with a "
+                    "concurrent scrape or rendered")
+              .Register(registry)),
+      cache_hits_(
+          cache_requests_family_.Add(WithLabel(labels, "result", "hit"))),
+      cache_coalesced_(cache_requests_family_.Add(
+          WithLabel(labels, "result", "coalesced"))),
+      cache_misses_(
+          cache_requests_family_.Add(WithLabel(labels, "result", "miss"))),
+      cache_waiting_family_(
+          BuildGauge()
+              .Name("exposer_coalescing_scrapes")
+              .Help("Number of scrapes waiting for a concurrent scrape to "
+                    "render their response")
+              .Register(registry)),
+      cache_waiting_(cache_waiting_family_.Add(labels)),
+      snapshot_age_family_(
+          BuildGauge()
+              .Name("exposer_snapshot_age_seconds")
+              .Help("Age of the pre-rendered snapshot served by the latest "
+                    "scrape")
+              .Register(registry)),
+      snapshot_age_(snapshot_age_family_.Add(labels)),
+      phase_durations_family_(
+          BuildHistogram()
+              .Name("exposer_scrape_phase_duration_seconds")
+              .Help("Time spent in each phase of rendering and sending "
+                    "scrapes, in seconds")
+              .Register(registry)),
+      collect_duration_(phase_durations_family_.Add(
+          WithLabel(labels, "phase", "collect"), PhaseBuckets())),
+      serialize_duration_(phase_durations_family_.Add(
+          WithLabel(labels, "phase", "serialize"), PhaseBuckets())),
+      compress_duration_(phase_durations_family_.Add(
+          WithLabel(labels, "phase", "compress"), PhaseBuckets())),
+      write_duration_(phase_durations_family_.Add(
+          WithLabel(labels, "phase", "write"), PhaseBuckets())),
+      collectable_durations_family_(
+          BuildGauge()
+              .Name("exposer_collectable_duration_seconds")
+              .Help("Time spent collecting each collectable in the latest "
+                    "scrape by position in the registration order, in "
+                    "seconds")
+              .Register(registry)),
+      scraped_families_family_(
+          BuildGauge()
+              .Name("exposer_scraped_families")
+              .Help("Number of metric families in the latest scrape")
+              .Register(registry)),
+      scraped_families_(scraped_families_family_.Add(labels)),
+      scraped_series_family_(
+          BuildGauge()
+              .Name("exposer_scraped_series")
+              .Help("Number of time series in the latest scrape")
+              .Register(registry)),
+      scraped_series_(scraped_series_family_.Add(labels)),
+      compression_ratio_family_(
+          BuildGauge()
+              .Name("exposer_compression_ratio")
+              .Help("Uncompressed divided by compressed size of the latest "
+                    "compressed scrape")
+              .Register(registry)),
+      compression_ratio_(compression_ratio_family_.Add(labels)),
+      labels_(labels),
+      collector_pool_{collector_pool},
+      // Z_DEFAULT_COMPRESSION and Z_DEFAULT_STRATEGY
+      compression_level_{-1},
+      compression_strategy_{0},
+      cache_ttl_ms_{0},
+      cache_{cache_waiting_},
+      pre_rendering_{false},
+      stop_renderer_{false},
+      render_requested_{false} {}
+
+MetricsHandler::~MetricsHandler() { StopRenderer(); }
+
+void MetricsHandler::RegisterCollectable(
+    const std::weak_ptr<Collectable>& collectable) {
+  std::lock_guard<std::mutex> lock{collectables_mutex_};
+  auto collectables = std::make_shared<Collectables>(*collectables_);
+  collectables->push_back(collectable);
+  std::atomic_store(&collectables_,
+                    std::shared_ptr<const Collectables>{collectables});
+  RemoveCollectableDurations();
+}
+
+void MetricsHandler::RemoveCollectable(
+    const std::weak_ptr<Collectable>& collectable) {
+  std::lock_guard<std::mutex> lock{collectables_mutex_};
+  auto collectables = std::make_shared<Collectables>(*collectables_);
+  // Compares the owners, which also finds collectables already destroyed
+  auto same_owner = [&collectable](const std::weak_ptr<Collectable>& other) {
+    return !collectable.owner_before(other) && !other.owner_before(collectable);
+  };
+  collectables->erase(std::remove_if(collectables->begin(),
+                                     collectables->end(), same_owner),
+                      collectables->end());
+  std::atomic_store(&collectables_,
+                    std::shared_ptr<const Collectables>{collectables});
+  RemoveCollectableDurations();
+}
+
+void MetricsHandler::RemoveCollectableDurations() {
+  for (auto gauge : collectable_durations_) {
+    collectable_durations_family_.Remove(gauge);
+  }
+  collectable_durations_.clear();
+}
+
+std::shared_ptr<const MetricsHandler::Collectables>
+MetricsHandler::GetCollectables() const {
+  return std::atomic_load(&collectables_);
+}
+
+void MetricsHandler::SetCompression(const int level, const int strategy) {
+  compression_level_ = level;
+  compression_strategy_ = strategy;
+}
+
+void MetricsHandler::SetCacheTtl(const std::chrono::milliseconds ttl) {
+  cache_ttl_ms_ = ttl.count();
+}
+
+struct MetricsHandler::ScrapeContext {
+  Arena arena;
+  GZipCompressor compressor;
+  // Output held back while collectables may hold locks
+  StringOutputBuffer pending;
+};
+
+struct MetricsHandler::SnapshotBody {
+  StringOutputBuffer body;
+  // The number of scrapes sending the body, guarded by snapshots_mutex_
+  std::size_t readers = 0;
+};
+
+struct MetricsHandler::Snapshot {
+  Snapshot(const ExpositionFormat& format, bool gzip)
+      : format(format), gzip{gzip} {}
+
+  const ExpositionFormat& format;
+  const bool gzip;
+  // The bodies are swapped after each rendering. Scrapes only send the front
+  // body, so the back body is rendered into again once it has no readers
+  // left.
+  std::shared_ptr<SnapshotBody> front;
+  std::shared_ptr<SnapshotBody> back;
+  std::chrono::steady_clock::time_point rendered_at;
+};
 
-#ifdef HAVE_ZLIB
 static bool IsEncodingAccepted(struct mg_connection* conn,
                                const char* encoding) {
   auto accept_encoding = mg_get_header(conn, "Accept-Encoding");
@@ -48,81 +224,785 @@ static bool IsEncodingAccepted(struct mg_connection* conn,
   return std::strstr(accept_encoding, encoding) != nullptr;
 }
 
-static std::vector<Byte> GZipCompress(const std::string& input) {
-  auto zs = z_stream{};
-  auto windowSize = 16 + MAX_WBITS;
-  auto memoryLevel = 9;
+// An exposition format which can be requested by the Accept header
+struct ExpositionFormat {
+  const char* media_type;
+  // parameters the media range must contain to select this format
+  std::vector<std::string> required_parameters;
+  const char* content_type;
+  const Serializer& serializer;
+};
 
-  if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, windowSize,
-                   memoryLevel, Z_DEFAULT_STRATEGY) != Z_OK) {
-    return {};
+static std::string Trim(const std::string& str) {
+  const auto whitespace = " \t";
+  const auto begin = str.find_first_not_of(whitespace);
+  if (begin == std::string::npos) {
+    return "";
   }
+  const auto end = str.find_last_not_of(whitespace);
+  return str.substr(begin, end - begin + 1);
+}
+
+static std::vector<std::string> Split(const std::string& str, char separator) {
+  auto result = std::vector<std::string>{};
+  auto begin = std::size_t{0};
+  for (;;) {
+    const auto end = str.find(separator, begin);
+    result.push_back(Trim(str.substr(begin, end - begin)));
+    if (end == std::string::npos) {
+      return result;
+    }
+    begin = end + 1;
+  }
+}
 
-  zs.next_in = (Bytef*)input.data();
-  zs.avail_in = input.size();
+// Parses a quality value like "0.5", independent of the locale
+static double ParseQuality(const std::string& value) {
+  auto quality = 0.0;
+  auto scale = 1.0;
+  auto fraction = false;
+  for (auto c : value) {
+    if (c == '.' && !fraction) {
+      fraction = true;
+    } else if (c >= '0' && c <= '9') {
+      if (fraction) {
+        scale /= 10;
+        quality += (c - '0') * scale;
+      } else {
+        quality = quality * 10 + (c - '0');
+      }
+    } else {
+      return 0.0;
+    }
+  }
+  return quality;
+}
 
-  int ret;
-  std::vector<Byte> output;
-  output.reserve(input.size() / 2u);
+// Returns how specific the media range matches the format, zero if it does
+// not match at all. The quality of the media range is stored in quality.
+static int MatchMediaRange(const std::string& media_range,
+                           const ExpositionFormat& format, double* quality) {
+  const auto parameters = Split(media_range, ';');
+  const auto& type = parameters.front();
+
+  *quality = 1.0;
+  for (std::size_t i = 1; i < parameters.size(); ++i) {
+    if (parameters[i].compare(0, 2, "q=") == 0) {
+      *quality = ParseQuality(parameters[i].substr(2));
+    }
+  }
 
-  do {
-    static const auto outputBytesPerRound = std::size_t{32768};
+  auto has_required_parameters = true;
+  for (auto& parameter : format.required_parameters) {
+    if (std::find(parameters.begin() + 1, parameters.end(), parameter) ==
+        parameters.end()) {
+      has_required_parameters = false;
+    }
+  }
 
-    zs.avail_out = outputBytesPerRound;
-    output.resize(zs.total_out + zs.avail_out);
-    zs.next_out = reinterpret_cast<Bytef*>(output.data() + zs.total_out);
+  if (type == "*/*") {
+    return 1;
+  }
+  const std::string media_type = format.media_type;
+  const auto slash = media_type.find('/');
+  if (type.size() == slash + 2 && type.compare(slash, 2, "/*") == 0 &&
+      type.compare(0, slash, media_type, 0, slash) == 0) {
+    return 2;
+  }
+  if (type == media_type && has_required_parameters) {
+    return 3;
+  }
+  return 0;
+}
 
-    ret = deflate(&zs, Z_FINISH);
+// Returns the quality the Accept header gives to the format, taken from the
+// most specific matching media range
+static double GetQuality(const std::vector<std::string>& media_ranges,
+                         const ExpositionFormat& format) {
+  auto best_specificity = 0;
+  auto best_quality = 0.0;
+  for (auto& media_range : media_ranges) {
+    double quality;
+    const auto specificity = MatchMediaRange(media_range, format, &quality);
+    if (specificity > best_specificity) {
+      best_specificity = specificity;
+      best_quality = quality;
+    }
+  }
+  return best_quality;
+}
 
-    output.resize(zs.total_out);
-  } while (ret == Z_OK);
+// Selects the format with the highest quality in the Accept header of the
+// request. The text format is used if no format is accepted.
+static const ExpositionFormat& SelectExpositionFormat(
+    struct mg_connection* conn) {
+  static const TextSerializer text_serializer{};
+  static const ProtobufSerializer protobuf_serializer{};
+  static const OpenMetricsSerializer open_metrics_serializer{};
+  static const ExpositionFormat formats[] = {
+      {"text/plain", {}, "text/plain", text_serializer},
+      {"application/vnd.google.protobuf",
+       {"proto=io.prometheus.client.MetricFamily", "encoding=delimited"},
+       ProtobufSerializer::kContentType,
+       protobuf_serializer},
+      {"application/openmetrics-text",
+       {},
+       OpenMetricsSerializer::kContentType,
+       open_metrics_serializer},
+  };
 
-  deflateEnd(&zs);
+  auto accept = mg_get_header(conn, "Accept");
+  if (!accept) {
+    return formats[0];
+  }
 
-  if (ret != Z_STREAM_END) {
-    return {};
+  const auto media_ranges = Split(accept, ',');
+  const ExpositionFormat* selected = &formats[0];
+  auto selected_quality = 0.0;
+  for (auto& format : formats) {
+    const auto quality = GetQuality(media_ranges, format);
+    if (quality > selected_quality) {
+      selected = &format;
+      selected_quality = quality;
+    }
   }
+  return *selected;
+}
+
+// Measurements of one scrape. Phases which did not take place are left at
+// zero.
+struct ScrapeStats {
+  using Duration = std::chrono::steady_clock::duration;
 
-  return output;
+  Duration collect{};
+  Duration serialize{};
+  Duration compress{};
+  Duration write{};
+  // Time spent collecting each collectable of collectable_list by position
+  std::vector<Duration> collectables;
+  std::shared_ptr<const std::vector<std::weak_ptr<Collectable>>>
+      collectable_list;
+  std::size_t families = 0;
+  std::size_t series = 0;
+  std::size_t uncompressed_size = 0;
+  std::size_t compressed_size = 0;
+};
+
+static void CountMetrics(const std::vector<MetricFamily>& families,
+                         ScrapeStats& stats) {
+  stats.families += families.size();
+  for (auto& family : families) {
+    stats.series += family.metric.size();
+  }
 }
-#endif
 
-static std::size_t WriteResponse(struct mg_connection* conn,
-                                 const std::string& body) {
-  mg_printf(conn,
-            "HTTP/1.1 200 OK\r\n"
-            "Content-Type: text/plain\r\n");
+// Forwards everything to another sink while counting families and series and
+// measuring the time spent in the other sink
+class MeasuringSink : public MetricSink {
+ public:
+  MeasuringSink(MetricSink& sink, ScrapeStats& stats,
+                ScrapeStats::Duration& sink_time)
+      : sink_(sink), stats_(stats), sink_time_(sink_time) {}
+
+  void AddFamily(const std::string& name, const std::string& help,
+                 MetricType type) override {
+    ++stats_.families;
+    const auto start = std::chrono::steady_clock::now();
+    sink_.AddFamily(name, help, type);
+    sink_time_ += std::chrono::steady_clock::now() - start;
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Counter& counter) override {
+    Forward(series, counter);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Gauge& gauge) override {
+    Forward(series, gauge);
+  }
 
-#ifdef HAVE_ZLIB
-  auto acceptsGzip = IsEncodingAccepted(conn, "gzip");
+  void AddMetric(const Series& series,
+                 const ClientMetric::Summary& summary) override {
+    Forward(series, summary);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Histogram& histogram) override {
+    Forward(series, histogram);
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Untyped& untyped) override {
+    Forward(series, untyped);
+  }
+
+  void Flush() override {
+    const auto start = std::chrono::steady_clock::now();
+    sink_.Flush();
+    sink_time_ += std::chrono::steady_clock::now() - start;
+  }
+
+ private:
+  template <typename Value>
+  void Forward(const Series& series, const Value& value) {
+    ++stats_.series;
+    const auto start = std::chrono::steady_clock::now();
+    sink_.AddMetric(series, value);
+    sink_time_ += std::chrono::steady_clock::now() - start;
+  }
+
+  MetricSink& sink_;
+  ScrapeStats& stats_;
+  ScrapeStats::Duration& sink_time_;
+};
+
+// Counts the families and series collected from another collectable and
+// adds the time spent collecting them to collect_time. Time spent in the
+// sink of a serializer streaming the metrics is not included.
+class MeasuringCollectable : public Collectable {
+ public:
+  MeasuringCollectable(const Collectable& collectable, ScrapeStats& stats,
+                       ScrapeStats::Duration& collect_time)
+      : collectable_(collectable),
+        stats_(stats),
+        collect_time_(collect_time) {}
+
+  std::vector<MetricFamily> Collect() const override {
+    const auto start = std::chrono::steady_clock::now();
+    auto families = collectable_.Collect();
+    collect_time_ += std::chrono::steady_clock::now() - start;
+    CountMetrics(families, stats_);
+    return families;
+  }
+
+  std::vector<MetricFamily> CollectConcurrently(
+      ThreadPool& pool) const override {
+    const auto start = std::chrono::steady_clock::now();
+    auto families = collectable_.CollectConcurrently(pool);
+    collect_time_ += std::chrono::steady_clock::now() - start;
+    CountMetrics(families, stats_);
+    return families;
+  }
+
+  void CollectTo(MetricSink& sink) const override {
+    auto sink_time = ScrapeStats::Duration{};
+    MeasuringSink measuring{sink, stats_, sink_time};
+    const auto start = std::chrono::steady_clock::now();
+    collectable_.CollectTo(measuring);
+    collect_time_ += std::chrono::steady_clock::now() - start - sink_time;
+  }
+
+ private:
+  const Collectable& collectable_;
+  ScrapeStats& stats_;
+  ScrapeStats::Duration& collect_time_;
+};
+
+// Restricts another collectable to the families selected by a filter
+class FilteredCollectable : public Collectable {
+ public:
+  FilteredCollectable(const Collectable& collectable, const NameFilter& filter)
+      : collectable_(collectable), filter_(filter) {}
+
+  std::vector<MetricFamily> Collect() const override {
+    return collectable_.CollectFiltered(filter_);
+  }
 
-  if (acceptsGzip) {
-    auto compressed = GZipCompress(body);
-    if (!compressed.empty()) {
-      mg_printf(conn,
-                "Content-Encoding: gzip\r\n"
-                "Content-Length: %lu\r\n\r\n",
-                static_cast<unsigned long>(compressed.size()));
-      mg_write(conn, compressed.data(), compressed.size());
-      return compressed.size();
+  std::vector<MetricFamily> CollectConcurrently(
+      ThreadPool&) const override {
+    return collectable_.CollectFiltered(filter_);
+  }
+
+  void CollectTo(MetricSink& sink) const override {
+    collectable_.CollectFilteredTo(sink, filter_);
+  }
+
+ private:
+  const Collectable& collectable_;
+  const NameFilter& filter_;
+};
+
+// Adds the families requested by the name[] parameters of the query to the
+// filter. Names ending in '*' select a prefix. Returns false if a name does
+// not fit the buffer, as its family could not exist anyway.
+static bool GetNameFilter(struct mg_connection* conn, NameFilter& filter) {
+  auto request_info = mg_get_request_info(conn);
+  if (!request_info || !request_info->query_string) {
+    return true;
+  }
+
+  const auto query = request_info->query_string;
+  const auto query_size = std::strlen(query);
+  char value[1024];
+  for (auto parameter : {"name[]", "name%5B%5D"}) {
+    for (int occurrence = 0;; ++occurrence) {
+      const auto size = mg_get_var2(query, query_size, parameter, value,
+                                    sizeof(value), occurrence);
+      // -1 if there are no more occurrences, -2 if the value is too long
+      if (size == -2) {
+        return false;
+      }
+      if (size < 0) {
+        break;
+      }
+      filter.Add(std::string(value, size));
+    }
+  }
+  return true;
+}
+
+// Collectables only hold locks while writing to pending, so a slow scraper
+// does not keep the application from changing its metrics
+static void SerializeMetrics(
+    OutputBuffer& out, StringOutputBuffer& pending,
+    const std::vector<std::weak_ptr<Collectable>>& collectables,
+    const Serializer& serializer, ThreadPool* collector_pool,
+    const NameFilter& filter, ScrapeStats& stats) {
+  // Compressing and writing happen while serializing, so their time is
+  // subtracted from the time spent serializing
+  const auto output_time = [&stats] { return stats.compress + stats.write; };
+
+  // Filtered scrapes are small, so they are not worth collecting concurrently
+  if (collector_pool && filter.MatchesAll()) {
+    const auto start = std::chrono::steady_clock::now();
+    auto metrics =
+        CollectMetrics(collectables, *collector_pool, &stats.collectables);
+    const auto collected = std::chrono::steady_clock::now();
+    stats.collect += collected - start;
+    CountMetrics(metrics, stats);
+
+    const auto output_before = output_time();
+    serializer.Serialize(out, metrics, *collector_pool);
+    stats.serialize += std::chrono::steady_clock::now() - collected -
+                       (output_time() - output_before);
+    return;
+  }
+
+  // The metrics are serialized while they are collected. The time spent in
+  // the sink of the serializer is accounted to serializing, the rest of the
+  // time in the collectable to collecting.
+  stats.collectables.assign(collectables.size(), {});
+  for (std::size_t i = 0; i < collectables.size(); ++i) {
+    auto collectable = collectables[i].lock();
+    if (!collectable) {
+      continue;
     }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto output_before = output_time();
+    const FilteredCollectable filtered{*collectable, filter};
+    const Collectable* selected = collectable.get();
+    if (!filter.MatchesAll()) {
+      selected = &filtered;
+    }
+    auto& collect_time = stats.collectables[i];
+    serializer.SerializeOutsideLocks(
+        out, MeasuringCollectable{*selected, stats, collect_time}, pending);
+    stats.collect += collect_time;
+    stats.serialize += std::chrono::steady_clock::now() - start -
+                       collect_time - (output_time() - output_before);
   }
-#endif
+  serializer.SerializeTrailer(out);
+}
 
-  mg_printf(conn, "Content-Length: %lu\r\n\r\n",
-            static_cast<unsigned long>(body.size()));
-  mg_write(conn, body.data(), body.size());
-  return body.size();
+static bool IsChunkedEncodingSupported(struct mg_connection* conn) {
+  auto request_info = mg_get_request_info(conn);
+  return request_info && request_info->http_version &&
+         std::strcmp(request_info->http_version, "1.0") != 0;
+}
+
+// Returns the message of the exception currently handled
+static std::string GetErrorMessage() {
+  try {
+    throw;
+  } catch (const std::exception& e) {
+    return e.what();
+  } catch (...) {
+    return "unknown error";
+  }
+}
+
+// Sends the response with the given header lines and the body produced by
+// the given function. Returns the size of the body.
+//
+// Throws if the body could not be produced before anything was sent.
+static std::size_t WriteBody(
+    struct mg_connection* conn, const std::string& headers,
+    const std::function<void(OutputBuffer& out)>& serialize, Arena& arena,
+    ScrapeStats& stats) {
+  if (IsChunkedEncodingSupported(conn)) {
+    mg_printf(conn, "HTTP/1.1 200 OK\r\n%sTransfer-Encoding: chunked\r\n\r\n",
+              headers.c_str());
+    ResponseBuffer body{conn, arena, &stats.write};
+    try {
+      serialize(body);
+    } catch (...) {
+      // The status has been sent already. Leaving out the last chunk lets
+      // the scraper see that the body is incomplete once the connection is
+      // closed.
+      mg_cry(conn, "prometheus-cpp: aborted scrape: %s",
+             GetErrorMessage().c_str());
+      return body.GetBytesSent();
+    }
+    body.Finish();
+    return body.GetBytesSent();
+  }
+
+  // HTTP/1.0 does not know chunks, so the body is sent once it is complete
+  ArenaOutputBuffer body{arena};
+  serialize(body);
+  const auto start = std::chrono::steady_clock::now();
+  mg_printf(conn, "HTTP/1.1 200 OK\r\n%sContent-Length: %lu\r\n\r\n",
+            headers.c_str(), static_cast<unsigned long>(body.GetSize()));
+  body.ForEachChunk([conn](const char* data, std::size_t size) {
+    mg_write(conn, data, size);
+  });
+  stats.write += std::chrono::steady_clock::now() - start;
+  return body.GetSize();
+}
+
+// Sends the response with the given header lines and a body rendered
+// before. Returns the size of the body.
+static std::size_t WriteBody(struct mg_connection* conn,
+                             const std::string& headers,
+                             const StringOutputBuffer& body,
+                             ScrapeStats& stats) {
+  const auto start = std::chrono::steady_clock::now();
+  mg_printf(conn, "HTTP/1.1 200 OK\r\n%sContent-Length: %lu\r\n\r\n",
+            headers.c_str(), static_cast<unsigned long>(body.GetSize()));
+  mg_write(conn, body.GetData(), body.GetSize());
+  stats.write += std::chrono::steady_clock::now() - start;
+  return body.GetSize();
+}
+
+static double ToSeconds(const ScrapeStats::Duration duration) {
+  return std::chrono::duration<double>(duration).count();
+}
+
+void MetricsHandler::RecordStats(const ScrapeStats& stats) {
+  const auto phases = {
+      std::make_pair(stats.collect, &collect_duration_),
+      std::make_pair(stats.serialize, &serialize_duration_),
+      std::make_pair(stats.compress, &compress_duration_),
+      std::make_pair(stats.write, &write_duration_),
+  };
+  for (auto& phase : phases) {
+    if (phase.first.count() > 0) {
+      phase.second->Observe(ToSeconds(phase.first));
+    }
+  }
+
+  if (!stats.collectables.empty()) {
+    std::lock_guard<std::mutex> lock{collectables_mutex_};
+    // After a change of the list the positions refer to other collectables
+    if (stats.collectable_list == collectables_) {
+      for (std::size_t i = 0; i < stats.collectables.size(); ++i) {
+        if (i == collectable_durations_.size()) {
+          collectable_durations_.push_back(&collectable_durations_family_.Add(
+              WithLabel(labels_, "collectable", std::to_string(i))));
+        }
+        collectable_durations_[i]->Set(ToSeconds(stats.collectables[i]));
+      }
+    }
+  }
+
+  if (stats.collect.count() > 0 || stats.serialize.count() > 0) {
+    scraped_families_.Set(static_cast<double>(stats.families));
+    scraped_series_.Set(static_cast<double>(stats.series));
+  }
+  if (stats.compressed_size > 0) {
+    compression_ratio_.Set(static_cast<double>(stats.uncompressed_size) /
+                           static_cast<double>(stats.compressed_size));
+  }
+}
+
+std::unique_ptr<MetricsHandler::ScrapeContext>
+MetricsHandler::AcquireContext() {
+  // At most one context per thread serving scrapes is ever created
+  std::lock_guard<std::mutex> lock{contexts_mutex_};
+  if (contexts_.empty()) {
+    return make_unique<ScrapeContext>();
+  }
+  auto context = std::move(contexts_.back());
+  contexts_.pop_back();
+  return context;
+}
+
+void MetricsHandler::ReleaseContext(std::unique_ptr<ScrapeContext> context) {
+  context->arena.Reset();
+  std::lock_guard<std::mutex> lock{contexts_mutex_};
+  contexts_.push_back(std::move(context));
+}
+
+std::shared_ptr<MetricsHandler::SnapshotBody>
+MetricsHandler::GetSnapshot(
+    const ExpositionFormat& format, const bool gzip,
+    std::chrono::steady_clock::time_point* rendered_at) {
+  {
+    std::lock_guard<std::mutex> lock{snapshots_mutex_};
+    auto snapshot = std::find_if(
+        snapshots_.begin(), snapshots_.end(),
+        [&format, gzip](const std::unique_ptr<Snapshot>& snapshot) {
+          return &snapshot->format == &format && snapshot->gzip == gzip;
+        });
+    if (snapshot != snapshots_.end()) {
+      auto& front = (*snapshot)->front;
+      if (front) {
+        ++front->readers;
+        *rendered_at = (*snapshot)->rendered_at;
+      }
+      return front;
+    }
+    snapshots_.push_back(make_unique<Snapshot>(format, gzip));
+  }
+
+  // Rendered in the background from now on, starting right away
+  {
+    std::lock_guard<std::mutex> lock{renderer_mutex_};
+    render_requested_ = true;
+  }
+  renderer_wakeup_.notify_all();
+  return nullptr;
+}
+
+void MetricsHandler::ReleaseSnapshot(
+    const std::shared_ptr<SnapshotBody>& body) {
+  std::lock_guard<std::mutex> lock{snapshots_mutex_};
+  --body->readers;
+}
+
+void MetricsHandler::RenderSnapshots(ScrapeContext& context) {
+  std::vector<Snapshot*> snapshots;
+  {
+    std::lock_guard<std::mutex> lock{snapshots_mutex_};
+    for (auto& snapshot : snapshots_) {
+      snapshots.push_back(snapshot.get());
+    }
+  }
+  if (snapshots.empty()) {
+    return;
+  }
+
+  // All formats are rendered from the same collection
+  const auto start = std::chrono::steady_clock::now();
+  const auto collectables = GetCollectables();
+  ScrapeStats collect_stats;
+  collect_stats.collectable_list = collectables;
+  const auto metrics =
+      collector_pool_ ? CollectMetrics(*collectables, *collector_pool_,
+                                       &collect_stats.collectables)
+                      : CollectMetrics(*collectables,
+                                       &collect_stats.collectables);
+  collect_stats.collect = std::chrono::steady_clock::now() - start;
+  CountMetrics(metrics, collect_stats);
+  RecordStats(collect_stats);
+
+  for (auto snapshot : snapshots) {
+    auto& back = snapshot->back;
+    {
+      // Scrapes still sending the back body keep it alive
+      std::lock_guard<std::mutex> lock{snapshots_mutex_};
+      if (!back || back->readers > 0) {
+        back = std::make_shared<SnapshotBody>();
+      }
+    }
+    auto& body = back->body;
+    body.Clear();
+
+    ScrapeStats stats;
+    auto serialize = [this, snapshot, &metrics, &stats](OutputBuffer& out) {
+      const auto start = std::chrono::steady_clock::now();
+      if (collector_pool_) {
+        snapshot->format.serializer.Serialize(out, metrics, *collector_pool_);
+      } else {
+        snapshot->format.serializer.Serialize(out, metrics);
+      }
+      stats.serialize =
+          std::chrono::steady_clock::now() - start - stats.compress;
+    };
+    if (snapshot->gzip) {
+      auto& compressor = context.compressor;
+      if (!compressor.Start(compression_level_, compression_strategy_)) {
+        continue;
+      }
+      GZipBuffer compressed{compressor, body, context.arena,
+                            &stats.compress};
+      serialize(compressed);
+      if (!compressed.Finish()) {
+        // The previous snapshot is kept rather than serving a broken body
+        context.arena.Reset();
+        continue;
+      }
+      stats.uncompressed_size = compressor.GetTotalIn();
+      stats.compressed_size = compressor.GetTotalOut();
+    } else {
+      serialize(body);
+    }
+    context.arena.Reset();
+    // Only the size of the collection is recorded
+    stats.families = collect_stats.families;
+    stats.series = collect_stats.series;
+    RecordStats(stats);
+
+    std::lock_guard<std::mutex> lock{snapshots_mutex_};
+    std::swap(snapshot->front, back);
+    snapshot->rendered_at = start;
+  }
+}
+
+void MetricsHandler::RunRenderer(const std::chrono::milliseconds interval) {
+  ScrapeContext context;
+  std::unique_lock<std::mutex> lock{renderer_mutex_};
+  while (!stop_renderer_) {
+    render_requested_ = false;
+    lock.unlock();
+    RenderSnapshots(context);
+    lock.lock();
+    renderer_wakeup_.wait_for(lock, interval, [this] {
+      return stop_renderer_ || render_requested_;
+    });
+  }
+}
+
+void MetricsHandler::StopRenderer() {
+  if (!renderer_.joinable()) {
+    return;
+  }
+  pre_rendering_ = false;
+  {
+    std::lock_guard<std::mutex> lock{renderer_mutex_};
+    stop_renderer_ = true;
+  }
+  renderer_wakeup_.notify_all();
+  renderer_.join();
+  stop_renderer_ = false;
+
+  // Outdated snapshots must not be served if rendering is resumed
+  std::lock_guard<std::mutex> lock{snapshots_mutex_};
+  snapshots_.clear();
+}
+
+void MetricsHandler::SetPreRenderInterval(
+    const std::chrono::milliseconds interval) {
+  StopRenderer();
+  if (interval.count() > 0) {
+    renderer_ = std::thread{&MetricsHandler::RunRenderer, this, interval};
+    pre_rendering_ = true;
+  }
 }
 
 bool MetricsHandler::handleGet(CivetServer*, struct mg_connection* conn) {
   auto start_time_of_request = std::chrono::steady_clock::now();
 
-  auto metrics = CollectMetrics(collectables_);
+  const auto& format = SelectExpositionFormat(conn);
+  auto filter = NameFilter{};
+  if (!GetNameFilter(conn, filter)) {
+    mg_printf(conn,
+              "HTTP/1.1 400 Bad Request\r\n"
+              "Content-Length: 0\r\n\r\n");
+    return true;
+  }
+
+  auto context = AcquireContext();
+  auto& arena = context->arena;
+  auto gzip = false;
+  ScrapeStats stats;
+  const auto collectables = GetCollectables();
+  stats.collectable_list = collectables;
+  const std::function<void(OutputBuffer&)> render =
+      [this, &context, &collectables, &format, &filter,
+       &stats](OutputBuffer& out) {
+        SerializeMetrics(out, context->pending, *collectables,
+                         format.serializer, collector_pool_, filter, stats);
+      };
 
-  auto serializer = std::unique_ptr<Serializer>{new TextSerializer()};
+  auto headers = std::string{"Content-Type: "} + format.content_type + "\r\n";
 
-  auto bodySize = WriteResponse(conn, serializer->Serialize(metrics));
+  // Compresses the body written by the given function to out, empty if the
+  // response is not compressed
+  std::function<void(const std::function<void(OutputBuffer&)>&, OutputBuffer&)>
+      compress;
+  // Without zlib no compressor can be started
+  auto& compressor = context->compressor;
+  if (IsEncodingAccepted(conn, "gzip") &&
+      compressor.Start(compression_level_, compression_strategy_)) {
+    headers += "Content-Encoding: gzip\r\n";
+    gzip = true;
+    compress = [&compressor, &arena, &stats](
+                   const std::function<void(OutputBuffer&)>& write,
+                   OutputBuffer& out) {
+      GZipBuffer compressed{compressor, out, arena, &stats.compress};
+      write(compressed);
+      if (!compressed.Finish()) {
+        throw std::runtime_error{"gzip compression failed"};
+      }
+      stats.uncompressed_size = compressor.GetTotalIn();
+      stats.compressed_size = compressor.GetTotalOut();
+    };
+  }
+
+  std::size_t bodySize = 0;
+  std::chrono::steady_clock::time_point rendered_at;
+  // Snapshots and the cache only hold complete scrapes
+  const auto snapshot = pre_rendering_ && filter.MatchesAll()
+                            ? GetSnapshot(format, gzip, &rendered_at)
+                            : nullptr;
+  const auto cache_ttl = std::chrono::milliseconds{cache_ttl_ms_};
+  try {
+    if (snapshot) {
+      bodySize = WriteBody(conn, headers, snapshot->body, stats);
+      snapshot_age_.Set(std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - rendered_at)
+                            .count());
+    } else if (cache_ttl.count() > 0 && filter.MatchesAll()) {
+      auto result = ScrapeCache::Result::Miss;
+      // Compressed responses are derived from the plain body of the format
+      auto body = cache_.Get(format.content_type, cache_ttl, render, &result);
+      if (compress) {
+        const auto& compressed = body->GetCompressed(
+            [&compress](const StringOutputBuffer& raw, OutputBuffer& out) {
+              compress(
+                  [&raw](OutputBuffer& in) {
+                    in.Write(raw.GetData(), raw.GetSize());
+                  },
+                  out);
+            });
+        bodySize = WriteBody(conn, headers, compressed, stats);
+      } else {
+        bodySize = WriteBody(conn, headers, body->GetRaw(), stats);
+      }
+      switch (result) {
+        case ScrapeCache::Result::Hit:
+          cache_hits_.Increment();
+          break;
+        case ScrapeCache::Result::Coalesced:
+          cache_coalesced_.Increment();
+          break;
+        case ScrapeCache::Result::Miss:
+          cache_misses_.Increment();
+          break;
+      }
+    } else if (compress) {
+      bodySize = WriteBody(
+          conn, headers,
+          [&compress, &render](OutputBuffer& out) { compress(render, out); },
+          arena, stats);
+    } else {
+      bodySize = WriteBody(conn, headers, render, arena, stats);
+    }
+  } catch (...) {
+    mg_cry(conn, "prometheus-cpp: failed scrape: %s",
+           GetErrorMessage().c_str());
+    mg_printf(conn,
+              "HTTP/1.1 500 Internal Server Error\r\n"
+              "Content-Length: 0\r\n\r\n");
+  }
+  if (snapshot) {
+    ReleaseSnapshot(snapshot);
+  }
+  ReleaseContext(std::move(context));
+  RecordStats(stats);
 
   auto stop_time_of_request = std::chrono::steady_clock::now();
   auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
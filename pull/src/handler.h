@@ -1,30 +1,138 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include "CivetServer.h"
 #include "prometheus/counter.h"
+#include "prometheus/detail/arena.h"
+#include "prometheus/detail/thread_pool.h"
+#include "prometheus/gauge.h"
+#include "prometheus/histogram.h"
 #include "prometheus/registry.h"
 #include "prometheus/summary.h"
+#include "scrape_cache.h"
 
 namespace prometheus {
 namespace detail {
+struct ExpositionFormat;
+struct ScrapeStats;
+
 class MetricsHandler : public CivetHandler {
  public:
-  MetricsHandler(const std::vector<std::weak_ptr<Collectable>>& collectables,
-                 Registry& registry);
+  /// \param labels Distinguish the statistics of this handler from the ones
+  /// of handlers of other URIs in the same registry.
+  /// \param collector_pool Threads collecting and serializing concurrently,
+  /// nullptr to do so on the thread serving the scrape.
+  MetricsHandler(Registry& registry,
+                 const std::map<std::string, std::string>& labels,
+                 ThreadPool* collector_pool = nullptr);
+
+  ~MetricsHandler() override;
 
   bool handleGet(CivetServer* server, struct mg_connection* conn) override;
 
+  void RegisterCollectable(const std::weak_ptr<Collectable>& collectable);
+  void RemoveCollectable(const std::weak_ptr<Collectable>& collectable);
+
+  /// \brief Set the zlib compression level and strategy of gzip responses.
+  void SetCompression(int level, int strategy);
+
+  /// \brief Set how long rendered responses are reused, zero disables
+  /// caching.
+  void SetCacheTtl(std::chrono::milliseconds ttl);
+
+  /// \brief Serve scrapes from snapshots rendered by a background thread in
+  /// the given interval, zero stops rendering in the background.
+  void SetPreRenderInterval(std::chrono::milliseconds interval);
+
  private:
-  const std::vector<std::weak_ptr<Collectable>>& collectables_;
+  // Memory and compression state reused by the following scrapes
+  struct ScrapeContext;
+  // The latest pre-rendered response of one format and encoding
+  struct Snapshot;
+  // A rendered response and the scrapes sending it
+  struct SnapshotBody;
+
+  using Collectables = std::vector<std::weak_ptr<Collectable>>;
+
+  std::shared_ptr<const Collectables> GetCollectables() const;
+
+  std::unique_ptr<ScrapeContext> AcquireContext();
+  void ReleaseContext(std::unique_ptr<ScrapeContext> context);
+
+  // Must be followed by ReleaseSnapshot() once the body has been sent
+  std::shared_ptr<SnapshotBody> GetSnapshot(
+      const ExpositionFormat& format, bool gzip,
+      std::chrono::steady_clock::time_point* rendered_at);
+  void ReleaseSnapshot(const std::shared_ptr<SnapshotBody>& body);
+  void RenderSnapshots(ScrapeContext& context);
+  void RunRenderer(std::chrono::milliseconds interval);
+  void StopRenderer();
+
+  void RecordStats(const ScrapeStats& stats);
+  // Must be called with collectables_mutex_ held
+  void RemoveCollectableDurations();
+
+  // Replaced by a modified copy on every change, so scrapes iterate over a
+  // list which does not change while they are running. Only accessed by
+  // std::atomic_load() and std::atomic_store().
+  std::shared_ptr<const Collectables> collectables_;
+  // Serializes changes of the list
+  std::mutex collectables_mutex_;
   Family<Counter>& bytes_transferred_family_;
   Counter& bytes_transferred_;
   Family<Counter>& num_scrapes_family_;
   Counter& num_scrapes_;
   Family<Summary>& request_latencies_family_;
   Summary& request_latencies_;
+  Family<Counter>& cache_requests_family_;
+  Counter& cache_hits_;
+  Counter& cache_coalesced_;
+  Counter& cache_misses_;
+  Family<Gauge>& cache_waiting_family_;
+  Gauge& cache_waiting_;
+  Family<Gauge>& snapshot_age_family_;
+  Gauge& snapshot_age_;
+  Family<Histogram>& phase_durations_family_;
+  Histogram& collect_duration_;
+  Histogram& serialize_duration_;
+  Histogram& compress_duration_;
+  Histogram& write_duration_;
+  Family<Gauge>& collectable_durations_family_;
+  // The gauges of the positions in the list, guarded by collectables_mutex_
+  std::vector<Gauge*> collectable_durations_;
+  Family<Gauge>& scraped_families_family_;
+  Gauge& scraped_families_;
+  Family<Gauge>& scraped_series_family_;
+  Gauge& scraped_series_;
+  Family<Gauge>& compression_ratio_family_;
+  Gauge& compression_ratio_;
+  const std::map<std::string, std::string> labels_;
+  ThreadPool* const collector_pool_;
+  std::atomic<int> compression_level_;
+  std::atomic<int> compression_strategy_;
+  std::atomic<std::chrono::milliseconds::rep> cache_ttl_ms_;
+  ScrapeCache cache_;
+  std::mutex contexts_mutex_;
+  std::vector<std::unique_ptr<ScrapeContext>> contexts_;
+
+  std::mutex snapshots_mutex_;
+  std::vector<std::unique_ptr<Snapshot>> snapshots_;
+  std::atomic<bool> pre_rendering_;
+  std::mutex renderer_mutex_;
+  std::condition_variable renderer_wakeup_;
+  bool stop_renderer_;
+  // Set when a scrape asks for a format which has no snapshot yet
+  bool render_requested_;
+  std::thread renderer_;
 };
 }  // namespace detail
 }  // namespace prometheus
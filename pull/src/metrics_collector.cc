@@ -1,21 +1,65 @@
 #include "metrics_collector.h"
 
 #include "prometheus/collectable.h"
+#include "prometheus/detail/thread_pool.h"
 
 namespace prometheus {
 namespace detail {
 
 std::vector<MetricFamily> CollectMetrics(
-    const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables) {
+    const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables,
+    std::vector<std::chrono::steady_clock::duration>* durations) {
   auto collected_metrics = std::vector<MetricFamily>{};
+  if (durations) {
+    durations->assign(collectables.size(), {});
+  }
 
-  for (auto&& wcollectable : collectables) {
-    auto collectable = wcollectable.lock();
+  for (std::size_t i = 0; i < collectables.size(); ++i) {
+    auto collectable = collectables[i].lock();
     if (!collectable) {
       continue;
     }
 
+    const auto start = std::chrono::steady_clock::now();
     auto&& metrics = collectable->Collect();
+    if (durations) {
+      (*durations)[i] = std::chrono::steady_clock::now() - start;
+    }
+    collected_metrics.insert(collected_metrics.end(),
+                             std::make_move_iterator(metrics.begin()),
+                             std::make_move_iterator(metrics.end()));
+  }
+
+  return collected_metrics;
+}
+
+std::vector<MetricFamily> CollectMetrics(
+    const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables,
+    ThreadPool& pool,
+    std::vector<std::chrono::steady_clock::duration>* durations) {
+  auto locked = std::vector<std::shared_ptr<prometheus::Collectable>>{};
+  for (auto&& wcollectable : collectables) {
+    locked.push_back(wcollectable.lock());
+  }
+  if (durations) {
+    durations->assign(collectables.size(), {});
+  }
+
+  auto collected = std::vector<std::vector<MetricFamily>>(locked.size());
+  pool.ParallelFor(locked.size(), [&locked, &collected, &pool,
+                                   durations](std::size_t i) {
+    if (!locked[i]) {
+      return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    collected[i] = locked[i]->CollectConcurrently(pool);
+    if (durations) {
+      (*durations)[i] = std::chrono::steady_clock::now() - start;
+    }
+  });
+
+  auto collected_metrics = std::vector<MetricFamily>{};
+  for (auto&& metrics : collected) {
     collected_metrics.insert(collected_metrics.end(),
                              std::make_move_iterator(metrics.begin()),
                              std::make_move_iterator(metrics.end()));
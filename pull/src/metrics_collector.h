@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <vector>
 
@@ -8,7 +9,16 @@
 namespace prometheus {
 class Collectable;
 namespace detail {
+class ThreadPool;
+
+/// \param durations If not nullptr, receives the time spent collecting each
+/// collectable by position, zero for collectables which expired.
+std::vector<prometheus::MetricFamily> CollectMetrics(
+    const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables,
+    std::vector<std::chrono::steady_clock::duration>* durations = nullptr);
 std::vector<prometheus::MetricFamily> CollectMetrics(
-    const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables);
+    const std::vector<std::weak_ptr<prometheus::Collectable>>& collectables,
+    ThreadPool& pool,
+    std::vector<std::chrono::steady_clock::duration>* durations = nullptr);
 }  // namespace detail
 }  // namespace prometheus
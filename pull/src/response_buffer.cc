@@ -0,0 +1,66 @@
+#include "response_buffer.h"
+
+#include <algorithm>
+
+#include "CivetServer.h"
+
+namespace prometheus {
+namespace detail {
+
+ResponseBuffer::ResponseBuffer(
+    struct mg_connection* conn, Arena& arena,
+    std::chrono::steady_clock::duration* send_time,
+    const std::size_t buffer_size)
+    : conn_(conn),
+      arena_(arena),
+      buffer_{static_cast<char*>(arena.Allocate(buffer_size))},
+      buffer_size_{buffer_size},
+      bytes_sent_{0},
+      failed_{false},
+      send_time_{send_time} {
+  SetWindow(buffer_, buffer_ + buffer_size_);
+}
+
+void ResponseBuffer::Finish() {
+  Send();
+  if (!failed_) {
+    const auto start = std::chrono::steady_clock::now();
+    mg_send_chunk(conn_, "", 0);
+    if (send_time_) {
+      *send_time_ += std::chrono::steady_clock::now() - start;
+    }
+  }
+}
+
+void ResponseBuffer::Grow(const std::size_t min_size, std::size_t) {
+  Send();
+  if (min_size > buffer_size_) {
+    buffer_size_ = min_size;
+    buffer_ = static_cast<char*>(arena_.Allocate(buffer_size_));
+  }
+  SetWindow(buffer_, buffer_ + buffer_size_);
+}
+
+void ResponseBuffer::Send() {
+  const auto size = static_cast<std::size_t>(GetNext() - buffer_);
+  SetWindow(buffer_, buffer_ + buffer_size_);
+  if (size == 0 || failed_) {
+    return;
+  }
+
+  // Stop sending once the connection failed, but keep accepting writes until
+  // the serialization is complete.
+  const auto start = std::chrono::steady_clock::now();
+  const auto sent = mg_send_chunk(conn_, buffer_, static_cast<unsigned>(size));
+  if (send_time_) {
+    *send_time_ += std::chrono::steady_clock::now() - start;
+  }
+  if (sent <= 0) {
+    failed_ = true;
+    return;
+  }
+  bytes_sent_ += size;
+}
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+#include "prometheus/detail/arena.h"
+#include "prometheus/output_buffer.h"
+
+struct mg_connection;
+
+namespace prometheus {
+namespace detail {
+
+/// \brief Sends the data written to it as body of a response with chunked
+/// transfer encoding.
+///
+/// A chunk is sent whenever the buffer is full, so the response is sent while
+/// it is still being written. The buffers are allocated from the given arena.
+class ResponseBuffer : public OutputBuffer {
+ public:
+  /// \param send_time If not nullptr, the time spent sending is added to it.
+  ResponseBuffer(struct mg_connection* conn, Arena& arena,
+                 std::chrono::steady_clock::duration* send_time = nullptr,
+                 std::size_t buffer_size = 16 * 1024);
+
+  /// \brief Sends the remaining data and terminates the body.
+  void Finish();
+
+  /// \brief Returns the number of bytes of the body sent so far.
+  std::size_t GetBytesSent() const { return bytes_sent_; }
+
+ protected:
+  void Grow(std::size_t min_size, std::size_t size) override;
+
+ private:
+  void Send();
+
+  struct mg_connection* conn_;
+  Arena& arena_;
+  char* buffer_;
+  std::size_t buffer_size_;
+  std::size_t bytes_sent_;
+  bool failed_;
+  std::chrono::steady_clock::duration* send_time_;
+};
+
+}  // namespace detail
+}  // namespace prometheus
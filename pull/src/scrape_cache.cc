@@ -0,0 +1,69 @@
+#include "scrape_cache.h"
+
+namespace prometheus {
+namespace detail {
+
+const StringOutputBuffer& ScrapeCache::CachedBody::GetCompressed(
+    const Compressor& compress) const {
+  std::call_once(compressed_once_, [this, &compress] {
+    compressed_.Clear();
+    compress(raw_, compressed_);
+  });
+  return compressed_;
+}
+
+ScrapeCache::ScrapeCache(Gauge& waiting) : waiting_(waiting) {}
+
+ScrapeCache::Body ScrapeCache::Get(
+    const std::string& key, const std::chrono::steady_clock::duration ttl,
+    const Renderer& render, Result* result) {
+  std::unique_lock<std::mutex> lock{mutex_};
+  auto& entry = entries_[key];
+
+  // A body rendered while waiting is used even if rendering took longer than
+  // the ttl, otherwise slow collections would never be shared.
+  const auto generation = entry.generation;
+  if (entry.rendering) {
+    waiting_.Increment();
+    while (entry.rendering) {
+      rendered_.wait(lock);
+    }
+    waiting_.Decrement();
+  }
+  if (entry.body && entry.generation != generation) {
+    *result = Result::Coalesced;
+    return entry.body;
+  }
+  if (entry.body &&
+      std::chrono::steady_clock::now() - entry.rendered_at < ttl) {
+    *result = Result::Hit;
+    return entry.body;
+  }
+
+  entry.rendering = true;
+  lock.unlock();
+
+  const auto start = std::chrono::steady_clock::now();
+  auto body = std::make_shared<CachedBody>();
+  try {
+    render(body->raw_);
+  } catch (...) {
+    lock.lock();
+    entry.rendering = false;
+    rendered_.notify_all();
+    throw;
+  }
+
+  lock.lock();
+  entry.body = std::move(body);
+  entry.rendered_at = start;
+  ++entry.generation;
+  entry.rendering = false;
+  rendered_.notify_all();
+
+  *result = Result::Miss;
+  return entry.body;
+}
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "prometheus/gauge.h"
+#include "prometheus/output_buffer.h"
+
+namespace prometheus {
+namespace detail {
+
+/// \brief Shares rendered response bodies between concurrent and following
+/// scrapes.
+///
+/// Each format is cached under its own key. A body is rendered by only one
+/// of the scrapes asking for it at the same time. The others wait for and
+/// reuse its result. Compressed responses are derived from the cached body,
+/// so plain and compressed scrapes of a format share one collection.
+class ScrapeCache {
+ public:
+  using Renderer = std::function<void(OutputBuffer& out)>;
+  using Compressor =
+      std::function<void(const StringOutputBuffer& raw, OutputBuffer& out)>;
+
+  /// \brief A rendered body and its compressed form.
+  class CachedBody {
+   public:
+    /// \brief Returns the body as rendered.
+    const StringOutputBuffer& GetRaw() const { return raw_; }
+
+    /// \brief Returns the body compressed by the given function.
+    ///
+    /// The body is compressed by the first caller only, the others wait for
+    /// and reuse its result. If compress throws, the next caller tries again.
+    const StringOutputBuffer& GetCompressed(const Compressor& compress) const;
+
+   private:
+    friend class ScrapeCache;
+
+    StringOutputBuffer raw_;
+    mutable std::once_flag compressed_once_;
+    mutable StringOutputBuffer compressed_;
+  };
+
+  using Body = std::shared_ptr<const CachedBody>;
+
+  /// \param waiting Set to the number of callers waiting for another one to
+  /// render a body.
+  explicit ScrapeCache(Gauge& waiting);
+
+  enum class Result {
+    // the body was cached and fresh
+    Hit,
+    // the body was rendered by another scrape while waiting
+    Coalesced,
+    // the body was rendered by the caller
+    Miss,
+  };
+
+  /// \brief Returns the body cached under the key if it was rendered less
+  /// than ttl ago, otherwise renders it anew with the given function.
+  ///
+  /// \param result Set to how the body was obtained.
+  Body Get(const std::string& key, std::chrono::steady_clock::duration ttl,
+           const Renderer& render, Result* result);
+
+ private:
+  struct Entry {
+    Body body;
+    std::chrono::steady_clock::time_point rendered_at;
+    std::uint64_t generation = 0;
+    bool rendering = false;
+  };
+
+  Gauge& waiting_;
+  std::mutex mutex_;
+  std::condition_variable rendered_;
+  std::map<std::string, Entry> entries_;
+};
+
+}  // namespace detail
+}  // namespace prometheus
@@ -2,6 +2,24 @@
 
 #include <gmock/gmock.h>
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "http_client.h"
+#include "prometheus/collectable.h"
+#include "prometheus/counter.h"
+#include "prometheus/histogram.h"
+#include "prometheus/metric_family.h"
+#include "prometheus/open_metrics_serializer.h"
+#include "prometheus/protobuf_serializer.h"
+#include "prometheus/registry.h"
+
 namespace prometheus {
 namespace {
 
@@ -21,5 +39,460 @@ TEST(ExposerTest, listenOnDistinctPorts) {
   EXPECT_NE(firstExposerPorts, secondExposerPorts);
 }
 
+// Scrapes an exposer through its socket
+class ExposerScrapeTest : public testing::Test {
+ public:
+  ExposerScrapeTest()
+      : exposer_{"127.0.0.1:0"},
+        registry_{std::make_shared<Registry>()},
+        counter_{BuildCounter()
+                     .Name("test_counter")
+                     .Help("Test counter")
+                     .Register(*registry_)
+                     .Add({})} {
+    exposer_.RegisterCollectable(registry_);
+  }
+
+ protected:
+  HttpResponse Get(const std::string& target,
+                   const std::vector<std::string>& headers = {},
+                   const std::string& version = "HTTP/1.1") {
+    return HttpGet(exposer_.GetListeningPorts().front(), target, headers,
+                   version);
+  }
+
+  // Returns the content type negotiated for the given Accept header
+  std::string Negotiate(const std::string& accept) {
+    return Get("/metrics", {"Accept: " + accept}).headers["Content-Type"];
+  }
+
+  Exposer exposer_;
+  std::shared_ptr<Registry> registry_;
+  Counter& counter_;
+};
+
+TEST_F(ExposerScrapeTest, negotiateExpositionFormat) {
+  const std::string protobuf = ProtobufSerializer::kContentType;
+  const auto protobuf_range =
+      std::string{"application/vnd.google.protobuf;"} +
+      "proto=io.prometheus.client.MetricFamily;encoding=delimited";
+
+  auto response = Get("/metrics");
+  EXPECT_EQ(200, response.status_code);
+  EXPECT_EQ("text/plain", response.headers["Content-Type"]);
+  EXPECT_THAT(response.body, HasSubstr("# TYPE test_counter counter\n"));
+
+  response = Get("/metrics", {"Accept: " + protobuf_range});
+  EXPECT_EQ(protobuf, response.headers["Content-Type"]);
+  EXPECT_THAT(response.body, HasSubstr("test_counter"));
+  EXPECT_THAT(response.body, Not(HasSubstr("# TYPE")));
+
+  // The media range needs the parameters of the delimited format
+  EXPECT_EQ("text/plain", Negotiate("application/vnd.google.protobuf"));
+  EXPECT_EQ(protobuf, Negotiate("text/plain;q=0.5, " + protobuf_range));
+  EXPECT_EQ("text/plain", Negotiate(protobuf_range + ";q=0.5, text/plain"));
+  EXPECT_EQ("text/plain", Negotiate(protobuf_range + ";q=0, */*;q=0.1"));
+  EXPECT_EQ("text/plain", Negotiate("application/json"));
+}
+
+TEST_F(ExposerScrapeTest, negotiateOpenMetrics) {
+  auto& histogram = BuildHistogram()
+                        .Name("test_histogram")
+                        .Help("Test histogram")
+                        .Register(*registry_)
+                        .Add({}, Histogram::BucketBoundaries{1});
+  histogram.Observe(0.5);
+  counter_.Increment();
+
+  const auto response =
+      Get("/metrics", {"Accept: application/openmetrics-text;version=1.0.0, "
+                       "text/plain;q=0.5"});
+
+  EXPECT_EQ(OpenMetricsSerializer::kContentType,
+            response.headers.at("Content-Type"));
+  const auto& body = response.body;
+  EXPECT_THAT(body, HasSubstr("# TYPE test_counter counter\n"));
+  EXPECT_THAT(body, HasSubstr("\ntest_counter_total 1\n"));
+  EXPECT_THAT(body, HasSubstr("\ntest_counter_created "));
+  EXPECT_THAT(body, HasSubstr("\ntest_histogram_bucket{le=\"1.0\"} 1\n"));
+  EXPECT_THAT(body, HasSubstr("\ntest_histogram_created "));
+  // Only the histogram as a whole has a created timestamp
+  EXPECT_THAT(body, Not(HasSubstr("test_histogram_bucket_created")));
+  EXPECT_THAT(body, Not(HasSubstr("test_histogram_sum_created")));
+  EXPECT_THAT(body, EndsWith("# EOF\n"));
+}
+
+TEST_F(ExposerScrapeTest, streamChunkedBody) {
+  const auto response = Get("/metrics");
+
+  EXPECT_EQ("chunked", response.headers.at("Transfer-Encoding"));
+  EXPECT_FALSE(response.HasHeader("Content-Length"));
+  EXPECT_FALSE(response.HasHeader("Content-Encoding"));
+  EXPECT_TRUE(response.complete);
+  EXPECT_THAT(response.body, HasSubstr("\ntest_counter 0\n"));
+}
+
+TEST_F(ExposerScrapeTest, sendContentLengthToHttp10) {
+  const auto response = Get("/metrics", {}, "HTTP/1.0");
+
+  EXPECT_EQ(200, response.status_code);
+  EXPECT_FALSE(response.HasHeader("Transfer-Encoding"));
+  EXPECT_EQ(std::to_string(response.body.size()),
+            response.headers.at("Content-Length"));
+  EXPECT_TRUE(response.complete);
+  EXPECT_THAT(response.body, HasSubstr("\ntest_counter 0\n"));
+}
+
+#ifdef HAVE_ZLIB
+TEST_F(ExposerScrapeTest, streamGZipBody) {
+  const auto response = Get("/metrics", {"Accept-Encoding: gzip"});
+
+  EXPECT_EQ("gzip", response.headers.at("Content-Encoding"));
+  EXPECT_EQ("chunked", response.headers.at("Transfer-Encoding"));
+  EXPECT_TRUE(response.complete);
+  EXPECT_THAT(GUnzip(response.body), HasSubstr("\ntest_counter 0\n"));
+}
+
+TEST_F(ExposerScrapeTest, configureCompressionLevel) {
+  auto& family = BuildCounter().Name("test_requests").Register(*registry_);
+  for (int i = 0; i < 100; ++i) {
+    family.Add({{"path", "/path/" + std::to_string(i)}});
+  }
+  const auto plain = Get("/metrics").body;
+
+  // The deflate state is reused, so every scrape has to be complete gzip
+  exposer_.SetCompression(9);
+  for (int i = 0; i < 3; ++i) {
+    const auto compressed = Get("/metrics", {"Accept-Encoding: gzip"}).body;
+    EXPECT_LT(compressed.size(), plain.size() / 4);
+    EXPECT_THAT(GUnzip(compressed), HasSubstr("test_requests{path=\"/path/9"));
+  }
+
+  exposer_.SetCompression(0);
+  const auto stored = Get("/metrics", {"Accept-Encoding: gzip"}).body;
+  EXPECT_GT(stored.size(), plain.size());
+  EXPECT_THAT(GUnzip(stored), HasSubstr("test_requests{path=\"/path/9"));
+}
+#endif
+
+class FailingCollectable : public Collectable {
+ public:
+  std::vector<MetricFamily> Collect() const override {
+    throw std::runtime_error{"collection failed"};
+  }
+};
+
+TEST_F(ExposerScrapeTest, abortScrapeOfFailingCollectable) {
+  auto failing = std::make_shared<FailingCollectable>();
+  exposer_.RegisterCollectable(failing);
+
+  // The status was sent before the collectable failed
+  auto response = Get("/metrics");
+  EXPECT_EQ(200, response.status_code);
+  EXPECT_FALSE(response.complete);
+
+  response = Get("/metrics", {}, "HTTP/1.0");
+  EXPECT_EQ(500, response.status_code);
+
+  exposer_.RemoveCollectable(failing);
+  EXPECT_TRUE(Get("/metrics").complete);
+}
+
+TEST_F(ExposerScrapeTest, serveCachedScrapes) {
+  exposer_.SetCacheTtl(std::chrono::hours{1});
+  const auto first = Get("/metrics").body;
+  EXPECT_THAT(first, HasSubstr("\ntest_counter 0\n"));
+
+  counter_.Increment();
+  EXPECT_EQ(first, Get("/metrics").body);
+#ifdef HAVE_ZLIB
+  // Compressed from the cached plain body
+  const auto compressed = Get("/metrics", {"Accept-Encoding: gzip"});
+  EXPECT_EQ("gzip", compressed.headers.at("Content-Encoding"));
+  EXPECT_EQ(first, GUnzip(compressed.body));
+  EXPECT_EQ(compressed.body,
+            Get("/metrics", {"Accept-Encoding: gzip"}).body);
+#endif
+
+  exposer_.SetCacheTtl(std::chrono::milliseconds{0});
+  const auto fresh = Get("/metrics").body;
+  EXPECT_THAT(fresh, HasSubstr("\ntest_counter 1\n"));
+  EXPECT_THAT(fresh,
+              HasSubstr("exposer_cached_scrapes_total{result=\"miss\"} 1\n"));
+#ifdef HAVE_ZLIB
+  EXPECT_THAT(fresh,
+              HasSubstr("exposer_cached_scrapes_total{result=\"hit\"} 3\n"));
+  // Both compressed scrapes were served from one compression
+  EXPECT_THAT(fresh, HasSubstr("exposer_scrape_phase_duration_seconds_count{"
+                               "phase=\"compress\"} 1\n"));
+#else
+  EXPECT_THAT(fresh,
+              HasSubstr("exposer_cached_scrapes_total{result=\"hit\"} 1\n"));
+#endif
+}
+
+TEST_F(ExposerScrapeTest, servePreRenderedSnapshots) {
+  // Nothing is rendered again within the test unless a format is new
+  exposer_.SetPreRenderInterval(std::chrono::hours{1});
+
+  // The first scrape of a format is rendered while waiting and asks for
+  // snapshots of it, which are sent with their length
+  auto response = Get("/metrics");
+  EXPECT_EQ("chunked", response.headers.at("Transfer-Encoding"));
+  for (int i = 0; i < 500 && !response.HasHeader("Content-Length"); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    response = Get("/metrics");
+  }
+  ASSERT_TRUE(response.HasHeader("Content-Length"));
+  EXPECT_THAT(response.body, HasSubstr("\ntest_counter 0\n"));
+  EXPECT_THAT(response.body, HasSubstr("\nexposer_snapshot_age_seconds "));
+
+  // Changes show up with the next snapshot only
+  counter_.Increment();
+  response = Get("/metrics");
+  EXPECT_TRUE(response.HasHeader("Content-Length"));
+  EXPECT_THAT(response.body, HasSubstr("\ntest_counter 0\n"));
+
+  // Changing the interval drops the snapshots, which are then rendered
+  // periodically
+  exposer_.SetPreRenderInterval(std::chrono::milliseconds{10});
+  EXPECT_THAT(Get("/metrics").body, HasSubstr("\ntest_counter 1\n"));
+  counter_.Increment();
+  for (int i = 0; i < 500 && !(response.HasHeader("Content-Length") &&
+                               response.body.find("\ntest_counter 2\n") !=
+                                   std::string::npos);
+       ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    response = Get("/metrics");
+  }
+  EXPECT_TRUE(response.HasHeader("Content-Length"));
+  EXPECT_THAT(response.body, HasSubstr("\ntest_counter 2\n"));
+
+  exposer_.SetPreRenderInterval(std::chrono::milliseconds{0});
+  EXPECT_EQ("chunked", Get("/metrics").headers.at("Transfer-Encoding"));
+}
+
+TEST_F(ExposerScrapeTest, serveAdditionalUris) {
+  auto fast = std::make_shared<Registry>();
+  BuildCounter().Name("fast_counter").Register(*fast).Add({});
+  exposer_.RegisterCollectable(fast, "/metrics/fast");
+
+  EXPECT_EQ(404, Get("/metrics/slow").status_code);
+  const auto response = Get("/metrics/fast");
+  EXPECT_EQ(200, response.status_code);
+  EXPECT_THAT(response.body, HasSubstr("\nfast_counter 0\n"));
+  EXPECT_THAT(response.body, Not(HasSubstr("test_counter")));
+  EXPECT_THAT(response.body, Not(HasSubstr("exposer_scrapes_total")));
+
+  // Only the statistics of additional URIs are labeled
+  const auto body = Get("/metrics").body;
+  EXPECT_THAT(body, Not(HasSubstr("fast_counter")));
+  EXPECT_THAT(body, HasSubstr("\nexposer_scrapes_total 0\n"));
+  EXPECT_THAT(body,
+              HasSubstr("\nexposer_scrapes_total{uri=\"/metrics/fast\"} "));
+
+  exposer_.RemoveCollectable(fast, "/metrics/fast");
+  EXPECT_THAT(Get("/metrics/fast").body, Not(HasSubstr("fast_counter")));
+}
+
+TEST_F(ExposerScrapeTest, filterFamiliesByName) {
+  BuildCounter().Name("test_requests").Register(*registry_).Add({});
+  BuildCounter().Name("other_requests").Register(*registry_).Add({});
+
+  auto body = Get("/metrics?name[]=test_counter").body;
+  EXPECT_THAT(body, HasSubstr("\ntest_counter 0\n"));
+  EXPECT_THAT(body, Not(HasSubstr("test_requests")));
+  EXPECT_THAT(body, Not(HasSubstr("other_requests")));
+  EXPECT_THAT(body, Not(HasSubstr("exposer_")));
+
+  // Percent-encoded brackets and several parameters
+  body = Get("/metrics?name%5B%5D=test_requests&name[]=other_requests").body;
+  EXPECT_THAT(body, Not(HasSubstr("test_counter")));
+  EXPECT_THAT(body, HasSubstr("\ntest_requests 0\n"));
+  EXPECT_THAT(body, HasSubstr("\nother_requests 0\n"));
+
+  // A trailing '*' selects a prefix
+  body = Get("/metrics?name[]=test_*").body;
+  EXPECT_THAT(body, HasSubstr("\ntest_counter 0\n"));
+  EXPECT_THAT(body, HasSubstr("\ntest_requests 0\n"));
+  EXPECT_THAT(body, Not(HasSubstr("other_requests")));
+
+  body = Get("/metrics?name[]=missing").body;
+  EXPECT_THAT(body, Not(HasSubstr("test_")));
+
+  // Names which do not fit the buffer are rejected instead of ignored
+  const auto response =
+      Get("/metrics?name[]=" + std::string(2000, 'a') + "&name[]=test_counter");
+  EXPECT_EQ(400, response.status_code);
+  EXPECT_TRUE(response.body.empty());
+}
+
+// Blocks the scrape collecting it until it is released
+class BlockingCollectable : public Collectable {
+ public:
+  std::vector<MetricFamily> Collect() const override {
+    entered.set_value();
+    released.wait();
+    return {};
+  }
+
+  mutable std::promise<void> entered;
+  std::shared_future<void> released;
+};
+
+TEST_F(ExposerScrapeTest, changeCollectablesWhileScraping) {
+  auto blocking = std::make_shared<BlockingCollectable>();
+  std::promise<void> release;
+  blocking->released = release.get_future().share();
+  auto entered = blocking->entered.get_future();
+  exposer_.RegisterCollectable(blocking);
+
+  std::string blocked;
+  std::thread scrape{[this, &blocked] { blocked = Get("/metrics").body; }};
+  entered.wait();
+
+  // Changing the list does not wait for the running scrape
+  auto other = std::make_shared<Registry>();
+  BuildCounter().Name("other_counter").Register(*other).Add({});
+  exposer_.RegisterCollectable(other);
+  exposer_.RemoveCollectable(blocking);
+  release.set_value();
+  scrape.join();
+
+  // The running scrape kept the list it started with
+  EXPECT_THAT(blocked, HasSubstr("\ntest_counter 0\n"));
+  EXPECT_THAT(blocked, Not(HasSubstr("other_counter")));
+
+  EXPECT_THAT(Get("/metrics").body, HasSubstr("\nother_counter 0\n"));
+  exposer_.RemoveCollectable(other);
+  EXPECT_THAT(Get("/metrics").body, Not(HasSubstr("other_counter")));
+
+  // Destroyed collectables are skipped and can still be removed
+  auto destroyed = std::make_shared<Registry>();
+  BuildCounter().Name("destroyed_counter").Register(*destroyed).Add({});
+  exposer_.RegisterCollectable(destroyed);
+  const std::weak_ptr<Collectable> expired = destroyed;
+  destroyed.reset();
+  EXPECT_THAT(Get("/metrics").body, Not(HasSubstr("destroyed_counter")));
+  exposer_.RemoveCollectable(expired);
+  EXPECT_TRUE(Get("/metrics").complete);
+}
+
+// Returns the value of the sample with the given name and labels
+double GetSample(const std::string& body, const std::string& sample) {
+  const auto line = "\n" + sample + " ";
+  const auto pos = body.find(line);
+  if (pos == std::string::npos) {
+    throw std::runtime_error{"missing sample " + sample};
+  }
+  return std::stod(body.substr(pos + line.size()));
+}
+
+// Takes a while to collect, or until released if a latch is set, and counts
+// how often it was collected
+class SlowCollectable : public Collectable {
+ public:
+  std::vector<MetricFamily> Collect() const override {
+    ++collections;
+    if (released.valid()) {
+      released.wait();
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds{200});
+    }
+    return {};
+  }
+
+  mutable std::atomic<int> collections{0};
+  std::shared_future<void> released;
+};
+
+TEST_F(ExposerScrapeTest, coalesceConcurrentScrapes) {
+  // Served on its own URI, so that the statistics on the default URI can be
+  // scraped while it is blocked
+  auto slow = std::make_shared<SlowCollectable>();
+  std::promise<void> release;
+  slow->released = release.get_future().share();
+  exposer_.RegisterCollectable(slow, "/metrics/slow");
+  exposer_.SetCacheTtl(std::chrono::milliseconds{1});
+
+  std::string first;
+  std::thread first_scrape{
+      [this, &first] { first = Get("/metrics/slow").body; }};
+  for (int i = 0; i < 500 && slow->collections == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+  std::string second;
+  std::thread second_scrape{
+      [this, &second] { second = Get("/metrics/slow").body; }};
+
+  // The second scrape waits for the first one to render its response
+  const auto waiting =
+      std::string{"exposer_coalescing_scrapes{uri=\"/metrics/slow\"}"};
+  auto body = Get("/metrics").body;
+  for (int i = 0; i < 500 && GetSample(body, waiting) < 1; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    body = Get("/metrics").body;
+  }
+  EXPECT_EQ(1, GetSample(body, waiting));
+  release.set_value();
+  first_scrape.join();
+  second_scrape.join();
+
+  EXPECT_EQ(1, slow->collections);
+  EXPECT_EQ(first, second);
+
+  // The statistics are recorded after the responses have been sent
+  const auto coalesced =
+      std::string{"exposer_cached_scrapes_total{result=\"coalesced\","
+                  "uri=\"/metrics/slow\"}"};
+  const auto missed = std::string{
+      "exposer_cached_scrapes_total{result=\"miss\",uri=\"/metrics/slow\"}"};
+  exposer_.SetCacheTtl(std::chrono::milliseconds{0});
+  body = Get("/metrics").body;
+  for (int i = 0; i < 500 && (GetSample(body, coalesced) < 1 ||
+                              GetSample(body, missed) < 1);
+       ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    body = Get("/metrics").body;
+  }
+  EXPECT_EQ(1, GetSample(body, coalesced));
+  EXPECT_EQ(1, GetSample(body, missed));
+  EXPECT_EQ(0, GetSample(body, waiting));
+}
+
+TEST_F(ExposerScrapeTest, instrumentScrapePhases) {
+  auto slow = std::make_shared<SlowCollectable>();
+  exposer_.RegisterCollectable(slow);
+  Get("/metrics");
+  const auto body = Get("/metrics").body;
+
+  // The streamed collection is accounted to collecting only
+  EXPECT_EQ(1, GetSample(body, "exposer_scrape_phase_duration_seconds_count{"
+                               "phase=\"collect\"}"));
+  EXPECT_GE(GetSample(body, "exposer_scrape_phase_duration_seconds_sum{"
+                            "phase=\"collect\"}"),
+            0.2);
+  EXPECT_LT(GetSample(body, "exposer_scrape_phase_duration_seconds_sum{"
+                            "phase=\"serialize\"}"),
+            0.2);
+  EXPECT_GE(GetSample(body,
+                      "exposer_collectable_duration_seconds{collectable=\"2\"}"),
+            0.2);
+  EXPECT_LT(GetSample(body,
+                      "exposer_collectable_duration_seconds{collectable=\"1\"}"),
+            0.2);
+  EXPECT_GT(GetSample(body, "exposer_scraped_families"), 1);
+  EXPECT_GT(GetSample(body, "exposer_scraped_series"), 1);
+  EXPECT_EQ(1, GetSample(body, "exposer_scrapes_total"));
+
+  // Positions refer to other collectables once the list changed
+  exposer_.RemoveCollectable(slow);
+  EXPECT_THAT(Get("/metrics").body,
+              Not(HasSubstr("exposer_collectable_duration_seconds{")));
+  EXPECT_THAT(Get("/metrics").body,
+              Not(HasSubstr("exposer_collectable_duration_seconds{"
+                            "collectable=\"2\"}")));
+}
+
 }  // namespace
 }  // namespace prometheus
@@ -0,0 +1,152 @@
+#include "http_client.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "ws2_32.lib")
+#endif
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <cstdlib>
+#include <stdexcept>
+
+namespace prometheus {
+
+namespace {
+
+#ifdef _WIN32
+// Winsock is initialized by the server of the exposer
+using Socket = SOCKET;
+void CloseSocket(Socket socket) { closesocket(socket); }
+#else
+using Socket = int;
+void CloseSocket(Socket socket) { close(socket); }
+#endif
+
+std::string ReadAll(Socket connection) {
+  std::string data;
+  char buffer[4096];
+  for (;;) {
+    const auto size = ::recv(connection, buffer, sizeof(buffer), 0);
+    if (size <= 0) {
+      return data;
+    }
+    data.append(buffer, static_cast<std::size_t>(size));
+  }
+}
+
+// Removes the chunked transfer encoding, returns false if the last chunk is
+// missing
+bool DecodeChunks(const std::string& data, std::string& body) {
+  std::size_t position = 0;
+  for (;;) {
+    const auto line_end = data.find("\r\n", position);
+    if (line_end == std::string::npos) {
+      return false;
+    }
+    const auto size = std::strtoul(data.c_str() + position, nullptr, 16);
+    position = line_end + 2;
+    if (size == 0) {
+      return data.compare(position, std::string::npos, "\r\n") == 0;
+    }
+    if (data.size() < position + size + 2) {
+      return false;
+    }
+    body.append(data, position, size);
+    position += size + 2;
+  }
+}
+
+}  // namespace
+
+HttpResponse HttpGet(int port, const std::string& target,
+                     const std::vector<std::string>& headers,
+                     const std::string& version) {
+  const auto connection = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(static_cast<unsigned short>(port));
+  if (::connect(connection, reinterpret_cast<sockaddr*>(&address),
+                sizeof(address)) != 0) {
+    CloseSocket(connection);
+    throw std::runtime_error("cannot connect to port " + std::to_string(port));
+  }
+
+  auto request = "GET " + target + " " + version +
+                 "\r\nHost: 127.0.0.1\r\nConnection: close\r\n";
+  for (auto& header : headers) {
+    request += header + "\r\n";
+  }
+  request += "\r\n";
+  ::send(connection, request.data(), static_cast<int>(request.size()), 0);
+  const auto data = ReadAll(connection);
+  CloseSocket(connection);
+
+  HttpResponse response;
+  const auto header_end = data.find("\r\n\r\n");
+  if (header_end == std::string::npos) {
+    return response;
+  }
+
+  auto line_end = data.find("\r\n");
+  const auto status_begin = data.find(' ');
+  response.status_code = std::atoi(data.c_str() + status_begin + 1);
+  while (line_end < header_end) {
+    const auto begin = line_end + 2;
+    line_end = data.find("\r\n", begin);
+    const auto colon = data.find(':', begin);
+    auto value_begin = data.find_first_not_of(' ', colon + 1);
+    response.headers[data.substr(begin, colon - begin)] =
+        data.substr(value_begin, line_end - value_begin);
+  }
+
+  const auto body = data.substr(header_end + 4);
+  const auto encoding = response.headers.find("Transfer-Encoding");
+  const auto length = response.headers.find("Content-Length");
+  if (encoding != response.headers.end() && encoding->second == "chunked") {
+    response.complete = DecodeChunks(body, response.body);
+  } else {
+    response.body = body;
+    response.complete =
+        length == response.headers.end() ||
+        std::strtoul(length->second.c_str(), nullptr, 10) == body.size();
+  }
+  return response;
+}
+
+#ifdef HAVE_ZLIB
+std::string GUnzip(const std::string& data) {
+  z_stream stream{};
+  if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+    return {};
+  }
+
+  std::string result;
+  char buffer[16 * 1024];
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  int ret;
+  do {
+    stream.next_out = reinterpret_cast<Bytef*>(buffer);
+    stream.avail_out = sizeof(buffer);
+    ret = inflate(&stream, Z_NO_FLUSH);
+    result.append(buffer, sizeof(buffer) - stream.avail_out);
+  } while (ret == Z_OK);
+  inflateEnd(&stream);
+  return ret == Z_STREAM_END ? result : std::string{};
+}
+#endif
+
+}  // namespace prometheus
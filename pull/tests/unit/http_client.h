@@ -0,0 +1,39 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace prometheus {
+
+/// \brief A response received by HttpGet().
+struct HttpResponse {
+  int status_code = 0;
+  std::map<std::string, std::string> headers;
+  /// \brief The body with the chunked transfer encoding removed.
+  std::string body;
+  /// \brief Whether the body ended with the last chunk or had the length of
+  /// the Content-Length header. False if the connection was closed before.
+  bool complete = false;
+
+  bool HasHeader(const std::string& name) const {
+    return headers.find(name) != headers.end();
+  }
+};
+
+/// \brief Sends a GET request to the loopback interface and reads the
+/// response until the server closes the connection.
+///
+/// \param headers Header lines added to the request, e.g., "Accept: */*".
+/// \param version The HTTP version of the request.
+HttpResponse HttpGet(int port, const std::string& target,
+                     const std::vector<std::string>& headers = {},
+                     const std::string& version = "HTTP/1.1");
+
+#ifdef HAVE_ZLIB
+/// \brief Returns the decompressed gzip data, or an empty string if the data
+/// is not complete and valid gzip.
+std::string GUnzip(const std::string& data);
+#endif
+
+}  // namespace prometheus
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace prometheus {
+namespace detail {
+
+enum class HttpMethod {
+  Post,
+  Put,
+  Delete,
+};
+
+}  // namespace detail
+}  // namespace prometheus
@@ -1,17 +1,31 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <future>
 #include <iosfwd>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "prometheus/detail/http_method.h"
 #include "prometheus/detail/push_export.h"
 #include "prometheus/registry.h"
 
 namespace prometheus {
 
+namespace detail {
+class CurlWrapper;
+class DeltaTracker;
+class PeriodicRunner;
+class Spool;
+}  // namespace detail
+
 class PROMETHEUS_CPP_PUSH_EXPORT Gateway {
  public:
   using Labels = std::map<std::string, std::string>;
@@ -42,28 +56,117 @@ class PROMETHEUS_CPP_PUSH_EXPORT Gateway {
   // Delete metrics from the given pushgateway.
   std::future<int> AsyncDelete();
 
+  // Push metrics on a background thread every interval.
+  //
+  // Each push is delayed by a random offset of up to jitter, so that many
+  // processes started at the same time do not push at the same instant.
+  // Pushes are sent like by Push(), one at a time, and the pushes due while
+  // the previous one is still in flight are skipped. Replaces a periodic
+  // push started before without pushing one last time.
+  void StartPeriodicPush(std::chrono::milliseconds interval,
+                         std::chrono::milliseconds jitter = {});
+
+  // Stop the periodic push after pushing one last time. Called on
+  // destruction.
+  void StopPeriodicPush();
+
+  // Compress pushed metrics with gzip. Has no effect if the library was
+  // built without compression.
+  //
+  // The level is the zlib compression level from 0 (no compression) to 9
+  // (best compression), -1 selects the zlib default of 6.
+  void EnableCompression(int level = -1);
+
+  // Push uncompressed metrics, which is the default.
+  void DisableCompression();
+
+  // Total size of the metrics pushed so far before compression.
+  std::uint64_t GetSerializedBytes() const;
+
+  // Total size of the request bodies sent to the pushgateway so far,
+  // including the framing of chunked transfer encoding.
+  std::uint64_t GetSentBytes() const;
+
+  // Retry Push() and PushAdd() if the pushgateway is unreachable or answers
+  // with a server error. The first retry waits initial_backoff, every
+  // following one twice as long as the one before, up to max_backoff.
+  void SetRetryPolicy(
+      int max_retries, std::chrono::milliseconds initial_backoff,
+      std::chrono::milliseconds max_backoff = std::chrono::seconds{30});
+
+  // Keep what Push() and PushAdd() failed to send after all retries in a
+  // file in the given directory, which has to exist. The oldest requests are
+  // dropped to keep the file within max_bytes.
+  //
+  // Kept requests are sent in order before the following push, also by a
+  // Gateway for the same pushgateway, job and labels in another process
+  // after a restart. Gateways with other labels keep their own file.
+  void EnableSpooling(const std::string& directory,
+                      std::size_t max_bytes = 16 * 1024 * 1024);
+
+  // Let PushAdd() send only the metric families which changed since its last
+  // successful push. They are sent as by Push(), so the pushgateway keeps the
+  // unchanged families. A family is always sent with all of its series.
+  //
+  // Every full_push_interval all families are sent again, which also removes
+  // families no longer registered from the pushgateway. AsyncPushAdd()
+  // always sends all families.
+  void EnableDeltaPush(std::chrono::milliseconds full_push_interval);
+
+  // Let PushAdd() send all families, which is the default.
+  void DisableDeltaPush();
+
  private:
+  std::string jobname_;
   std::string jobUri_;
   std::string labels_;
-  std::string auth_;
+  std::unique_ptr<detail::CurlWrapper> curlWrapper_;
+  std::atomic<bool> compression_enabled_{false};
+  std::atomic<int> compression_level_{-1};
+  std::atomic<std::uint64_t> serialized_bytes_{0};
 
   using CollectableEntry = std::pair<std::weak_ptr<Collectable>, std::string>;
+
+  struct RetryPolicy {
+    int max_retries = 0;
+    std::chrono::milliseconds initial_backoff{0};
+    std::chrono::milliseconds max_backoff{0};
+  };
+
+  // Guards the collectables and the settings. It is only held to copy them,
+  // never while sending.
+  std::mutex mutex_;
   std::vector<CollectableEntry> collectables_;
+  RetryPolicy retry_policy_;
+  // The spool and the delta tracker are only used while push_mutex_ is held
+  std::shared_ptr<detail::Spool> spool_;
+  std::shared_ptr<detail::DeltaTracker> delta_;
+  std::chrono::milliseconds full_push_interval_{0};
+  std::chrono::steady_clock::time_point next_full_push_;
+
+  // Held by Push() and PushAdd() to send one push at a time, in order
+  std::mutex push_mutex_;
+
+  std::unique_ptr<detail::PeriodicRunner> periodic_push_;
 
   std::string getUri(const CollectableEntry& collectable) const;
 
-  enum class HttpMethod {
-    Post,
-    Put,
-    Delete,
-  };
+  // Collectables with the same grouping key are pushed in one request
+  using CollectableGroup =
+      std::pair<std::string, std::vector<std::shared_ptr<Collectable>>>;
+
+  // Returns the registered collectables still alive, grouped by the uri they
+  // are pushed to in the order of registration. The mutex must be held.
+  std::vector<CollectableGroup> getGroups() const;
+
+  int push(detail::HttpMethod method);
 
-  int performHttpRequest(HttpMethod method, const std::string& uri,
-                         const std::string& body) const;
+  std::future<int> async_push(detail::HttpMethod method);
 
-  int push(HttpMethod method);
+  static int performWithRetry(const RetryPolicy& policy,
+                              const std::function<int()>& request);
 
-  std::future<int> async_push(HttpMethod method);
+  int replaySpool(detail::Spool& spool, const RetryPolicy& policy);
 };
 
 }  // namespace prometheus
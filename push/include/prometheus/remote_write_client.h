@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "prometheus/collectable.h"
+#include "prometheus/detail/push_export.h"
+
+namespace prometheus {
+
+namespace detail {
+class CurlWrapper;
+class PeriodicRunner;
+}  // namespace detail
+
+// Writes metrics directly to a receiver of the Prometheus remote write
+// protocol, e.g., Prometheus, Cortex or Thanos, without a pushgateway.
+//
+// Every write collects the registered collectables and queues one sample
+// per time series. Queued samples are sent in batches as snappy compressed
+// protocol buffer WriteRequests. Samples the receiver could not take because
+// it is unreachable or failed stay queued for the next write. If the queue
+// is full, the oldest samples are dropped.
+class PROMETHEUS_CPP_PUSH_EXPORT RemoteWriteClient {
+ public:
+  // The url is the endpoint of the receiver, e.g.,
+  // "http://localhost:9090/api/v1/write".
+  explicit RemoteWriteClient(const std::string& url,
+                             const std::string& username = {},
+                             const std::string& password = {});
+  ~RemoteWriteClient();
+
+  RemoteWriteClient(const RemoteWriteClient&) = delete;
+  RemoteWriteClient& operator=(const RemoteWriteClient&) = delete;
+
+  void RegisterCollectable(const std::weak_ptr<Collectable>& collectable);
+
+  // Maximum number of samples sent in one request, 500 by default.
+  void SetMaxSamplesPerSend(std::size_t max_samples);
+
+  // Maximum number of samples waiting to be sent, 100000 by default.
+  void SetMaxQueuedSamples(std::size_t max_samples);
+
+  // Collect the metrics and send all queued samples.
+  //
+  // Returns the HTTP status code of the last request, 200 if there was
+  // nothing to send, or the negated curl error code.
+  int Write();
+
+  // Write on a background thread every interval, starting right away.
+  // Replaces a periodic write started before after it wrote one last time.
+  void Start(std::chrono::milliseconds interval);
+
+  // Stop the periodic write after writing one last time. Called on
+  // destruction.
+  void Stop();
+
+  // Number of samples accepted by the receiver so far.
+  std::uint64_t GetSentSamples() const;
+
+  // Number of samples dropped so far because the queue was full or the
+  // receiver rejected them.
+  std::uint64_t GetDroppedSamples() const;
+
+  // Number of samples waiting to be sent.
+  std::size_t GetQueuedSamples() const;
+
+ private:
+  int send();
+
+  // Drops the oldest samples to fit the queue into its maximum size. The
+  // mutex must be held.
+  void trimQueue();
+
+  const std::string url_;
+  std::unique_ptr<detail::CurlWrapper> curlWrapper_;
+
+  // Guards the collectables, the settings and the queue. It is only held to
+  // copy them, never while sending.
+  mutable std::mutex mutex_;
+  std::vector<std::weak_ptr<Collectable>> collectables_;
+  std::size_t max_samples_per_send_ = 500;
+  std::size_t max_queued_samples_ = 100000;
+  std::deque<std::string> queue_;
+  std::atomic<std::uint64_t> sent_samples_{0};
+  std::atomic<std::uint64_t> dropped_samples_{0};
+
+  // Held by Write() to send one write at a time, so that the samples of each
+  // series arrive in order
+  std::mutex write_mutex_;
+
+  std::unique_ptr<detail::PeriodicRunner> periodic_write_;
+};
+
+}  // namespace prometheus
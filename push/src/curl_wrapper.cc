@@ -0,0 +1,462 @@
+#include "curl_wrapper.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "prometheus/detail/future_std.h"
+
+namespace prometheus {
+namespace detail {
+
+static const char CONTENT_TYPE[] =
+    "Content-Type: text/plain; version=0.0.4; charset=utf-8";
+static const char CONTENT_ENCODING_GZIP[] = "Content-Encoding: gzip";
+static const char TRANSFER_ENCODING_CHUNKED[] = "Transfer-Encoding: chunked";
+// Sends the body right away instead of waiting for 100 Continue
+static const char NO_EXPECT[] = "Expect:";
+
+namespace {
+
+/// \brief Passes the data written to it to a transfer of a curl multi handle
+/// as request body.
+///
+/// Whenever the buffer is full the transfer is run on the calling thread
+/// until curl has read all of it. The transfer is paused while waiting for
+/// more data.
+class UploadBuffer : public OutputBuffer {
+ public:
+  UploadBuffer(CURLM* multi, CURL* curl, std::size_t chunk_size = 64 * 1024)
+      : multi_{multi},
+        curl_{curl},
+        storage_(chunk_size),
+        pending_{nullptr},
+        pending_size_{0},
+        size_{0},
+        end_of_body_{false},
+        aborted_{false},
+        paused_{false},
+        done_{false},
+        result_{CURLE_OK} {
+    curl_easy_setopt(curl_, CURLOPT_READFUNCTION, &UploadBuffer::Read);
+    curl_easy_setopt(curl_, CURLOPT_READDATA, this);
+    SetWindow(storage_.data(), storage_.data() + storage_.size());
+  }
+
+  /// \brief Sends the remaining data and completes the transfer.
+  ///
+  /// \return The result of the transfer.
+  CURLcode Finish() {
+    Send();
+    end_of_body_ = true;
+    Run();
+    return result_;
+  }
+
+  /// \brief Aborts the transfer without sending the remaining data.
+  ///
+  /// \return The result of the transfer.
+  CURLcode Abort() {
+    aborted_ = true;
+    end_of_body_ = true;
+    Run();
+    return result_;
+  }
+
+  /// \brief Returns the number of bytes written so far.
+  std::uint64_t GetSize() const {
+    return size_ + static_cast<std::size_t>(GetNext() - storage_.data());
+  }
+
+ protected:
+  void Grow(std::size_t min_size, std::size_t) override {
+    Send();
+    if (storage_.size() < min_size) {
+      storage_.resize(min_size);
+      SetWindow(storage_.data(), storage_.data() + storage_.size());
+    }
+  }
+
+ private:
+  static std::size_t Read(char* buffer, std::size_t size, std::size_t nitems,
+                          void* userdata) {
+    auto self = static_cast<UploadBuffer*>(userdata);
+    if (self->aborted_) {
+      return CURL_READFUNC_ABORT;
+    }
+    if (self->pending_size_ == 0) {
+      if (self->end_of_body_) {
+        return 0;
+      }
+      self->paused_ = true;
+      return CURL_READFUNC_PAUSE;
+    }
+
+    const auto count = std::min(size * nitems, self->pending_size_);
+    std::memcpy(buffer, self->pending_, count);
+    self->pending_ += count;
+    self->pending_size_ -= count;
+    return count;
+  }
+
+  void Send() {
+    pending_ = storage_.data();
+    pending_size_ = static_cast<std::size_t>(GetNext() - storage_.data());
+    size_ += pending_size_;
+    Run();
+    // Data is dropped if the transfer ended early, e.g., on an error
+    pending_size_ = 0;
+    SetWindow(storage_.data(), storage_.data() + storage_.size());
+  }
+
+  // Runs the transfer until all pending data is read or, at the end of the
+  // body, until the transfer is done
+  void Run() {
+    for (;;) {
+      if (done_ || (pending_size_ == 0 && !end_of_body_)) {
+        return;
+      }
+      if (paused_) {
+        paused_ = false;
+        curl_easy_pause(curl_, CURLPAUSE_CONT);
+      }
+
+      int running;
+      curl_multi_perform(multi_, &running);
+
+      int remaining;
+      while (auto message = curl_multi_info_read(multi_, &remaining)) {
+        if (message->msg == CURLMSG_DONE) {
+          done_ = true;
+          result_ = message->data.result;
+        }
+      }
+
+      if (!done_ && (pending_size_ > 0 || end_of_body_)) {
+        curl_multi_poll(multi_, nullptr, 0, 1000, nullptr);
+      }
+    }
+  }
+
+  CURLM* multi_;
+  CURL* curl_;
+  std::vector<char> storage_;
+  const char* pending_;
+  std::size_t pending_size_;
+  std::uint64_t size_;
+  bool end_of_body_;
+  bool aborted_;
+  bool paused_;
+  bool done_;
+  CURLcode result_;
+};
+
+}  // namespace
+
+struct CurlWrapper::Request {
+  HttpMethod method;
+  std::string uri;
+  // Only used by asynchronous requests, it must outlive the transfer because
+  // curl does not copy it
+  std::string body;
+  bool gzip;
+  std::function<void(int)> done;
+  CURL* curl;
+  curl_slist* header_chunk;
+};
+
+CurlWrapper::CurlWrapper(const std::string& username,
+                         const std::string& password,
+                         const std::size_t max_concurrent_requests)
+    : sent_bytes_{0},
+      max_concurrent_requests_{max_concurrent_requests > 0
+                                   ? max_concurrent_requests
+                                   : 1},
+      multi_{nullptr},
+      stopping_{false} {
+  /* In windows, this will init the winsock stuff */
+  curl_global_init(CURL_GLOBAL_ALL);
+
+  if (!username.empty()) {
+    auth_ = username + ":" + password;
+  }
+
+  share_ = curl_share_init();
+  if (share_) {
+    curl_share_setopt(share_, CURLSHOPT_LOCKFUNC, &CurlWrapper::LockShare);
+    curl_share_setopt(share_, CURLSHOPT_UNLOCKFUNC,
+                      &CurlWrapper::UnlockShare);
+    curl_share_setopt(share_, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+  }
+}
+
+CurlWrapper::~CurlWrapper() {
+  {
+    std::lock_guard<std::mutex> lock{queue_mutex_};
+    stopping_ = true;
+  }
+  if (event_loop_.joinable()) {
+    curl_multi_wakeup(multi_);
+    event_loop_.join();
+  }
+  if (multi_) {
+    curl_multi_cleanup(multi_);
+  }
+
+  for (auto curl : handles_) {
+    curl_easy_cleanup(curl);
+  }
+  if (share_) {
+    curl_share_cleanup(share_);
+  }
+  curl_global_cleanup();
+}
+
+void CurlWrapper::LockShare(CURL*, curl_lock_data data, curl_lock_access,
+                            void* self) {
+  static_cast<CurlWrapper*>(self)->share_mutexes_[data].lock();
+}
+
+void CurlWrapper::UnlockShare(CURL*, curl_lock_data data, void* self) {
+  static_cast<CurlWrapper*>(self)->share_mutexes_[data].unlock();
+}
+
+CURL* CurlWrapper::AcquireHandle() {
+  {
+    std::lock_guard<std::mutex> lock{handles_mutex_};
+    if (!handles_.empty()) {
+      auto curl = handles_.back();
+      handles_.pop_back();
+      // Resets the options, but keeps the connections and caches
+      curl_easy_reset(curl);
+      return curl;
+    }
+  }
+  return curl_easy_init();
+}
+
+void CurlWrapper::ReleaseHandle(CURL* curl) {
+  std::lock_guard<std::mutex> lock{handles_mutex_};
+  handles_.push_back(curl);
+}
+
+bool CurlWrapper::Prepare(Request& request, const std::string* body,
+                          const bool gzip,
+                          const std::vector<std::string>* headers) {
+  request.header_chunk = nullptr;
+  request.curl = AcquireHandle();
+  if (!request.curl) {
+    return false;
+  }
+  auto curl = request.curl;
+
+  curl_easy_setopt(curl, CURLOPT_URL, request.uri.c_str());
+  curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, &request);
+  if (share_) {
+    curl_easy_setopt(curl, CURLOPT_SHARE, share_);
+  }
+
+  if (!auth_.empty()) {
+    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+    curl_easy_setopt(curl, CURLOPT_USERPWD, auth_.c_str());
+  }
+
+  switch (request.method) {
+    case HttpMethod::Post:
+      curl_easy_setopt(curl, CURLOPT_HTTPGET, 0L);
+      curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
+      break;
+
+    case HttpMethod::Put:
+      curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
+      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
+      break;
+
+    case HttpMethod::Delete:
+      curl_easy_setopt(curl, CURLOPT_HTTPGET, 0L);
+      curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
+      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+      break;
+  }
+
+  if (headers) {
+    for (auto& header : *headers) {
+      request.header_chunk =
+          curl_slist_append(request.header_chunk, header.c_str());
+    }
+  } else if (!body || !body->empty()) {
+    request.header_chunk = curl_slist_append(nullptr, CONTENT_TYPE);
+    if (gzip) {
+      request.header_chunk =
+          curl_slist_append(request.header_chunk, CONTENT_ENCODING_GZIP);
+    }
+  }
+
+  if (body) {
+    if (!body->empty()) {
+      curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, body->size());
+      curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body->data());
+    }
+  } else {
+    request.header_chunk =
+        curl_slist_append(request.header_chunk, TRANSFER_ENCODING_CHUNKED);
+    request.header_chunk = curl_slist_append(request.header_chunk, NO_EXPECT);
+    curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L);
+    if (request.method == HttpMethod::Post) {
+      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "POST");
+    }
+  }
+
+  if (request.header_chunk) {
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, request.header_chunk);
+  }
+  return true;
+}
+
+int CurlWrapper::Finish(Request& request, CURLcode curl_error) {
+  long response_code;
+  curl_easy_getinfo(request.curl, CURLINFO_RESPONSE_CODE, &response_code);
+  curl_off_t sent_bytes;
+  if (curl_easy_getinfo(request.curl, CURLINFO_SIZE_UPLOAD_T, &sent_bytes) ==
+      CURLE_OK) {
+    sent_bytes_ += static_cast<std::uint64_t>(sent_bytes);
+  }
+
+  ReleaseHandle(request.curl);
+  curl_slist_free_all(request.header_chunk);
+
+  if (curl_error != CURLE_OK) {
+    return -curl_error;
+  }
+
+  return response_code;
+}
+
+int CurlWrapper::performHttpRequest(HttpMethod method, const std::string& uri,
+                                    const std::string& body, const bool gzip) {
+  auto request = Request{method, uri, {}, gzip, {}, nullptr, nullptr};
+  if (!Prepare(request, &body, gzip)) {
+    return -CURLE_FAILED_INIT;
+  }
+
+  return Finish(request, curl_easy_perform(request.curl));
+}
+
+int CurlWrapper::performHttpRequest(HttpMethod method, const std::string& uri,
+                                    const std::string& body,
+                                    const std::vector<std::string>& headers) {
+  auto request = Request{method, uri, {}, false, {}, nullptr, nullptr};
+  if (!Prepare(request, &body, false, &headers)) {
+    return -CURLE_FAILED_INIT;
+  }
+
+  return Finish(request, curl_easy_perform(request.curl));
+}
+
+int CurlWrapper::performHttpRequest(
+    HttpMethod method, const std::string& uri, const bool gzip,
+    const std::function<bool(OutputBuffer&)>& write_body,
+    std::uint64_t* body_size) {
+  auto request = Request{method, uri, {}, gzip, {}, nullptr, nullptr};
+  if (!Prepare(request, nullptr, gzip)) {
+    return -CURLE_FAILED_INIT;
+  }
+
+  // A multi handle of its own lets the transfer run on the calling thread in
+  // between writes. Connections are still reused through the share.
+  auto multi = curl_multi_init();
+  auto curl_error = CURLE_FAILED_INIT;
+  if (multi) {
+    UploadBuffer body{multi, request.curl};
+    if (curl_multi_add_handle(multi, request.curl) == CURLM_OK) {
+      curl_error = write_body(body) ? body.Finish() : body.Abort();
+      curl_multi_remove_handle(multi, request.curl);
+    }
+    if (body_size) {
+      *body_size = body.GetSize();
+    }
+    curl_multi_cleanup(multi);
+  }
+
+  return Finish(request, curl_error);
+}
+
+void CurlWrapper::performHttpRequestAsync(HttpMethod method,
+                                          const std::string& uri,
+                                          std::string body, const bool gzip,
+                                          std::function<void(int)> done) {
+  auto request = make_unique<Request>(Request{
+      method, uri, std::move(body), gzip, std::move(done), nullptr, nullptr});
+
+  {
+    std::lock_guard<std::mutex> lock{queue_mutex_};
+    if (!multi_) {
+      multi_ = curl_multi_init();
+      if (!multi_) {
+        request->done(-CURLE_FAILED_INIT);
+        return;
+      }
+      event_loop_ = std::thread{&CurlWrapper::RunEventLoop, this};
+    }
+    queue_.push_back(request.release());
+  }
+  curl_multi_wakeup(multi_);
+}
+
+std::uint64_t CurlWrapper::GetSentBytes() const { return sent_bytes_; }
+
+void CurlWrapper::RunEventLoop() {
+  auto active = std::size_t{0};
+
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock{queue_mutex_};
+      // Queued requests are completed before stopping
+      if (stopping_ && queue_.empty() && active == 0) {
+        return;
+      }
+      while (active < max_concurrent_requests_ && !queue_.empty()) {
+        auto request = std::unique_ptr<Request>{queue_.front()};
+        queue_.pop_front();
+        if (Prepare(*request, &request->body, request->gzip) &&
+            curl_multi_add_handle(multi_, request->curl) == CURLM_OK) {
+          ++active;
+          request.release();
+        } else {
+          if (request->curl) {
+            Finish(*request, CURLE_FAILED_INIT);
+          }
+          request->done(-CURLE_FAILED_INIT);
+        }
+      }
+    }
+
+    int running;
+    curl_multi_perform(multi_, &running);
+
+    int remaining;
+    while (auto message = curl_multi_info_read(multi_, &remaining)) {
+      if (message->msg != CURLMSG_DONE) {
+        continue;
+      }
+      Request* raw_request;
+      curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &raw_request);
+      auto request = std::unique_ptr<Request>{raw_request};
+      const auto curl_error = message->data.result;
+      curl_multi_remove_handle(multi_, request->curl);
+      --active;
+      request->done(Finish(*request, curl_error));
+    }
+
+    curl_multi_poll(multi_, nullptr, 0, 1000, nullptr);
+  }
+}
+
+}  // namespace detail
+}  // namespace prometheus
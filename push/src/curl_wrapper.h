@@ -0,0 +1,119 @@
+#pragma once
+
+#include <curl/curl.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "prometheus/detail/http_method.h"
+#include "prometheus/output_buffer.h"
+
+namespace prometheus {
+namespace detail {
+
+/// \brief Performs HTTP requests on reused curl handles.
+///
+/// A handle keeps its connections open after a request, so following
+/// requests to the same server skip connecting, name resolution and the TLS
+/// handshake. Handles are pooled to allow concurrent requests. All handles
+/// share their DNS cache, TLS sessions and connections.
+///
+/// Asynchronous requests are all driven by a single background thread using
+/// a curl multi handle, which is started by the first of them.
+///
+/// The class is thread-safe.
+class CurlWrapper {
+ public:
+  /// \param max_concurrent_requests Maximum number of asynchronous requests
+  /// in flight at the same time. Further requests are queued.
+  CurlWrapper(const std::string& username, const std::string& password,
+              std::size_t max_concurrent_requests = 8);
+
+  /// \brief Completes all asynchronous requests and releases the handles.
+  ~CurlWrapper();
+
+  CurlWrapper(const CurlWrapper&) = delete;
+  CurlWrapper& operator=(const CurlWrapper&) = delete;
+
+  /// \brief Returns the HTTP status code or the negated curl error code.
+  ///
+  /// \param gzip Whether the body is compressed with gzip.
+  int performHttpRequest(HttpMethod method, const std::string& uri,
+                         const std::string& body, bool gzip = false);
+
+  /// \brief Performs a request with a body in another format than the text
+  /// format and returns like performHttpRequest().
+  ///
+  /// \param headers The header lines describing the body, e.g.,
+  /// "Content-Type: application/x-protobuf".
+  int performHttpRequest(HttpMethod method, const std::string& uri,
+                         const std::string& body,
+                         const std::vector<std::string>& headers);
+
+  /// \brief Performs a request with a body streamed by chunked transfer
+  /// encoding and returns like performHttpRequest().
+  ///
+  /// The body is written to the buffer passed to write_body, which sends it
+  /// in chunks of bounded size while write_body runs. The whole body is never
+  /// held in memory. The transfer is aborted if write_body returns false.
+  ///
+  /// \param body_size If not nullptr, set to the number of bytes written by
+  /// write_body.
+  int performHttpRequest(HttpMethod method, const std::string& uri, bool gzip,
+                         const std::function<bool(OutputBuffer&)>& write_body,
+                         std::uint64_t* body_size = nullptr);
+
+  /// \brief Queues a request and returns immediately.
+  ///
+  /// \param done Called with the HTTP status code or the negated curl error
+  /// code once the request is complete. It is called on the background
+  /// thread and must not block.
+  void performHttpRequestAsync(HttpMethod method, const std::string& uri,
+                               std::string body, bool gzip,
+                               std::function<void(int)> done);
+
+  /// \brief Returns the number of body bytes sent by all requests.
+  std::uint64_t GetSentBytes() const;
+
+ private:
+  struct Request;
+
+  CURL* AcquireHandle();
+  void ReleaseHandle(CURL* curl);
+  // The body is streamed if it is nullptr. Headers replace the ones of the
+  // text format if given.
+  bool Prepare(Request& request, const std::string* body, bool gzip,
+               const std::vector<std::string>* headers = nullptr);
+  int Finish(Request& request, CURLcode curl_error);
+
+  void RunEventLoop();
+
+  static void LockShare(CURL*, curl_lock_data data, curl_lock_access,
+                        void* self);
+  static void UnlockShare(CURL*, curl_lock_data data, void* self);
+
+  std::string auth_;
+  CURLSH* share_;
+  // One for each kind of data shared between the handles
+  std::mutex share_mutexes_[CURL_LOCK_DATA_LAST];
+  std::mutex handles_mutex_;
+  std::vector<CURL*> handles_;
+  std::atomic<std::uint64_t> sent_bytes_;
+
+  const std::size_t max_concurrent_requests_;
+  CURLM* multi_;
+  std::mutex queue_mutex_;
+  std::deque<Request*> queue_;
+  bool stopping_;
+  std::thread event_loop_;
+};
+
+}  // namespace detail
+}  // namespace prometheus
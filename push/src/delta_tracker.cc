@@ -0,0 +1,131 @@
+#include "delta_tracker.h"
+
+#include <cstring>
+#include <utility>
+
+namespace prometheus {
+namespace detail {
+
+namespace {
+
+// Appends the bytes of a value. The state is only compared within the same
+// process, so the byte order does not matter.
+template <typename T>
+void AppendRaw(std::string& state, const T& value) {
+  char bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  state.append(bytes, sizeof(T));
+}
+
+// Appends a string with its size, so that different strings can not give
+// the same state by being split differently.
+void AppendString(std::string& state, const std::string& value) {
+  AppendRaw(state, value.size());
+  state.append(value);
+}
+
+}  // namespace
+
+std::string DeltaTracker::GetState(const MetricFamily& family) {
+  std::string state;
+  AppendString(state, family.help);
+  AppendRaw(state, family.type);
+  AppendRaw(state, family.metric.size());
+
+  for (const auto& metric : family.metric) {
+    AppendRaw(state, metric.label.size());
+    for (const auto& label : metric.label) {
+      AppendString(state, label.name);
+      AppendString(state, label.value);
+    }
+    AppendRaw(state, metric.timestamp_ms);
+
+    switch (family.type) {
+      case MetricType::Counter:
+        AppendRaw(state, metric.counter.value);
+        AppendRaw(state, metric.counter.created_timestamp_ms);
+        break;
+      case MetricType::Gauge:
+        AppendRaw(state, metric.gauge.value);
+        break;
+      case MetricType::Summary:
+        AppendRaw(state, metric.summary.sample_count);
+        AppendRaw(state, metric.summary.sample_sum);
+        AppendRaw(state, metric.summary.created_timestamp_ms);
+        AppendRaw(state, metric.summary.quantile.size());
+        for (const auto& quantile : metric.summary.quantile) {
+          AppendRaw(state, quantile.quantile);
+          AppendRaw(state, quantile.value);
+        }
+        break;
+      case MetricType::Untyped:
+        AppendRaw(state, metric.untyped.value);
+        break;
+      case MetricType::Histogram:
+        AppendRaw(state, metric.histogram.sample_count);
+        AppendRaw(state, metric.histogram.sample_sum);
+        AppendRaw(state, metric.histogram.created_timestamp_ms);
+        AppendRaw(state, metric.histogram.bucket.size());
+        for (const auto& bucket : metric.histogram.bucket) {
+          AppendRaw(state, bucket.cumulative_count);
+          AppendRaw(state, bucket.upper_bound);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  return state;
+}
+
+DeltaTracker::Snapshot DeltaTracker::Take(
+    const std::vector<MetricFamily>& families) {
+  Snapshot snapshot;
+  for (const auto& family : families) {
+    snapshot[family.name] = GetState(family);
+  }
+  return snapshot;
+}
+
+DeltaTracker::Snapshot DeltaTracker::RemoveUnchanged(
+    const std::string& uri, std::vector<MetricFamily>& families) const {
+  Snapshot snapshot;
+  const auto pushed = pushed_.find(uri);
+  auto kept = families.begin();
+
+  for (auto& family : families) {
+    auto state = GetState(family);
+    if (pushed != pushed_.end()) {
+      const auto previous = pushed->second.find(family.name);
+      if (previous != pushed->second.end() && previous->second == state) {
+        continue;
+      }
+    }
+
+    snapshot[family.name] = std::move(state);
+    if (&*kept != &family) {
+      *kept = std::move(family);
+    }
+    ++kept;
+  }
+
+  families.erase(kept, families.end());
+  return snapshot;
+}
+
+void DeltaTracker::Acknowledge(const std::string& uri, Snapshot snapshot,
+                               bool replace) {
+  auto& pushed = pushed_[uri];
+  if (replace) {
+    pushed = std::move(snapshot);
+    return;
+  }
+
+  for (auto& family : snapshot) {
+    pushed[family.first] = std::move(family.second);
+  }
+}
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "prometheus/metric_family.h"
+
+namespace prometheus {
+namespace detail {
+
+/// \brief Remembers the metric families last pushed to each uri to find the
+/// ones which changed since.
+///
+/// A family counts as changed if any of its series was added, removed or has
+/// a different value. Values are compared exactly, not by a hash.
+///
+/// The class is not thread-safe.
+class DeltaTracker {
+ public:
+  /// \brief The state of a list of families by family name.
+  using Snapshot = std::unordered_map<std::string, std::string>;
+
+  /// \brief Returns the state of the given families.
+  static Snapshot Take(const std::vector<MetricFamily>& families);
+
+  /// \brief Removes the families which did not change since the last push
+  /// acknowledged for the uri and returns the state of the remaining ones.
+  Snapshot RemoveUnchanged(const std::string& uri,
+                           std::vector<MetricFamily>& families) const;
+
+  /// \brief Records that the families of the snapshot were pushed to the uri.
+  ///
+  /// \param replace Whether the push replaced all families of the uri, or
+  /// only the ones in the snapshot.
+  void Acknowledge(const std::string& uri, Snapshot snapshot, bool replace);
+
+  /// \brief Forgets all pushes.
+  void Clear() { pushed_.clear(); }
+
+ private:
+  static std::string GetState(const MetricFamily& family);
+
+  std::unordered_map<std::string, Snapshot> pushed_;
+};
+
+}  // namespace detail
+}  // namespace prometheus
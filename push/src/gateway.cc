@@ -1,34 +1,46 @@
 
 #include "prometheus/gateway.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
 #include <memory>
 #include <sstream>
-
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "curl_wrapper.h"
+#include "delta_tracker.h"
+#include "merged_collectables.h"
+#include "periodic_runner.h"
 #include "prometheus/client_metric.h"
+#include "prometheus/detail/arena.h"
+#include "prometheus/detail/future_std.h"
+#include "prometheus/detail/gzip_buffer.h"
+#include "prometheus/metric_family.h"
 #include "prometheus/serializer.h"
 #include "prometheus/text_serializer.h"
-
-#include <curl/curl.h>
+#include "spool.h"
 
 namespace prometheus {
 
-static const char CONTENT_TYPE[] =
-    "Content-Type: text/plain; version=0.0.4; charset=utf-8";
+using detail::HttpMethod;
 
 Gateway::Gateway(const std::string host, const std::string port,
                  const std::string jobname, const Labels& labels,
-                 const std::string username, const std::string password) {
-  /* In windows, this will init the winsock stuff */
-  curl_global_init(CURL_GLOBAL_ALL);
-
+                 const std::string username, const std::string password)
+    : jobname_(jobname),
+      curlWrapper_(detail::make_unique<detail::CurlWrapper>(username,
+                                                            password)),
+      periodic_push_(detail::make_unique<detail::PeriodicRunner>()) {
   std::stringstream jobUriStream;
   jobUriStream << host << ':' << port << "/metrics/job/" << jobname;
   jobUri_ = jobUriStream.str();
 
-  if (!username.empty()) {
-    auth_ = username + ":" + password;
-  }
-
   std::stringstream labelStream;
   for (auto& label : labels) {
     labelStream << "/" << label.first << "/" << label.second;
@@ -36,7 +48,7 @@ Gateway::Gateway(const std::string host, const std::string port,
   labels_ = labelStream.str();
 }
 
-Gateway::~Gateway() { curl_global_cleanup(); }
+Gateway::~Gateway() { StopPeriodicPush(); }
 
 const Gateway::Labels Gateway::GetInstanceLabel(std::string hostname) {
   if (hostname.empty()) {
@@ -55,71 +67,154 @@ void Gateway::RegisterCollectable(const std::weak_ptr<Collectable>& collectable,
     }
   }
 
+  std::lock_guard<std::mutex> lock{mutex_};
   collectables_.push_back(std::make_pair(collectable, ss.str()));
 }
 
-int Gateway::performHttpRequest(HttpMethod method, const std::string& uri,
-                                const std::string& body) const {
-  auto curl = curl_easy_init();
-  if (!curl) {
-    return -CURLE_FAILED_INIT;
-  }
-
-  curl_easy_setopt(curl, CURLOPT_URL, uri.c_str());
+std::string Gateway::getUri(const CollectableEntry& collectable) const {
+  std::stringstream uri;
+  uri << jobUri_ << labels_ << collectable.second;
 
-  curl_slist* header_chunk = nullptr;
+  return uri.str();
+}
 
-  if (!body.empty()) {
-    header_chunk = curl_slist_append(nullptr, CONTENT_TYPE);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, header_chunk);
+std::vector<Gateway::CollectableGroup> Gateway::getGroups() const {
+  std::vector<CollectableGroup> groups;
+  std::unordered_map<std::string, std::size_t> group_index;
 
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, body.size());
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.data());
-  }
+  for (auto& wcollectable : collectables_) {
+    auto collectable = wcollectable.first.lock();
+    if (!collectable) {
+      continue;
+    }
 
-  if (!auth_.empty()) {
-    curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
-    curl_easy_setopt(curl, CURLOPT_USERPWD, auth_.c_str());
+    auto uri = getUri(wcollectable);
+    auto inserted = group_index.emplace(uri, groups.size());
+    if (inserted.second) {
+      groups.emplace_back(std::move(uri),
+                          std::vector<std::shared_ptr<Collectable>>{});
+    }
+    groups[inserted.first->second].second.push_back(std::move(collectable));
   }
 
-  switch (method) {
-    case HttpMethod::Post:
-      curl_easy_setopt(curl, CURLOPT_HTTPGET, 0L);
-      curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
-      break;
+  return groups;
+}
 
-    case HttpMethod::Put:
-      curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
-      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
-      break;
+namespace {
+
+// Serializes the metrics of collectables as request body, compressed with
+// gzip if enabled. One writer is reused for all bodies of a push.
+class BodyWriter {
+ public:
+  BodyWriter(bool gzip, int level)
+      : gzip_{gzip && compressor_.Start(level)}, level_{level} {}
+
+  bool IsGZip() const { return gzip_; }
+
+  // Returns false if the body could not be compressed.
+  //
+  // The body is only uploaded while the collectables hold no locks, so a
+  // slow gateway does not keep the application from changing its metrics.
+  bool Write(OutputBuffer& out,
+             const std::vector<std::shared_ptr<Collectable>>& collectables) {
+    return Compress(out, [&](OutputBuffer& body) {
+      if (collectables.size() == 1) {
+        serializer_.SerializeOutsideLocks(body, *collectables.front(),
+                                          pending_);
+      } else {
+        serializer_.SerializeOutsideLocks(
+            body, detail::MergedCollectables{collectables}, pending_);
+      }
+      serializer_.SerializeTrailer(body);
+    });
+  }
 
-    case HttpMethod::Delete:
-      curl_easy_setopt(curl, CURLOPT_HTTPGET, 0L);
-      curl_easy_setopt(curl, CURLOPT_NOBODY, 0L);
-      curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
-      break;
+  bool Write(OutputBuffer& out, const std::vector<MetricFamily>& families) {
+    return Compress(out, [&](OutputBuffer& body) {
+      serializer_.Serialize(body, families);
+    });
   }
 
-  auto curl_error = curl_easy_perform(curl);
+  // Returns the size of the last body before compression, only known if it
+  // is compressed.
+  std::uint64_t GetUncompressedSize() const {
+    return gzip_ ? compressor_.GetTotalIn() : 0;
+  }
 
-  long response_code;
-  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+ private:
+  bool Compress(OutputBuffer& out,
+                const std::function<void(OutputBuffer&)>& write_body) {
+    if (!gzip_) {
+      write_body(out);
+      return true;
+    }
 
-  curl_easy_cleanup(curl);
-  curl_slist_free_all(header_chunk);
+    if (!compressor_.Start(level_)) {
+      return false;
+    }
+    arena_.Reset();
+    detail::GZipBuffer compressed{compressor_, out, arena_};
+    write_body(compressed);
+    return compressed.Finish();
+  }
 
-  if (curl_error != CURLE_OK) {
-    return -curl_error;
+  const TextSerializer serializer_;
+  StringOutputBuffer pending_;
+  detail::GZipCompressor compressor_;
+  detail::Arena arena_;
+  const bool gzip_;
+  const int level_;
+};
+
+}  // namespace
+
+// FNV-1a, which unlike std::hash is the same in every process, so that a
+// spool is found again after a restart
+static std::uint64_t HashGroupingKey(const std::string& key) {
+  auto hash = std::uint64_t{14695981039346656037u};
+  for (const auto c : key) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211u;
   }
+  return hash;
+}
 
-  return response_code;
+static bool IsSuccess(int status_code) {
+  return status_code >= 100 && status_code < 400;
 }
 
-std::string Gateway::getUri(const CollectableEntry& collectable) const {
-  std::stringstream uri;
-  uri << jobUri_ << labels_ << collectable.second;
+// Whether a request might succeed when it is sent again
+static bool IsRetryable(int status_code) {
+  return status_code < 100 || status_code >= 500;
+}
 
-  return uri.str();
+int Gateway::performWithRetry(const RetryPolicy& policy,
+                              const std::function<int()>& request) {
+  auto backoff = policy.initial_backoff;
+  for (auto retries = 0;; ++retries) {
+    const auto status_code = request();
+    if (!IsRetryable(status_code) || retries >= policy.max_retries) {
+      return status_code;
+    }
+
+    std::this_thread::sleep_for(backoff);
+    backoff = std::min(backoff * 2, policy.max_backoff);
+  }
+}
+
+int Gateway::replaySpool(detail::Spool& spool, const RetryPolicy& policy) {
+  auto status_code = 200;
+  spool.Replay([&](const detail::Spool::Entry& entry) {
+    status_code = performWithRetry(policy, [&] {
+      return curlWrapper_->performHttpRequest(entry.method, entry.uri,
+                                              entry.body, entry.gzip);
+    });
+    // Requests rejected by the pushgateway are dropped since they would
+    // never succeed
+    return !IsRetryable(status_code);
+  });
+
+  return IsRetryable(status_code) ? status_code : 200;
 }
 
 int Gateway::Push() { return push(HttpMethod::Post); }
@@ -127,25 +222,106 @@ int Gateway::Push() { return push(HttpMethod::Post); }
 int Gateway::PushAdd() { return push(HttpMethod::Put); }
 
 int Gateway::push(HttpMethod method) {
-  const auto serializer = TextSerializer{};
+  BodyWriter writer{compression_enabled_, compression_level_};
+  std::lock_guard<std::mutex> push_lock{push_mutex_};
+
+  std::vector<CollectableGroup> groups;
+  RetryPolicy retry_policy;
+  std::shared_ptr<detail::Spool> spool;
+  std::shared_ptr<detail::DeltaTracker> delta_tracker;
+  std::chrono::steady_clock::time_point next_full_push;
+  std::chrono::milliseconds full_push_interval;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    groups = getGroups();
+    retry_policy = retry_policy_;
+    spool = spool_;
+    if (method == HttpMethod::Put) {
+      delta_tracker = delta_;
+    }
+    next_full_push = next_full_push_;
+    full_push_interval = full_push_interval_;
+  }
 
-  for (auto& wcollectable : collectables_) {
-    auto collectable = wcollectable.first.lock();
-    if (!collectable) {
-      continue;
+  // PushAdd() only sends the changed families between full pushes
+  const bool delta = delta_tracker != nullptr;
+  const auto now = std::chrono::steady_clock::now();
+  const auto full_push = !delta || now >= next_full_push;
+
+  // Once a request failed, all following ones are spooled to keep the order
+  auto status_code = spool ? replaySpool(*spool, retry_policy) : 200;
+  auto spooling = !IsSuccess(status_code);
+
+  for (auto& group : groups) {
+    auto& uri = group.first;
+    auto request_method = method;
+    std::function<bool(OutputBuffer&)> write_body = [&](OutputBuffer& out) {
+      return writer.Write(out, group.second);
+    };
+
+    std::vector<MetricFamily> families;
+    detail::DeltaTracker::Snapshot snapshot;
+    if (delta) {
+      families = detail::MergedCollectables{group.second}.Collect();
+      if (full_push) {
+        snapshot = detail::DeltaTracker::Take(families);
+      } else {
+        snapshot = delta_tracker->RemoveUnchanged(uri, families);
+        if (families.empty()) {
+          continue;
+        }
+        // Unlike PushAdd(), Push() keeps the families which are not sent
+        request_method = HttpMethod::Post;
+      }
+      write_body = [&](OutputBuffer& out) {
+        return writer.Write(out, families);
+      };
     }
 
-    auto metrics = collectable->Collect();
-    auto body = serializer.Serialize(metrics);
-    auto uri = getUri(wcollectable);
-    auto status_code = performHttpRequest(method, uri, body);
+    if (!spooling) {
+      // The body is streamed while it is serialized
+      status_code = performWithRetry(retry_policy, [&] {
+        auto body_size = std::uint64_t{0};
+        auto result = curlWrapper_->performHttpRequest(
+            request_method, uri, writer.IsGZip(), write_body, &body_size);
+        serialized_bytes_ +=
+            writer.IsGZip() ? writer.GetUncompressedSize() : body_size;
+        return result;
+      });
+
+      if (IsSuccess(status_code)) {
+        if (delta) {
+          delta_tracker->Acknowledge(uri, std::move(snapshot), full_push);
+        }
+        continue;
+      }
+      if (!spool || !IsRetryable(status_code)) {
+        return status_code;
+      }
+      spooling = true;
+    }
 
-    if (status_code < 100 || status_code >= 400) {
-      return status_code;
+    // Spooled families are not acknowledged and sent again by the next push
+    if (spool) {
+      StringOutputBuffer body;
+      if (!write_body(body)) {
+        continue;
+      }
+      spool->Add(detail::Spool::Entry{request_method, writer.IsGZip(), uri,
+                                      body.ToString()});
+    }
+  }
+
+  // A failed full push is repeated by the next push. The tracker may have
+  // been replaced in the meantime, which starts over with a full push.
+  if (delta && full_push && !spooling) {
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (delta_ == delta_tracker) {
+      next_full_push_ = now + full_push_interval;
     }
   }
 
-  return 200;
+  return spooling ? status_code : 200;
 }
 
 std::future<int> Gateway::AsyncPush() { return async_push(HttpMethod::Post); }
@@ -153,47 +329,138 @@ std::future<int> Gateway::AsyncPush() { return async_push(HttpMethod::Post); }
 std::future<int> Gateway::AsyncPushAdd() { return async_push(HttpMethod::Put); }
 
 std::future<int> Gateway::async_push(HttpMethod method) {
-  const auto serializer = TextSerializer{};
-  std::vector<std::future<int>> futures;
+  // Reduces the status codes of all requests, which all complete on the same
+  // background thread
+  struct Result {
+    std::promise<int> promise;
+    std::size_t pending;
+    int final_status_code;
+  };
+  struct Request {
+    std::string uri;
+    std::string body;
+  };
 
-  for (auto& wcollectable : collectables_) {
-    auto collectable = wcollectable.first.lock();
-    if (!collectable) {
+  BodyWriter writer{compression_enabled_, compression_level_};
+  auto result = std::make_shared<Result>();
+  auto future = result->promise.get_future();
+  std::vector<Request> requests;
+  auto final_status_code = 200;
+
+  std::vector<CollectableGroup> groups;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    groups = getGroups();
+  }
+
+  // The bodies are serialized without holding the mutex
+  for (auto& group : groups) {
+    StringOutputBuffer body;
+    if (!writer.Write(body, group.second)) {
+      // Reported like a transfer aborted while the body was streamed
+      final_status_code = -CURLE_ABORTED_BY_CALLBACK;
       continue;
     }
+    serialized_bytes_ +=
+        writer.IsGZip() ? writer.GetUncompressedSize() : body.GetSize();
+    requests.push_back(Request{std::move(group.first), body.ToString()});
+  }
 
-    auto metrics = collectable->Collect();
-    auto body = std::make_shared<std::string>(serializer.Serialize(metrics));
-    auto uri = getUri(wcollectable);
+  result->pending = requests.size();
+  result->final_status_code = final_status_code;
+  if (requests.empty()) {
+    result->promise.set_value(final_status_code);
+    return future;
+  }
 
-    futures.push_back(std::async(std::launch::async, [method, uri, body, this] {
-      return performHttpRequest(method, uri, *body);
-    }));
+  for (auto& request : requests) {
+    curlWrapper_->performHttpRequestAsync(
+        method, request.uri, std::move(request.body), writer.IsGZip(),
+        [result](int status_code) {
+          if (status_code < 100 || status_code >= 400) {
+            result->final_status_code = status_code;
+          }
+          if (--result->pending == 0) {
+            result->promise.set_value(result->final_status_code);
+          }
+        });
   }
 
-  const auto reduceFutures = [](std::vector<std::future<int>> lfutures) {
-    auto final_status_code = 200;
+  return future;
+}
 
-    for (auto& future : lfutures) {
-      auto status_code = future.get();
+int Gateway::Delete() {
+  return curlWrapper_->performHttpRequest(HttpMethod::Delete, jobUri_, {});
+}
 
-      if (status_code < 100 || status_code >= 400) {
-        final_status_code = status_code;
-      }
-    }
+std::future<int> Gateway::AsyncDelete() {
+  auto promise = std::make_shared<std::promise<int>>();
+  auto future = promise->get_future();
+  curlWrapper_->performHttpRequestAsync(
+      HttpMethod::Delete, jobUri_, {}, false,
+      [promise](int status_code) { promise->set_value(status_code); });
+  return future;
+}
 
-    return final_status_code;
-  };
+void Gateway::EnableCompression(const int level) {
+  compression_level_ = level;
+  compression_enabled_ = true;
+}
 
-  return std::async(std::launch::async, reduceFutures, std::move(futures));
+void Gateway::DisableCompression() { compression_enabled_ = false; }
+
+std::uint64_t Gateway::GetSerializedBytes() const {
+  return serialized_bytes_;
 }
 
-int Gateway::Delete() {
-  return performHttpRequest(HttpMethod::Delete, jobUri_, {});
+std::uint64_t Gateway::GetSentBytes() const {
+  return curlWrapper_->GetSentBytes();
 }
 
-std::future<int> Gateway::AsyncDelete() {
-  return std::async(std::launch::async, [&] { return Delete(); });
+void Gateway::SetRetryPolicy(const int max_retries,
+                             const std::chrono::milliseconds initial_backoff,
+                             const std::chrono::milliseconds max_backoff) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  retry_policy_.max_retries = max_retries;
+  retry_policy_.initial_backoff = initial_backoff;
+  retry_policy_.max_backoff = max_backoff;
+}
+
+void Gateway::EnableSpooling(const std::string& directory,
+                             const std::size_t max_bytes) {
+  // Every grouping key has a spool of its own, also when several gateways
+  // of the same job spool to one directory
+  std::ostringstream path;
+  path << directory << "/" << jobname_ << "-" << std::hex << std::setw(16)
+       << std::setfill('0') << HashGroupingKey(jobUri_ + labels_) << ".spool";
+
+  auto spool = std::make_shared<detail::Spool>(path.str(), max_bytes);
+  std::lock_guard<std::mutex> lock{mutex_};
+  spool_ = std::move(spool);
+}
+
+void Gateway::EnableDeltaPush(std::chrono::milliseconds full_push_interval) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  if (!delta_) {
+    delta_ = std::make_shared<detail::DeltaTracker>();
+    // The pushgateway may still hold families of a previous process
+    next_full_push_ = std::chrono::steady_clock::time_point{};
+  }
+  full_push_interval_ = full_push_interval;
 }
 
+void Gateway::DisableDeltaPush() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  delta_.reset();
+}
+
+void Gateway::StartPeriodicPush(std::chrono::milliseconds interval,
+                                std::chrono::milliseconds jitter) {
+  // Pushing on the thread of the runner retries, spools and sends deltas
+  // like any other push
+  periodic_push_->Start([this] { Push(); }, interval, jitter);
+}
+
+void Gateway::StopPeriodicPush() { periodic_push_->Stop(true); }
+
 }  // namespace prometheus
@@ -0,0 +1,239 @@
+#include "merged_collectables.h"
+
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "prometheus/metric_sink.h"
+
+namespace prometheus {
+namespace detail {
+
+namespace {
+
+// The index of the only collectable holding a family, or kShared
+using FamilyOwners = std::unordered_map<std::string, std::size_t>;
+
+const std::size_t kShared = std::numeric_limits<std::size_t>::max();
+
+// Records the owner of every family passed to it, and drops the series
+class OwnerSink : public MetricSink {
+ public:
+  explicit OwnerSink(FamilyOwners& owners) : owners_(owners), index_{0} {}
+
+  void SetCollectable(std::size_t index) { index_ = index; }
+
+  void AddFamily(const std::string& name, const std::string&,
+                 MetricType) override {
+    auto inserted = owners_.emplace(name, index_);
+    if (!inserted.second && inserted.first->second != index_) {
+      inserted.first->second = kShared;
+    }
+  }
+
+  void AddMetric(const Series&, const ClientMetric::Counter&) override {}
+  void AddMetric(const Series&, const ClientMetric::Gauge&) override {}
+  void AddMetric(const Series&, const ClientMetric::Summary&) override {}
+  void AddMetric(const Series&, const ClientMetric::Histogram&) override {}
+  void AddMetric(const Series&, const ClientMetric::Untyped&) override {}
+
+ private:
+  FamilyOwners& owners_;
+  std::size_t index_;
+};
+
+// Forwards the families owned by the current collectable to another sink and
+// buffers all others
+class MergingSink : public MetricSink {
+ public:
+  MergingSink(MetricSink& sink, const FamilyOwners& owners)
+      : sink_(sink),
+        owners_(owners),
+        index_{0},
+        current_{nullptr},
+        dropping_{false} {}
+
+  void SetCollectable(std::size_t index) { index_ = index; }
+
+  void AddFamily(const std::string& name, const std::string& help,
+                 MetricType type) override {
+    current_ = nullptr;
+    dropping_ = false;
+
+    // The owners were collected before, so a family may have been added to
+    // another collectable in the meantime. A family buffered already is
+    // merged, and the series of a family streamed by another collectable
+    // already are dropped, as a second block of a family is invalid.
+    auto streamed = streamed_.find(name);
+    if (streamed != streamed_.end() && streamed->second != index_) {
+      dropping_ = true;
+      return;
+    }
+
+    auto owner = owners_.find(name);
+    if (owner != owners_.end() && owner->second == index_ &&
+        buffered_index_.count(name) == 0) {
+      streamed_.emplace(name, index_);
+      sink_.AddFamily(name, help, type);
+      return;
+    }
+
+    auto inserted = buffered_index_.emplace(name, buffered_.size());
+    if (inserted.second) {
+      buffered_.emplace_back();
+      buffered_.back().name = name;
+      buffered_.back().help = help;
+      buffered_.back().type = type;
+    }
+    current_ = &buffered_[inserted.first->second];
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Counter& counter) override {
+    if (dropping_) {
+      return;
+    }
+    if (current_) {
+      Buffer(series).counter = counter;
+    } else {
+      sink_.AddMetric(series, counter);
+    }
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Gauge& gauge) override {
+    if (dropping_) {
+      return;
+    }
+    if (current_) {
+      Buffer(series).gauge = gauge;
+    } else {
+      sink_.AddMetric(series, gauge);
+    }
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Summary& summary) override {
+    if (dropping_) {
+      return;
+    }
+    if (current_) {
+      Buffer(series).summary = summary;
+    } else {
+      sink_.AddMetric(series, summary);
+    }
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Histogram& histogram) override {
+    if (dropping_) {
+      return;
+    }
+    if (current_) {
+      Buffer(series).histogram = histogram;
+    } else {
+      sink_.AddMetric(series, histogram);
+    }
+  }
+
+  void AddMetric(const Series& series,
+                 const ClientMetric::Untyped& untyped) override {
+    if (dropping_) {
+      return;
+    }
+    if (current_) {
+      Buffer(series).untyped = untyped;
+    } else {
+      sink_.AddMetric(series, untyped);
+    }
+  }
+
+  // The families streamed so far are complete, and the buffered ones are
+  // not passed on yet
+  void Flush() override { sink_.Flush(); }
+
+  // Passes the buffered families on
+  void AddBuffered() {
+    for (auto& family : buffered_) {
+      sink_.AddFamily(family.name, family.help, family.type);
+      for (auto& metric : family.metric) {
+        sink_.AddClientMetric(family.type, metric);
+      }
+    }
+  }
+
+ private:
+  ClientMetric& Buffer(const Series& series) {
+    current_->metric.emplace_back();
+    auto& metric = current_->metric.back();
+    metric.label = series.label;
+    for (auto& lp : series.constant_labels) {
+      metric.label.push_back(ClientMetric::Label{lp.first, lp.second});
+    }
+    for (auto& lp : series.labels) {
+      metric.label.push_back(ClientMetric::Label{lp.first, lp.second});
+    }
+    metric.timestamp_ms = series.timestamp_ms;
+    return metric;
+  }
+
+  MetricSink& sink_;
+  const FamilyOwners& owners_;
+  std::size_t index_;
+  std::vector<MetricFamily> buffered_;
+  std::unordered_map<std::string, std::size_t> buffered_index_;
+  // The collectable which streamed a family
+  std::unordered_map<std::string, std::size_t> streamed_;
+  MetricFamily* current_;
+  bool dropping_;
+};
+
+}  // namespace
+
+MergedCollectables::MergedCollectables(
+    const std::vector<std::shared_ptr<Collectable>>& collectables)
+    : collectables_(collectables) {}
+
+std::vector<MetricFamily> MergedCollectables::Collect() const {
+  std::vector<MetricFamily> families;
+  std::unordered_map<std::string, std::size_t> family_index;
+
+  for (auto& collectable : collectables_) {
+    for (auto& family : collectable->Collect()) {
+      auto inserted = family_index.emplace(family.name, families.size());
+      if (inserted.second) {
+        families.push_back(std::move(family));
+        continue;
+      }
+
+      auto& metric = families[inserted.first->second].metric;
+      metric.insert(metric.end(),
+                    std::make_move_iterator(family.metric.begin()),
+                    std::make_move_iterator(family.metric.end()));
+    }
+  }
+
+  return families;
+}
+
+void MergedCollectables::CollectTo(MetricSink& sink) const {
+  FamilyOwners owners;
+  OwnerSink owner_sink{owners};
+  for (std::size_t i = 0; i < collectables_.size(); ++i) {
+    owner_sink.SetCollectable(i);
+    collectables_[i]->CollectTo(owner_sink);
+  }
+
+  MergingSink merging{sink, owners};
+  for (std::size_t i = 0; i < collectables_.size(); ++i) {
+    merging.SetCollectable(i);
+    collectables_[i]->CollectTo(merging);
+  }
+  merging.AddBuffered();
+}
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "prometheus/collectable.h"
+#include "prometheus/metric_family.h"
+
+namespace prometheus {
+namespace detail {
+
+/// \brief Presents several collectables as one, whose families are merged by
+/// name.
+///
+/// All series of a family have to be adjacent in the text format, but the
+/// same family may be part of more than one collectable. CollectTo() first
+/// collects only the family names of all collectables. Then it streams the
+/// families of each collectable one after another, except for those whose
+/// names occur in more than one of them. Only these are buffered, merged and
+/// passed to the sink last. Series of a family which was streamed already
+/// and shows up in another collectable between both passes are dropped, so
+/// that no family is passed twice.
+class MergedCollectables : public Collectable {
+ public:
+  explicit MergedCollectables(
+      const std::vector<std::shared_ptr<Collectable>>& collectables);
+
+  std::vector<MetricFamily> Collect() const override;
+
+  void CollectTo(MetricSink& sink) const override;
+
+ private:
+  const std::vector<std::shared_ptr<Collectable>>& collectables_;
+};
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,78 @@
+#include "periodic_runner.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+
+namespace prometheus {
+namespace detail {
+
+PeriodicRunner::~PeriodicRunner() { Stop(false); }
+
+void PeriodicRunner::Start(std::function<void()> task,
+                           const std::chrono::milliseconds interval,
+                           const std::chrono::milliseconds jitter) {
+  // The next call follows right away, so nothing is flushed
+  Stop(false);
+
+  std::lock_guard<std::mutex> lock{mutex_};
+  stop_ = false;
+  thread_ = std::thread{&PeriodicRunner::Run, this, std::move(task), interval,
+                        jitter};
+}
+
+void PeriodicRunner::Stop(const bool flush) {
+  std::thread thread;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    stop_ = true;
+    flush_ = flush;
+    thread.swap(thread_);
+  }
+  cv_.notify_all();
+
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+void PeriodicRunner::Run(const std::function<void()>& task,
+                         const std::chrono::milliseconds interval,
+                         const std::chrono::milliseconds jitter) {
+  auto random_engine = std::minstd_rand{std::random_device{}()};
+  auto offset = std::uniform_int_distribution<std::chrono::milliseconds::rep>{
+      0, std::max(jitter.count(), std::chrono::milliseconds::rep{0})};
+
+  auto deadline = std::chrono::steady_clock::now();
+
+  std::unique_lock<std::mutex> lock{mutex_};
+  for (;;) {
+    const auto due = deadline + std::chrono::milliseconds{offset(random_engine)};
+    if (cv_.wait_until(lock, due, [this] { return stop_; })) {
+      break;
+    }
+
+    lock.unlock();
+    task();
+    lock.lock();
+
+    // The cycles which passed while the task was running are skipped
+    const auto now = std::chrono::steady_clock::now();
+    if (interval.count() > 0) {
+      do {
+        deadline += interval;
+      } while (deadline < now);
+    } else {
+      deadline = now;
+    }
+  }
+
+  const auto flush = flush_;
+  lock.unlock();
+  if (flush) {
+    task();
+  }
+}
+
+}  // namespace detail
+}  // namespace prometheus
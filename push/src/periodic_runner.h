@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace prometheus {
+namespace detail {
+
+/// \brief Calls a task on a background thread every interval.
+///
+/// Each call is delayed by a random offset of up to the jitter. Calls are
+/// scheduled relative to the previous deadline, so the jitter does not
+/// accumulate and the average interval stays as configured. The calls which
+/// fall due while the task is still running are skipped.
+///
+/// The class is thread-safe.
+class PeriodicRunner {
+ public:
+  PeriodicRunner() = default;
+
+  /// \brief Stops without calling the task one last time.
+  ~PeriodicRunner();
+
+  PeriodicRunner(const PeriodicRunner&) = delete;
+  PeriodicRunner& operator=(const PeriodicRunner&) = delete;
+
+  /// \brief Starts calling the task. Replaces a task started before without
+  /// calling it one last time.
+  void Start(std::function<void()> task, std::chrono::milliseconds interval,
+             std::chrono::milliseconds jitter = {});
+
+  /// \brief Stops calling the task and waits until the thread is done.
+  ///
+  /// \param flush Whether the task is called one last time on the thread.
+  void Stop(bool flush);
+
+ private:
+  void Run(const std::function<void()>& task,
+           std::chrono::milliseconds interval,
+           std::chrono::milliseconds jitter);
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+  bool flush_ = false;
+  std::thread thread_;
+};
+
+}  // namespace detail
+}  // namespace prometheus
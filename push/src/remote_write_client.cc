@@ -0,0 +1,168 @@
+#include "prometheus/remote_write_client.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "curl_wrapper.h"
+#include "periodic_runner.h"
+#include "prometheus/detail/future_std.h"
+#include "prometheus/output_buffer.h"
+#include "remote_write_encoder.h"
+#include "snappy.h"
+
+namespace prometheus {
+
+using detail::HttpMethod;
+
+// The receiver may tell senders apart by their name and version
+#ifdef PROMETHEUS_CPP_VERSION
+#define PROMETHEUS_CPP_USER_AGENT "prometheus-cpp/" PROMETHEUS_CPP_VERSION
+#else
+#define PROMETHEUS_CPP_USER_AGENT "prometheus-cpp"
+#endif
+
+static const std::vector<std::string>& GetHeaders() {
+  static const auto headers = std::vector<std::string>{
+      "Content-Type: application/x-protobuf",
+      "Content-Encoding: snappy",
+      "User-Agent: " PROMETHEUS_CPP_USER_AGENT,
+      "X-Prometheus-Remote-Write-Version: 0.1.0",
+  };
+  return headers;
+}
+
+RemoteWriteClient::RemoteWriteClient(const std::string& url,
+                                     const std::string& username,
+                                     const std::string& password)
+    : url_(url),
+      curlWrapper_(
+          detail::make_unique<detail::CurlWrapper>(username, password)),
+      periodic_write_(detail::make_unique<detail::PeriodicRunner>()) {}
+
+RemoteWriteClient::~RemoteWriteClient() { Stop(); }
+
+void RemoteWriteClient::RegisterCollectable(
+    const std::weak_ptr<Collectable>& collectable) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  collectables_.push_back(collectable);
+}
+
+void RemoteWriteClient::SetMaxSamplesPerSend(const std::size_t max_samples) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  max_samples_per_send_ = std::max(max_samples, std::size_t{1});
+}
+
+void RemoteWriteClient::SetMaxQueuedSamples(const std::size_t max_samples) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  max_queued_samples_ = max_samples;
+}
+
+int RemoteWriteClient::Write() {
+  std::lock_guard<std::mutex> write_lock{write_mutex_};
+
+  std::vector<std::shared_ptr<Collectable>> collectables;
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (auto& wcollectable : collectables_) {
+      auto collectable = wcollectable.lock();
+      if (collectable) {
+        collectables.push_back(std::move(collectable));
+      }
+    }
+  }
+
+  const auto now = std::chrono::system_clock::now().time_since_epoch();
+  std::deque<std::string> samples;
+  detail::TimeSeriesEncoder encoder{
+      std::chrono::duration_cast<std::chrono::milliseconds>(now).count(),
+      samples};
+  for (auto& collectable : collectables) {
+    collectable->CollectTo(encoder);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    queue_.insert(queue_.end(), std::make_move_iterator(samples.begin()),
+                  std::make_move_iterator(samples.end()));
+    trimQueue();
+  }
+
+  return send();
+}
+
+int RemoteWriteClient::send() {
+  auto status_code = 200;
+  std::deque<std::string> batch;
+  StringOutputBuffer request;
+
+  for (;;) {
+    // The batch is taken from the queue, so it is sent without the mutex
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      const auto count = std::min(queue_.size(), max_samples_per_send_);
+      if (count == 0) {
+        break;
+      }
+      const auto end = queue_.begin() + static_cast<std::ptrdiff_t>(count);
+      batch.assign(std::make_move_iterator(queue_.begin()),
+                   std::make_move_iterator(end));
+      queue_.erase(queue_.begin(), end);
+    }
+
+    request.Clear();
+    detail::EncodeWriteRequest(request, batch.begin(), batch.end());
+    const auto body =
+        detail::SnappyCompress(request.GetData(), request.GetSize());
+
+    status_code = curlWrapper_->performHttpRequest(HttpMethod::Post, url_,
+                                                   body, GetHeaders());
+    if (status_code >= 100 && status_code < 400) {
+      sent_samples_ += batch.size();
+    } else if (status_code < 100 || status_code >= 500) {
+      // Kept for the next write since the receiver might recover
+      std::lock_guard<std::mutex> lock{mutex_};
+      queue_.insert(queue_.begin(), std::make_move_iterator(batch.begin()),
+                    std::make_move_iterator(batch.end()));
+      trimQueue();
+      break;
+    } else {
+      // Rejected samples would never be accepted
+      dropped_samples_ += batch.size();
+    }
+  }
+
+  return status_code;
+}
+
+void RemoteWriteClient::trimQueue() {
+  if (queue_.size() > max_queued_samples_) {
+    const auto dropped = queue_.size() - max_queued_samples_;
+    queue_.erase(queue_.begin(),
+                 queue_.begin() + static_cast<std::ptrdiff_t>(dropped));
+    dropped_samples_ += dropped;
+  }
+}
+
+void RemoteWriteClient::Start(std::chrono::milliseconds interval) {
+  // The periodic write started before writes one last time
+  Stop();
+  periodic_write_->Start([this] { Write(); }, interval);
+}
+
+void RemoteWriteClient::Stop() { periodic_write_->Stop(true); }
+
+std::uint64_t RemoteWriteClient::GetSentSamples() const {
+  return sent_samples_;
+}
+
+std::uint64_t RemoteWriteClient::GetDroppedSamples() const {
+  return dropped_samples_;
+}
+
+std::size_t RemoteWriteClient::GetQueuedSamples() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return queue_.size();
+}
+
+}  // namespace prometheus
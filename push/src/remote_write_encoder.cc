@@ -0,0 +1,151 @@
+#include "remote_write_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "prometheus/detail/number_format.h"
+#include "prometheus/detail/protobuf_wire.h"
+
+namespace prometheus {
+namespace detail {
+
+namespace {
+
+// Field numbers of the messages in prometheus (remote.proto and types.proto)
+enum : std::uint32_t {
+  kWriteRequestTimeseries = 1,
+  kTimeSeriesLabels = 1,
+  kTimeSeriesSamples = 2,
+  kLabelName = 1,
+  kLabelValue = 2,
+  kSampleValue = 1,
+  kSampleTimestamp = 2,
+};
+
+const std::string kNameLabel = "__name__";
+
+std::string FormatLabelValue(double value) {
+  if (std::isinf(value)) {
+    return value < 0 ? "-Inf" : "+Inf";
+  }
+  if (std::isnan(value)) {
+    return "NaN";
+  }
+  char buffer[kNumberBufferSize];
+  return std::string(buffer, FormatDouble(buffer, value));
+}
+
+}  // namespace
+
+TimeSeriesEncoder::TimeSeriesEncoder(const std::int64_t timestamp_ms,
+                                     std::deque<std::string>& out)
+    : timestamp_ms_{timestamp_ms}, out_(out) {}
+
+void TimeSeriesEncoder::AddFamily(const std::string& name, const std::string&,
+                                  MetricType) {
+  name_ = name;
+}
+
+void TimeSeriesEncoder::AddMetric(const Series& series,
+                                  const ClientMetric::Counter& counter) {
+  Encode(series, "", counter.value);
+}
+
+void TimeSeriesEncoder::AddMetric(const Series& series,
+                                  const ClientMetric::Gauge& gauge) {
+  Encode(series, "", gauge.value);
+}
+
+void TimeSeriesEncoder::AddMetric(const Series& series,
+                                  const ClientMetric::Summary& summary) {
+  Encode(series, "_count", static_cast<double>(summary.sample_count));
+  Encode(series, "_sum", summary.sample_sum);
+  for (auto& q : summary.quantile) {
+    Encode(series, "", q.value, "quantile", q.quantile);
+  }
+}
+
+void TimeSeriesEncoder::AddMetric(const Series& series,
+                                  const ClientMetric::Histogram& histogram) {
+  Encode(series, "_count", static_cast<double>(histogram.sample_count));
+  Encode(series, "_sum", histogram.sample_sum);
+
+  auto last = -std::numeric_limits<double>::infinity();
+  for (auto& b : histogram.bucket) {
+    Encode(series, "_bucket", static_cast<double>(b.cumulative_count), "le",
+           b.upper_bound);
+    last = b.upper_bound;
+  }
+  if (last != std::numeric_limits<double>::infinity()) {
+    Encode(series, "_bucket", static_cast<double>(histogram.sample_count),
+           "le", std::numeric_limits<double>::infinity());
+  }
+}
+
+void TimeSeriesEncoder::AddMetric(const Series& series,
+                                  const ClientMetric::Untyped& untyped) {
+  Encode(series, "", untyped.value);
+}
+
+void TimeSeriesEncoder::Encode(const Series& series, const char* suffix,
+                               const double value, const char* extra_label,
+                               const double extra_value) {
+  name_label_ = name_;
+  name_label_ += suffix;
+
+  labels_.clear();
+  labels_.emplace_back(&kNameLabel, &name_label_);
+  for (auto& lp : series.label) {
+    labels_.emplace_back(&lp.name, &lp.value);
+  }
+  for (auto& lp : series.constant_labels) {
+    labels_.emplace_back(&lp.first, &lp.second);
+  }
+  for (auto& lp : series.labels) {
+    labels_.emplace_back(&lp.first, &lp.second);
+  }
+  if (extra_label) {
+    extra_name_ = extra_label;
+    extra_value_ = FormatLabelValue(extra_value);
+    labels_.emplace_back(&extra_name_, &extra_value_);
+  }
+  std::sort(labels_.begin(), labels_.end(),
+            [](const std::pair<const std::string*, const std::string*>& a,
+               const std::pair<const std::string*, const std::string*>& b) {
+              return *a.first < *b.first;
+            });
+
+  message_.Clear();
+  for (auto& label : labels_) {
+    WriteLengthDelimitedHead(
+        message_, kTimeSeriesLabels,
+        LengthDelimitedSize(label.first->size()) +
+            LengthDelimitedSize(label.second->size()));
+    WriteStringField(message_, kLabelName, *label.first);
+    WriteStringField(message_, kLabelValue, *label.second);
+  }
+
+  const auto timestamp_ms =
+      series.timestamp_ms != 0 ? series.timestamp_ms : timestamp_ms_;
+  WriteLengthDelimitedHead(
+      message_, kTimeSeriesSamples,
+      kDoubleFieldSize +
+          VarintFieldSize(static_cast<std::uint64_t>(timestamp_ms)));
+  WriteDoubleField(message_, kSampleValue, value);
+  WriteVarintField(message_, kSampleTimestamp,
+                   static_cast<std::uint64_t>(timestamp_ms));
+
+  out_.push_back(message_.ToString());
+}
+
+void EncodeWriteRequest(OutputBuffer& out,
+                        std::deque<std::string>::const_iterator begin,
+                        std::deque<std::string>::const_iterator end) {
+  for (auto series = begin; series != end; ++series) {
+    WriteStringField(out, kWriteRequestTimeseries, *series);
+  }
+}
+
+}  // namespace detail
+}  // namespace prometheus
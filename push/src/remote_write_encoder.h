@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "prometheus/metric_sink.h"
+#include "prometheus/output_buffer.h"
+
+namespace prometheus {
+namespace detail {
+
+/// \brief Encodes the metrics passed to it as prometheus.TimeSeries messages
+/// of the remote write protocol.
+///
+/// Every sample becomes a time series of its own with the __name__ label,
+/// e.g., a histogram becomes the series of its buckets, its sum and its
+/// count. The labels of each series are sorted by name as required by the
+/// protocol. The messages are encoded directly, so no protocol buffer
+/// library is needed.
+class TimeSeriesEncoder : public MetricSink {
+ public:
+  /// \param timestamp_ms The timestamp of samples which have none.
+  /// \param out Receives the encoded messages.
+  TimeSeriesEncoder(std::int64_t timestamp_ms, std::deque<std::string>& out);
+
+  void AddFamily(const std::string& name, const std::string& help,
+                 MetricType type) override;
+  void AddMetric(const Series& series,
+                 const ClientMetric::Counter& counter) override;
+  void AddMetric(const Series& series,
+                 const ClientMetric::Gauge& gauge) override;
+  void AddMetric(const Series& series,
+                 const ClientMetric::Summary& summary) override;
+  void AddMetric(const Series& series,
+                 const ClientMetric::Histogram& histogram) override;
+  void AddMetric(const Series& series,
+                 const ClientMetric::Untyped& untyped) override;
+
+ private:
+  void Encode(const Series& series, const char* suffix, double value,
+              const char* extra_label = nullptr, double extra_value = 0.0);
+
+  const std::int64_t timestamp_ms_;
+  std::deque<std::string>& out_;
+  std::string name_;
+  // Reused for every series
+  std::string name_label_;
+  std::string extra_name_;
+  std::string extra_value_;
+  std::vector<std::pair<const std::string*, const std::string*>> labels_;
+  StringOutputBuffer message_;
+};
+
+/// \brief Encodes a prometheus.WriteRequest of the given TimeSeries messages.
+void EncodeWriteRequest(OutputBuffer& out,
+                        std::deque<std::string>::const_iterator begin,
+                        std::deque<std::string>::const_iterator end);
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,120 @@
+#include "snappy.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "prometheus/detail/protobuf_wire.h"
+
+namespace prometheus {
+namespace detail {
+
+namespace {
+
+// Snappy never copies from further back than 64 KiB, so the input is
+// compressed in blocks of that size
+const std::size_t kBlockSize = 1 << 16;
+const int kHashBits = 14;
+const std::size_t kMinMatch = 4;
+const std::size_t kMaxCopyLength = 64;
+
+std::uint32_t Load32(const char* data) {
+  std::uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+std::uint32_t Hash(std::uint32_t bytes) {
+  return (bytes * 0x1e35a7bd) >> (32 - kHashBits);
+}
+
+void AppendLiteral(std::string& out, const char* data, std::size_t size) {
+  if (size == 0) {
+    return;
+  }
+
+  const auto n = size - 1;
+  if (n < 60) {
+    out.push_back(static_cast<char>(n << 2));
+  } else {
+    // Tags 60 to 63 are followed by the length minus one in 1 to 4 bytes
+    auto bytes = 1;
+    while (bytes < 4 && (n >> (8 * bytes)) != 0) {
+      ++bytes;
+    }
+    out.push_back(static_cast<char>((59 + bytes) << 2));
+    for (auto i = 0; i < bytes; ++i) {
+      out.push_back(static_cast<char>(n >> (8 * i)));
+    }
+  }
+  out.append(data, size);
+}
+
+void AppendCopy(std::string& out, std::size_t offset, std::size_t length) {
+  while (length > 0) {
+    const auto chunk = std::min(length, kMaxCopyLength);
+    // The shorter form takes an offset of 11 bits and a length of 4 to 11
+    if (chunk >= 4 && chunk < 12 && offset < 2048) {
+      out.push_back(static_cast<char>(1 | ((chunk - 4) << 2) |
+                                      ((offset >> 8) << 5)));
+      out.push_back(static_cast<char>(offset & 0xFF));
+    } else {
+      out.push_back(static_cast<char>(2 | ((chunk - 1) << 2)));
+      out.push_back(static_cast<char>(offset & 0xFF));
+      out.push_back(static_cast<char>(offset >> 8));
+    }
+    length -= chunk;
+  }
+}
+
+void CompressBlock(std::string& out, const char* begin, const char* end,
+                   std::vector<std::uint16_t>& table) {
+  std::fill(table.begin(), table.end(), 0);
+
+  auto literal = begin;
+  auto next = begin;
+  // Leaves room to load four bytes at every position
+  while (static_cast<std::size_t>(end - next) >= kMinMatch) {
+    const auto bytes = Load32(next);
+    auto& entry = table[Hash(bytes)];
+    const auto candidate = begin + entry;
+    entry = static_cast<std::uint16_t>(next - begin);
+
+    if (candidate >= next || Load32(candidate) != bytes) {
+      ++next;
+      continue;
+    }
+
+    auto length = kMinMatch;
+    while (next + length < end && candidate[length] == next[length]) {
+      ++length;
+    }
+
+    AppendLiteral(out, literal, static_cast<std::size_t>(next - literal));
+    AppendCopy(out, static_cast<std::size_t>(next - candidate), length);
+    next += length;
+    literal = next;
+  }
+
+  AppendLiteral(out, literal, static_cast<std::size_t>(end - literal));
+}
+
+}  // namespace
+
+std::string SnappyCompress(const char* data, const std::size_t size) {
+  std::string out;
+  out.reserve(16 + size + size / 6);
+  char length[kMaxVarintSize];
+  out.append(length, EncodeVarint(length, size));
+
+  std::vector<std::uint16_t> table(1 << kHashBits);
+  for (std::size_t offset = 0; offset < size; offset += kBlockSize) {
+    const auto block_size = std::min(kBlockSize, size - offset);
+    CompressBlock(out, data + offset, data + offset + block_size, table);
+  }
+  return out;
+}
+
+}  // namespace detail
+}  // namespace prometheus
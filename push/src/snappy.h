@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace prometheus {
+namespace detail {
+
+/// \brief Compresses data into the snappy block format.
+///
+/// Remote write receivers expect request bodies in this format. Matches are
+/// searched greedily using a hash table of four byte sequences, which gives
+/// a ratio close to the reference implementation for the repetitive label
+/// names and values of a WriteRequest.
+std::string SnappyCompress(const char* data, std::size_t size);
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,149 @@
+#include "spool.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace prometheus {
+namespace detail {
+
+static const char* GetMethodName(HttpMethod method) {
+  switch (method) {
+    case HttpMethod::Post:
+      return "POST";
+    case HttpMethod::Put:
+      return "PUT";
+    case HttpMethod::Delete:
+      return "DELETE";
+  }
+  return "";
+}
+
+static bool ParseMethodName(const std::string& name, HttpMethod& method) {
+  for (auto candidate :
+       {HttpMethod::Post, HttpMethod::Put, HttpMethod::Delete}) {
+    if (name == GetMethodName(candidate)) {
+      method = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+Spool::Spool(std::string path, const std::size_t max_bytes)
+    : path_{std::move(path)}, max_bytes_{max_bytes}, size_{0} {
+  std::ifstream in{path_, std::ios::binary | std::ios::ate};
+  if (in) {
+    const auto size = in.tellg();
+    size_ = size > 0 ? static_cast<std::size_t>(size) : 0;
+  }
+}
+
+// Each entry is a line "<method> <gzip> <body size> <uri>" followed by the
+// body
+std::string Spool::Encode(const Entry& entry) {
+  std::ostringstream out;
+  out << GetMethodName(entry.method) << ' ' << (entry.gzip ? 1 : 0) << ' '
+      << entry.body.size() << ' ' << entry.uri << '\n'
+      << entry.body;
+  return out.str();
+}
+
+std::vector<Spool::Entry> Spool::Load() const {
+  std::vector<Entry> entries;
+  std::ifstream in{path_, std::ios::binary};
+
+  std::string method;
+  int gzip;
+  std::size_t body_size;
+  while (in >> method >> gzip >> body_size && in.get() == ' ') {
+    auto entry = Entry{};
+    entry.gzip = gzip != 0;
+    entry.body.resize(body_size);
+    if (!ParseMethodName(method, entry.method) ||
+        !std::getline(in, entry.uri) ||
+        !in.read(&entry.body[0], static_cast<std::streamsize>(body_size))) {
+      // The rest of a truncated file is dropped
+      break;
+    }
+    entries.push_back(std::move(entry));
+  }
+  return entries;
+}
+
+bool Spool::Store(const std::vector<Entry>& entries) {
+  if (entries.empty()) {
+    std::remove(path_.c_str());
+    size_ = 0;
+    return true;
+  }
+
+  const auto temporary_path = path_ + ".tmp";
+  auto size = std::size_t{0};
+  {
+    std::ofstream out{temporary_path, std::ios::binary | std::ios::trunc};
+    for (auto& entry : entries) {
+      const auto encoded = Encode(entry);
+      out.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+      size += encoded.size();
+    }
+    if (!out.flush()) {
+      std::remove(temporary_path.c_str());
+      return false;
+    }
+  }
+
+  std::remove(path_.c_str());
+  if (std::rename(temporary_path.c_str(), path_.c_str()) != 0) {
+    size_ = 0;
+    return false;
+  }
+  size_ = size;
+  return true;
+}
+
+bool Spool::Add(const Entry& entry) {
+  const auto encoded = Encode(entry);
+  if (encoded.size() > max_bytes_) {
+    return false;
+  }
+
+  if (size_ + encoded.size() > max_bytes_) {
+    auto entries = Load();
+    auto size = size_;
+    auto dropped = entries.begin();
+    while (dropped != entries.end() && size + encoded.size() > max_bytes_) {
+      size -= Encode(*dropped).size();
+      ++dropped;
+    }
+    entries.erase(entries.begin(), dropped);
+    entries.push_back(entry);
+    return Store(entries);
+  }
+
+  std::ofstream out{path_, std::ios::binary | std::ios::app};
+  out.write(encoded.data(), static_cast<std::streamsize>(encoded.size()));
+  if (!out.flush()) {
+    return false;
+  }
+  size_ += encoded.size();
+  return true;
+}
+
+void Spool::Replay(const std::function<bool(const Entry&)>& send) {
+  if (IsEmpty()) {
+    return;
+  }
+
+  auto entries = Load();
+  auto sent = entries.begin();
+  while (sent != entries.end() && send(*sent)) {
+    ++sent;
+  }
+  entries.erase(entries.begin(), sent);
+  Store(entries);
+}
+
+}  // namespace detail
+}  // namespace prometheus
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "prometheus/detail/http_method.h"
+
+namespace prometheus {
+namespace detail {
+
+/// \brief A bounded queue of requests kept in a file.
+///
+/// Requests are kept across restarts of the process and are passed on in the
+/// order they were added. If the queue is full, the oldest requests are
+/// dropped.
+///
+/// The class is not thread-safe.
+class Spool {
+ public:
+  struct Entry {
+    HttpMethod method;
+    bool gzip;
+    std::string uri;
+    std::string body;
+  };
+
+  /// \param path The file holding the requests. Its directory has to exist.
+  /// \param max_bytes The maximum size of the file.
+  Spool(std::string path, std::size_t max_bytes);
+
+  /// \brief Adds a request after dropping as many of the oldest ones as
+  /// needed to stay within the maximum size.
+  ///
+  /// \return false if the request was not added because it is larger than
+  /// the maximum size or the file could not be written.
+  bool Add(const Entry& entry);
+
+  /// \brief Passes the requests to send in order and removes them until send
+  /// returns false.
+  void Replay(const std::function<bool(const Entry&)>& send);
+
+  bool IsEmpty() const { return size_ == 0; }
+
+ private:
+  std::vector<Entry> Load() const;
+  bool Store(const std::vector<Entry>& entries);
+
+  static std::string Encode(const Entry& entry);
+
+  const std::string path_;
+  const std::size_t max_bytes_;
+  std::size_t size_;
+};
+
+}  // namespace detail
+}  // namespace prometheus
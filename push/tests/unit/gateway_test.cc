@@ -0,0 +1,652 @@
+#include "prometheus/gateway.h"
+
+#include <gmock/gmock.h>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "prometheus/client_metric.h"
+#include "prometheus/collectable.h"
+#include "prometheus/gauge.h"
+#include "prometheus/metric_family.h"
+#include "prometheus/metric_sink.h"
+#include "prometheus/registry.h"
+#include "stub_gateway.h"
+
+namespace prometheus {
+namespace {
+
+using namespace testing;
+
+class GatewayTest : public testing::Test {
+ public:
+  GatewayTest()
+      : registry_{std::make_shared<Registry>()},
+        gauge_{BuildGauge()
+                   .Name("test_gauge")
+                   .Help("Test gauge")
+                   .Register(*registry_)
+                   .Add({})} {}
+
+ protected:
+  std::unique_ptr<Gateway> CreateGateway(const std::string& jobname) {
+    auto gateway = std::unique_ptr<Gateway>{
+        new Gateway{"127.0.0.1", stub_.GetPort(), jobname}};
+    gateway->RegisterCollectable(registry_);
+    gateway->SetRetryPolicy(0, std::chrono::milliseconds{1});
+    return gateway;
+  }
+
+  // Enables spooling to a directory of the test, which is empty at first
+  void EnableSpooling(Gateway& gateway, std::size_t max_bytes = 1024 * 1024) {
+    gateway.EnableSpooling(GetSpoolDirectory(), max_bytes);
+  }
+
+  const std::string& GetSpoolDirectory() {
+    if (spool_directory_.empty()) {
+      auto path = TempDir() + "/gateway_test_XXXXXX";
+      if (mkdtemp(&path[0])) {
+        spool_directory_ = path;
+      }
+    }
+    return spool_directory_;
+  }
+
+  std::vector<std::string> GetSpoolFiles() const {
+    std::vector<std::string> files;
+    if (auto dir = opendir(spool_directory_.c_str())) {
+      while (auto entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+          files.push_back(entry->d_name);
+        }
+      }
+      closedir(dir);
+    }
+    return files;
+  }
+
+  void TearDown() override {
+    if (spool_directory_.empty()) {
+      return;
+    }
+    for (const auto& file : GetSpoolFiles()) {
+      std::remove((spool_directory_ + "/" + file).c_str());
+    }
+    rmdir(spool_directory_.c_str());
+  }
+
+  StubGateway stub_;
+  std::shared_ptr<Registry> registry_;
+  Gauge& gauge_;
+  std::string spool_directory_;
+};
+
+// Streams one gauge per family and counts how often it is collected as a
+// list of families instead. The late families are only streamed from the
+// second collection on.
+class StreamingCollectable : public Collectable {
+ public:
+  StreamingCollectable(std::vector<std::string> names, std::string source,
+                       std::vector<std::string> late_names = {})
+      : names_(std::move(names)),
+        source_(std::move(source)),
+        late_names_(std::move(late_names)) {}
+
+  std::vector<MetricFamily> Collect() const override {
+    ++materialized;
+    return {};
+  }
+
+  void CollectTo(MetricSink& sink) const override {
+    static const auto no_label = std::vector<ClientMetric::Label>{};
+    static const auto no_labels = MetricSink::Labels{};
+    const auto labels = MetricSink::Labels{{"source", source_}};
+    auto gauge = ClientMetric::Gauge{};
+    gauge.value = 1.0;
+    for (const auto& name : names_) {
+      sink.AddFamily(name, "", MetricType::Gauge);
+      sink.AddMetric(MetricSink::Series{no_label, no_labels, labels, 0},
+                     gauge);
+    }
+    if (collected_++ > 0) {
+      for (const auto& name : late_names_) {
+        sink.AddFamily(name, "", MetricType::Gauge);
+        sink.AddMetric(MetricSink::Series{no_label, no_labels, labels, 0},
+                       gauge);
+      }
+    }
+  }
+
+  mutable std::atomic<int> materialized{0};
+
+ private:
+  const std::vector<std::string> names_;
+  const std::string source_;
+  const std::vector<std::string> late_names_;
+  mutable std::atomic<int> collected_{0};
+};
+
+MATCHER_P(HasValue, value, "") {
+  return arg.find("test_gauge " + std::string{value} + "\n") !=
+         std::string::npos;
+}
+
+TEST_F(GatewayTest, push) {
+  auto gateway = CreateGateway("push");
+  gauge_.Set(1);
+
+  EXPECT_EQ(200, gateway->Push());
+
+  const auto requests = stub_.GetRequests();
+  ASSERT_EQ(1u, requests.size());
+  EXPECT_EQ("POST", requests[0].method);
+  EXPECT_EQ("/metrics/job/push", requests[0].path);
+  EXPECT_THAT(requests[0].body, HasValue("1"));
+}
+
+TEST_F(GatewayTest, streamLargeRegistryInChunks) {
+  auto gateway = CreateGateway("large");
+  auto& family = BuildGauge().Name("large_gauge").Register(*registry_);
+  for (int i = 0; i < 5000; ++i) {
+    family.Add({{"series", std::to_string(i)}}).Set(i);
+  }
+
+  EXPECT_EQ(200, gateway->Push());
+
+  const auto requests = stub_.GetRequests();
+  ASSERT_EQ(1u, requests.size());
+  EXPECT_THAT(requests[0].headers, Contains("Transfer-Encoding: chunked"));
+  // The body is larger than one chunk of the upload buffer
+  EXPECT_GT(requests[0].body.size(), 64u * 1024);
+  EXPECT_THAT(requests[0].body, HasSubstr("large_gauge{series=\"0\"} 0\n"));
+  EXPECT_THAT(requests[0].body,
+              HasSubstr("large_gauge{series=\"4999\"} 4999\n"));
+  EXPECT_EQ(requests[0].body.size(), gateway->GetSerializedBytes());
+}
+
+TEST_F(GatewayTest, reuseConnection) {
+  auto gateway = CreateGateway("reuse");
+
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(200, gateway->Push());
+  }
+  EXPECT_EQ(200, gateway->PushAdd());
+  EXPECT_EQ(200, gateway->Delete());
+
+  EXPECT_EQ(7u, stub_.GetRequests().size());
+  EXPECT_EQ(1u, stub_.GetConnectionCount());
+}
+
+TEST_F(GatewayTest, pushCollectablesOfOneGroupInOneRequest) {
+  auto gateway = CreateGateway("group");
+  auto registry = std::make_shared<Registry>();
+  auto& family = BuildGauge().Name("test_gauge").Register(*registry);
+  family.Add({{"instance", "other"}}).Set(2);
+  BuildGauge().Name("other_gauge").Register(*registry).Add({}).Set(3);
+  gateway->RegisterCollectable(registry);
+  gauge_.Set(1);
+
+  EXPECT_EQ(200, gateway->Push());
+
+  const auto requests = stub_.GetRequests();
+  ASSERT_EQ(1u, requests.size());
+  const auto& body = requests[0].body;
+  EXPECT_THAT(body, HasValue("1"));
+  EXPECT_THAT(body, HasSubstr("test_gauge{instance=\"other\"} 2\n"));
+  EXPECT_THAT(body, HasSubstr("other_gauge 3\n"));
+
+  // Both series of test_gauge are part of a single family
+  const auto type = std::string{"# TYPE test_gauge gauge\n"};
+  EXPECT_EQ(body.find(type), body.rfind(type));
+}
+
+TEST_F(GatewayTest, streamCollectablesOfOneGroup) {
+  auto gateway = CreateGateway("stream_group");
+  auto a = std::make_shared<StreamingCollectable>(
+      std::vector<std::string>{"shared_gauge", "a_gauge"}, "a");
+  auto b = std::make_shared<StreamingCollectable>(
+      std::vector<std::string>{"b_gauge", "shared_gauge"}, "b");
+  gateway->RegisterCollectable(a);
+  gateway->RegisterCollectable(b);
+
+  EXPECT_EQ(200, gateway->Push());
+
+  const auto requests = stub_.GetRequests();
+  ASSERT_EQ(1u, requests.size());
+  const auto& body = requests[0].body;
+  EXPECT_THAT(body, HasSubstr("a_gauge{source=\"a\"} 1\n"));
+  EXPECT_THAT(body, HasSubstr("b_gauge{source=\"b\"} 1\n"));
+  EXPECT_THAT(body, HasSubstr("# TYPE shared_gauge gauge\n"
+                              "shared_gauge{source=\"a\"} 1\n"
+                              "shared_gauge{source=\"b\"} 1\n"));
+  const auto type = std::string{"# TYPE shared_gauge gauge\n"};
+  EXPECT_EQ(body.find(type), body.rfind(type));
+  EXPECT_EQ(0, a->materialized);
+  EXPECT_EQ(0, b->materialized);
+}
+
+TEST_F(GatewayTest, passFamiliesAddedDuringPushOnlyOnce) {
+  auto gateway = CreateGateway("late_group");
+  // streamed_gauge is streamed with a before b adds it, and merged_gauge is
+  // buffered with a before b streams it
+  auto a = std::make_shared<StreamingCollectable>(
+      std::vector<std::string>{"streamed_gauge"}, "a",
+      std::vector<std::string>{"merged_gauge"});
+  auto b = std::make_shared<StreamingCollectable>(
+      std::vector<std::string>{"merged_gauge"}, "b",
+      std::vector<std::string>{"streamed_gauge"});
+  gateway->RegisterCollectable(a);
+  gateway->RegisterCollectable(b);
+
+  EXPECT_EQ(200, gateway->Push());
+
+  const auto requests = stub_.GetRequests();
+  ASSERT_EQ(1u, requests.size());
+  const auto& body = requests[0].body;
+  for (const auto name : {"streamed_gauge", "merged_gauge"}) {
+    const auto type = "# TYPE " + std::string{name} + " gauge\n";
+    EXPECT_NE(std::string::npos, body.find(type));
+    EXPECT_EQ(body.find(type), body.rfind(type));
+  }
+  EXPECT_THAT(body, HasSubstr("# TYPE streamed_gauge gauge\n"
+                              "streamed_gauge{source=\"a\"} 1\n"));
+  EXPECT_THAT(body, Not(HasSubstr("streamed_gauge{source=\"b\"}")));
+  EXPECT_THAT(body, HasSubstr("# TYPE merged_gauge gauge\n"
+                              "merged_gauge{source=\"a\"} 1\n"
+                              "merged_gauge{source=\"b\"} 1\n"));
+}
+
+TEST_F(GatewayTest, pushGroupsInSeparateRequests) {
+  auto gateway = CreateGateway("groups");
+  auto registry = std::make_shared<Registry>();
+  BuildGauge().Name("other_gauge").Register(*registry).Add({}).Set(3);
+  const auto labels = Gateway::Labels{{"instance", "other"}};
+  gateway->RegisterCollectable(registry, &labels);
+
+  EXPECT_EQ(200, gateway->AsyncPush().get());
+
+  auto requests = stub_.GetRequests();
+  ASSERT_EQ(2u, requests.size());
+  std::sort(requests.begin(), requests.end(),
+            [](const StubGateway::Request& a, const StubGateway::Request& b) {
+              return a.path < b.path;
+            });
+  EXPECT_EQ("/metrics/job/groups", requests[0].path);
+  EXPECT_THAT(requests[0].body, Not(HasSubstr("other_gauge")));
+  EXPECT_EQ("/metrics/job/groups/instance/other", requests[1].path);
+  EXPECT_THAT(requests[1].body, HasSubstr("other_gauge 3\n"));
+}
+
+#ifdef HAVE_ZLIB
+TEST_F(GatewayTest, pushCompressed) {
+  auto gateway = CreateGateway("compressed");
+  gateway->EnableCompression();
+  gauge_.Set(1);
+
+  // Push() streams the body while AsyncPush() sends it in one piece
+  EXPECT_EQ(200, gateway->Push());
+  const auto streamed_bytes = gateway->GetSentBytes();
+  EXPECT_EQ(200, gateway->AsyncPush().get());
+
+  const auto requests = stub_.GetRequests();
+  ASSERT_EQ(2u, requests.size());
+  auto serialized_bytes = std::uint64_t{0};
+  for (const auto& request : requests) {
+    EXPECT_THAT(request.headers, Contains("Content-Encoding: gzip"));
+    const auto body = GUnzip(request.body);
+    EXPECT_THAT(body, HasValue("1"));
+    serialized_bytes += body.size();
+  }
+  EXPECT_EQ(serialized_bytes, gateway->GetSerializedBytes());
+  // The streamed body is counted with its chunk framing
+  EXPECT_GT(streamed_bytes, requests[0].body.size());
+  EXPECT_EQ(streamed_bytes + requests[1].body.size(),
+            gateway->GetSentBytes());
+}
+#endif
+
+TEST_F(GatewayTest, boundAsyncPushConcurrency) {
+  auto gateway = CreateGateway("concurrency");
+  std::vector<std::shared_ptr<Registry>> registries;
+  for (int i = 0; i < 20; ++i) {
+    registries.push_back(std::make_shared<Registry>());
+    const auto labels = Gateway::Labels{{"instance", std::to_string(i)}};
+    gateway->RegisterCollectable(registries.back(), &labels);
+  }
+  stub_.SetDelay(std::chrono::milliseconds{20});
+
+  EXPECT_EQ(200, gateway->AsyncPush().get());
+
+  // One request per group plus the one of the fixture's registry, at most
+  // eight of them at the same time
+  EXPECT_EQ(21u, stub_.GetRequests().size());
+  EXPECT_GT(stub_.GetMaxConcurrentRequests(), 1u);
+  EXPECT_LE(stub_.GetMaxConcurrentRequests(), 8u);
+  EXPECT_LE(stub_.GetConnectionCount(), 8u);
+}
+
+TEST_F(GatewayTest, reportFailedAsyncPushRequests) {
+  auto gateway = CreateGateway("async_failure");
+  std::vector<std::shared_ptr<Registry>> registries;
+  for (int i = 0; i < 3; ++i) {
+    registries.push_back(std::make_shared<Registry>());
+    const auto labels = Gateway::Labels{{"instance", std::to_string(i)}};
+    gateway->RegisterCollectable(registries.back(), &labels);
+  }
+
+  // The other requests are sent anyway
+  stub_.Fail(1, 400);
+  EXPECT_EQ(400, gateway->AsyncPush().get());
+  EXPECT_EQ(4u, stub_.GetRequests().size());
+  EXPECT_EQ(3u, stub_.GetAcceptedBodies().size());
+
+  // Asynchronous pushes are not retried
+  stub_.Fail(1, 503);
+  EXPECT_EQ(503, gateway->AsyncPush().get());
+  EXPECT_EQ(8u, stub_.GetRequests().size());
+
+  EXPECT_EQ(200, gateway->AsyncPush().get());
+}
+
+// Waits up to a few seconds for the stub to receive the given number of
+// requests
+void WaitForRequests(const StubGateway& stub, std::size_t count) {
+  for (int i = 0; i < 500 && stub.GetRequests().size() < count; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+}
+
+TEST_F(GatewayTest, pushPeriodicallyWithJitter) {
+  auto gateway = CreateGateway("periodic");
+  const auto interval = std::chrono::milliseconds{100};
+  const auto jitter = std::chrono::milliseconds{30};
+
+  const auto start = std::chrono::steady_clock::now();
+  gateway->StartPeriodicPush(interval, jitter);
+  WaitForRequests(stub_, 4);
+  gateway->StopPeriodicPush();
+
+  // Each push is sent in its own interval, the final flush right away
+  const auto requests = stub_.GetRequests();
+  ASSERT_GE(requests.size(), 5u);
+  for (std::size_t i = 0; i + 1 < requests.size(); ++i) {
+    const auto deadline = start + interval * i;
+    EXPECT_GE(requests[i].received, deadline) << i;
+    EXPECT_LT(requests[i].received,
+              deadline + jitter + std::chrono::milliseconds{50})
+        << i;
+    EXPECT_EQ("POST", requests[i].method);
+  }
+}
+
+TEST_F(GatewayTest, skipPeriodicPushWhileInFlight) {
+  auto gateway = CreateGateway("skip");
+  stub_.SetDelay(std::chrono::milliseconds{250});
+
+  gateway->StartPeriodicPush(std::chrono::milliseconds{50});
+  std::this_thread::sleep_for(std::chrono::milliseconds{600});
+  gateway->StopPeriodicPush();
+
+  // Up to three pushes fit and the final flush follows
+  EXPECT_EQ(1u, stub_.GetMaxConcurrentRequests());
+  EXPECT_LE(stub_.GetRequests().size(), 4u);
+}
+
+TEST_F(GatewayTest, flushPeriodicPushOnStop) {
+  auto gateway = CreateGateway("flush");
+  // Periodic pushes are retried like Push()
+  gateway->SetRetryPolicy(1, std::chrono::milliseconds{1});
+  stub_.Fail(1);
+
+  gateway->StartPeriodicPush(std::chrono::hours{1});
+  WaitForRequests(stub_, 2);
+  // Restarting does not flush
+  gateway->StartPeriodicPush(std::chrono::hours{1});
+  WaitForRequests(stub_, 3);
+  gauge_.Set(5);
+  gateway->StopPeriodicPush();
+  gateway->StopPeriodicPush();
+
+  EXPECT_THAT(stub_.GetAcceptedBodies(),
+              ElementsAre(HasValue("0"), HasValue("0"), HasValue("5")));
+}
+
+TEST_F(GatewayTest, retryUntilGatewayRecovers) {
+  auto gateway = CreateGateway("retry");
+  gateway->SetRetryPolicy(3, std::chrono::milliseconds{1});
+  stub_.Fail(2);
+
+  EXPECT_EQ(200, gateway->Push());
+  EXPECT_EQ(3u, stub_.GetRequests().size());
+}
+
+TEST_F(GatewayTest, retryUnreachableGateway) {
+  auto gateway = CreateGateway("unreachable");
+  gateway->SetRetryPolicy(1, std::chrono::milliseconds{1});
+  stub_.Fail(1, StubGateway::kDropConnection);
+
+  EXPECT_EQ(200, gateway->Push());
+  EXPECT_EQ(2u, stub_.GetRequests().size());
+}
+
+TEST_F(GatewayTest, giveUpAfterMaxRetries) {
+  auto gateway = CreateGateway("give_up");
+  gateway->SetRetryPolicy(2, std::chrono::milliseconds{1});
+  stub_.SetStatusCode(503);
+
+  EXPECT_EQ(503, gateway->Push());
+  EXPECT_EQ(3u, stub_.GetRequests().size());
+}
+
+TEST_F(GatewayTest, doNotRetryClientErrors) {
+  auto gateway = CreateGateway("client_error");
+  gateway->SetRetryPolicy(2, std::chrono::milliseconds{1});
+  stub_.Fail(1, 400);
+
+  EXPECT_EQ(400, gateway->Push());
+  EXPECT_EQ(1u, stub_.GetRequests().size());
+}
+
+TEST_F(GatewayTest, changeSettingsWhileRetrying) {
+  auto gateway = CreateGateway("settings");
+  gateway->SetRetryPolicy(1, std::chrono::milliseconds{500});
+  stub_.Fail(1);
+
+  auto push = std::async(std::launch::async, [&] { return gateway->Push(); });
+  WaitForRequests(stub_, 1);
+
+  // Neither waits for the backoff of the push
+  const auto start = std::chrono::steady_clock::now();
+  gateway->RegisterCollectable(std::make_shared<Registry>());
+  gateway->SetRetryPolicy(0, std::chrono::milliseconds{1});
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds{250});
+
+  EXPECT_EQ(200, push.get());
+}
+
+TEST_F(GatewayTest, replaySpooledPushesInOrder) {
+  auto gateway = CreateGateway("replay");
+  EnableSpooling(*gateway);
+  stub_.SetStatusCode(503);
+
+  gauge_.Set(1);
+  EXPECT_EQ(503, gateway->Push());
+  gauge_.Set(2);
+  EXPECT_EQ(503, gateway->PushAdd());
+
+  stub_.SetStatusCode(200);
+  gauge_.Set(3);
+  EXPECT_EQ(200, gateway->Push());
+
+  EXPECT_THAT(stub_.GetAcceptedBodies(),
+              ElementsAre(HasValue("1"), HasValue("2"), HasValue("3")));
+  const auto requests = stub_.GetRequests();
+  EXPECT_EQ("PUT", requests[requests.size() - 2].method);
+
+  EXPECT_EQ(200, gateway->Push());
+  EXPECT_EQ(4u, stub_.GetAcceptedBodies().size());
+}
+
+TEST_F(GatewayTest, spoolWhileReplayFails) {
+  auto gateway = CreateGateway("replay_fails");
+  EnableSpooling(*gateway);
+  stub_.Fail(1);
+
+  gauge_.Set(1);
+  EXPECT_EQ(503, gateway->Push());
+  stub_.Fail(1);
+  gauge_.Set(2);
+  EXPECT_EQ(503, gateway->Push());
+
+  EXPECT_EQ(200, gateway->Push());
+  EXPECT_THAT(stub_.GetAcceptedBodies(),
+              ElementsAre(HasValue("1"), HasValue("2"), HasValue("2")));
+}
+
+TEST_F(GatewayTest, dropOldestSpooledPushes) {
+  auto gateway = CreateGateway("drop_oldest");
+  // Room for one push only
+  EnableSpooling(*gateway, 200);
+  stub_.SetStatusCode(503);
+
+  gauge_.Set(1);
+  gateway->Push();
+  gauge_.Set(2);
+  gateway->Push();
+
+  stub_.SetStatusCode(200);
+  gauge_.Set(3);
+  EXPECT_EQ(200, gateway->Push());
+  EXPECT_THAT(stub_.GetAcceptedBodies(),
+              ElementsAre(HasValue("2"), HasValue("3")));
+}
+
+TEST_F(GatewayTest, replaySpoolOfPreviousProcess) {
+  {
+    auto gateway = CreateGateway("restart");
+    EnableSpooling(*gateway);
+    stub_.SetStatusCode(503);
+    gauge_.Set(1);
+    EXPECT_EQ(503, gateway->Push());
+  }
+
+  stub_.SetStatusCode(200);
+  auto gateway = CreateGateway("restart");
+  EnableSpooling(*gateway);
+  gauge_.Set(2);
+  EXPECT_EQ(200, gateway->Push());
+
+  EXPECT_THAT(stub_.GetAcceptedBodies(),
+              ElementsAre(HasValue("1"), HasValue("2")));
+}
+
+TEST_F(GatewayTest, spoolEachGroupingKeySeparately) {
+  auto gateway = CreateGateway("grouping");
+  EnableSpooling(*gateway);
+  auto other = std::unique_ptr<Gateway>{new Gateway{
+      "127.0.0.1", stub_.GetPort(), "grouping", {{"instance", "other"}}}};
+  other->RegisterCollectable(registry_);
+  EnableSpooling(*other);
+  stub_.SetStatusCode(503);
+
+  gauge_.Set(1);
+  EXPECT_EQ(503, gateway->Push());
+  gauge_.Set(2);
+  EXPECT_EQ(503, other->Push());
+  EXPECT_EQ(2u, GetSpoolFiles().size());
+
+  stub_.SetStatusCode(200);
+  gauge_.Set(3);
+  EXPECT_EQ(200, other->Push());
+
+  std::vector<std::string> paths;
+  for (const auto& request : stub_.GetRequests()) {
+    if (request.status_code == 200) {
+      paths.push_back(request.path);
+    }
+  }
+  EXPECT_THAT(paths, Each(Eq("/metrics/job/grouping/instance/other")));
+  EXPECT_THAT(stub_.GetAcceptedBodies(),
+              ElementsAre(HasValue("2"), HasValue("3")));
+}
+
+TEST_F(GatewayTest, dropSpooledPushesRejectedByGateway) {
+  auto gateway = CreateGateway("rejected");
+  EnableSpooling(*gateway);
+  stub_.Fail(1);
+
+  gauge_.Set(1);
+  EXPECT_EQ(503, gateway->Push());
+  stub_.Fail(1, 400);
+  gauge_.Set(2);
+  EXPECT_EQ(200, gateway->Push());
+  EXPECT_EQ(200, gateway->Push());
+
+  EXPECT_THAT(stub_.GetAcceptedBodies(),
+              ElementsAre(HasValue("2"), HasValue("2")));
+}
+
+TEST_F(GatewayTest, deltaPushSendsChangedFamilies) {
+  auto gateway = CreateGateway("delta");
+  BuildGauge().Name("other_gauge").Register(*registry_).Add({}).Set(3);
+  gateway->EnableDeltaPush(std::chrono::hours{1});
+
+  gauge_.Set(1);
+  EXPECT_EQ(200, gateway->PushAdd());
+  gauge_.Set(2);
+  EXPECT_EQ(200, gateway->PushAdd());
+  EXPECT_EQ(200, gateway->PushAdd());
+
+  // The first push sends all families, the last one nothing
+  const auto requests = stub_.GetRequests();
+  ASSERT_EQ(2u, requests.size());
+  EXPECT_EQ("PUT", requests[0].method);
+  EXPECT_THAT(requests[0].body, HasValue("1"));
+  EXPECT_THAT(requests[0].body, HasSubstr("other_gauge 3\n"));
+  EXPECT_EQ("POST", requests[1].method);
+  EXPECT_THAT(requests[1].body, HasValue("2"));
+  EXPECT_THAT(requests[1].body, Not(HasSubstr("other_gauge")));
+}
+
+TEST_F(GatewayTest, deltaPushSendsAllFamiliesAfterInterval) {
+  auto gateway = CreateGateway("delta_full");
+  gateway->EnableDeltaPush(std::chrono::milliseconds{0});
+
+  EXPECT_EQ(200, gateway->PushAdd());
+  EXPECT_EQ(200, gateway->PushAdd());
+
+  const auto requests = stub_.GetRequests();
+  ASSERT_EQ(2u, requests.size());
+  EXPECT_EQ("PUT", requests[0].method);
+  EXPECT_EQ("PUT", requests[1].method);
+}
+
+TEST_F(GatewayTest, deltaPushResendsFailedChanges) {
+  auto gateway = CreateGateway("delta_failed");
+  gateway->EnableDeltaPush(std::chrono::hours{1});
+  EXPECT_EQ(200, gateway->PushAdd());
+
+  gauge_.Set(2);
+  stub_.Fail(1);
+  EXPECT_EQ(503, gateway->PushAdd());
+  EXPECT_EQ(200, gateway->PushAdd());
+
+  EXPECT_THAT(stub_.GetAcceptedBodies(),
+              ElementsAre(HasValue("0"), HasValue("2")));
+}
+
+}  // namespace
+}  // namespace prometheus
@@ -0,0 +1,362 @@
+#include "prometheus/remote_write_client.h"
+
+#include <gmock/gmock.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "prometheus/counter.h"
+#include "prometheus/gauge.h"
+#include "prometheus/histogram.h"
+#include "prometheus/registry.h"
+#include "stub_gateway.h"
+
+namespace prometheus {
+namespace {
+
+using namespace testing;
+
+struct Sample {
+  std::map<std::string, std::string> labels;
+  double value;
+  std::int64_t timestamp_ms;
+};
+
+class Decoder {
+ public:
+  Decoder(const char* begin, const char* end) : next_{begin}, end_{end} {}
+
+  bool AtEnd() const { return next_ == end_; }
+
+  std::uint8_t ReadByte() {
+    if (next_ == end_) {
+      throw std::runtime_error("truncated");
+    }
+    return static_cast<std::uint8_t>(*next_++);
+  }
+
+  std::uint64_t ReadVarint() {
+    auto value = std::uint64_t{0};
+    for (auto shift = 0;; shift += 7) {
+      const auto byte = ReadByte();
+      value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        return value;
+      }
+    }
+  }
+
+  std::string ReadBytes(std::size_t size) {
+    if (static_cast<std::size_t>(end_ - next_) < size) {
+      throw std::runtime_error("truncated");
+    }
+    auto bytes = std::string(next_, size);
+    next_ += size;
+    return bytes;
+  }
+
+  std::string ReadLengthDelimited() { return ReadBytes(ReadVarint()); }
+
+  double ReadDouble() {
+    auto bits = std::uint64_t{0};
+    for (auto i = 0; i < 8; ++i) {
+      bits |= static_cast<std::uint64_t>(ReadByte()) << (8 * i);
+    }
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+ private:
+  const char* next_;
+  const char* end_;
+};
+
+std::string SnappyUncompress(const std::string& compressed) {
+  Decoder in{compressed.data(), compressed.data() + compressed.size()};
+  const auto size = in.ReadVarint();
+  std::string out;
+  while (!in.AtEnd()) {
+    const auto tag = in.ReadByte();
+    std::size_t length;
+    std::size_t offset;
+    switch (tag & 3) {
+      case 0:
+        length = tag >> 2;
+        if (length >= 60) {
+          const auto bytes = length - 59;
+          length = 0;
+          for (std::size_t i = 0; i < bytes; ++i) {
+            length |= static_cast<std::size_t>(in.ReadByte()) << (8 * i);
+          }
+        }
+        out += in.ReadBytes(length + 1);
+        continue;
+      case 1:
+        length = 4 + ((tag >> 2) & 7);
+        offset = (static_cast<std::size_t>(tag >> 5) << 8) | in.ReadByte();
+        break;
+      case 2:
+        length = 1 + (tag >> 2);
+        offset = in.ReadByte();
+        offset |= static_cast<std::size_t>(in.ReadByte()) << 8;
+        break;
+      default:
+        length = 1 + (tag >> 2);
+        offset = 0;
+        for (auto i = 0; i < 4; ++i) {
+          offset |= static_cast<std::size_t>(in.ReadByte()) << (8 * i);
+        }
+    }
+    if (offset == 0 || offset > out.size()) {
+      throw std::runtime_error("invalid offset");
+    }
+    // Copies may overlap with their own output
+    for (std::size_t i = 0; i < length; ++i) {
+      out.push_back(out[out.size() - offset]);
+    }
+  }
+  if (out.size() != size) {
+    throw std::runtime_error("invalid size");
+  }
+  return out;
+}
+
+// Decodes the TimeSeries of a prometheus.WriteRequest
+std::vector<Sample> DecodeWriteRequest(const std::string& body) {
+  const auto request = SnappyUncompress(body);
+  std::vector<Sample> samples;
+
+  Decoder in{request.data(), request.data() + request.size()};
+  while (!in.AtEnd()) {
+    EXPECT_EQ(0x0A, in.ReadByte());
+    const auto series = in.ReadLengthDelimited();
+    Decoder series_in{series.data(), series.data() + series.size()};
+    auto sample = Sample{};
+    std::string last_name;
+    while (!series_in.AtEnd()) {
+      const auto tag = series_in.ReadByte();
+      const auto message = series_in.ReadLengthDelimited();
+      Decoder message_in{message.data(), message.data() + message.size()};
+      if (tag == 0x0A) {
+        EXPECT_EQ(0x0A, message_in.ReadByte());
+        const auto name = message_in.ReadLengthDelimited();
+        EXPECT_EQ(0x12, message_in.ReadByte());
+        sample.labels[name] = message_in.ReadLengthDelimited();
+        EXPECT_LT(last_name, name) << "labels must be sorted";
+        last_name = name;
+      } else {
+        EXPECT_EQ(0x12, tag);
+        EXPECT_EQ(0x09, message_in.ReadByte());
+        sample.value = message_in.ReadDouble();
+        EXPECT_EQ(0x10, message_in.ReadByte());
+        sample.timestamp_ms =
+            static_cast<std::int64_t>(message_in.ReadVarint());
+      }
+    }
+    samples.push_back(sample);
+  }
+  return samples;
+}
+
+MATCHER_P2(IsSample, labels, value, "") {
+  return arg.labels == labels && arg.value == value;
+}
+
+class RemoteWriteClientTest : public testing::Test {
+ public:
+  RemoteWriteClientTest()
+      : registry_{std::make_shared<Registry>()},
+        client_{"http://127.0.0.1:" + stub_.GetPort() + "/api/v1/write"} {
+    client_.RegisterCollectable(registry_);
+  }
+
+ protected:
+  std::vector<Sample> GetSentSamples() {
+    std::vector<Sample> samples;
+    for (auto& body : stub_.GetAcceptedBodies()) {
+      for (auto& sample : DecodeWriteRequest(body)) {
+        samples.push_back(sample);
+      }
+    }
+    return samples;
+  }
+
+  void AddGauges(std::size_t count) {
+    auto& family = BuildGauge().Name("test_gauge").Register(*registry_);
+    for (std::size_t i = 0; i < count; ++i) {
+      family.Add({{"index", std::to_string(i)}}).Set(i);
+    }
+  }
+
+  StubGateway stub_;
+  std::shared_ptr<Registry> registry_;
+  RemoteWriteClient client_;
+};
+
+TEST_F(RemoteWriteClientTest, writeSnappyCompressedProtobuf) {
+  BuildCounter()
+      .Name("test_counter")
+      .Labels({{"zone", "a"}})
+      .Register(*registry_)
+      .Add({{"code", "200"}})
+      .Increment(3);
+
+  const auto before = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          std::chrono::system_clock::now().time_since_epoch())
+                          .count();
+  EXPECT_EQ(200, client_.Write());
+
+  const auto requests = stub_.GetRequests();
+  ASSERT_EQ(1u, requests.size());
+  EXPECT_EQ("POST", requests[0].method);
+  EXPECT_EQ("/api/v1/write", requests[0].path);
+  EXPECT_THAT(requests[0].headers,
+              IsSupersetOf({"Content-Type: application/x-protobuf",
+                            "Content-Encoding: snappy",
+                            "X-Prometheus-Remote-Write-Version: 0.1.0"}));
+  EXPECT_THAT(requests[0].headers,
+              Contains(StartsWith("User-Agent: prometheus-cpp")));
+
+  const auto samples = DecodeWriteRequest(requests[0].body);
+  ASSERT_THAT(samples, ElementsAre(IsSample(
+                           std::map<std::string, std::string>{
+                               {"__name__", "test_counter"},
+                               {"code", "200"},
+                               {"zone", "a"}},
+                           3.0)));
+  EXPECT_GE(samples[0].timestamp_ms, before);
+  EXPECT_EQ(1u, client_.GetSentSamples());
+}
+
+TEST_F(RemoteWriteClientTest, expandHistograms) {
+  BuildHistogram()
+      .Name("test_histogram")
+      .Register(*registry_)
+      .Add({}, Histogram::BucketBoundaries{1})
+      .Observe(0.5);
+
+  EXPECT_EQ(200, client_.Write());
+
+  using Labels = std::map<std::string, std::string>;
+  EXPECT_THAT(
+      GetSentSamples(),
+      UnorderedElementsAre(
+          IsSample(Labels{{"__name__", "test_histogram_count"}}, 1.0),
+          IsSample(Labels{{"__name__", "test_histogram_sum"}}, 0.5),
+          IsSample(Labels{{"__name__", "test_histogram_bucket"}, {"le", "1"}},
+                   1.0),
+          IsSample(
+              Labels{{"__name__", "test_histogram_bucket"}, {"le", "+Inf"}},
+              1.0)));
+}
+
+TEST_F(RemoteWriteClientTest, compressLargeRequests) {
+  AddGauges(5000);
+
+  EXPECT_EQ(200, client_.Write());
+
+  const auto requests = stub_.GetRequests();
+  ASSERT_EQ(10u, requests.size());
+  auto samples = GetSentSamples();
+  ASSERT_EQ(5000u, samples.size());
+  EXPECT_THAT(samples, Contains(IsSample(std::map<std::string, std::string>{
+                                            {"__name__", "test_gauge"},
+                                            {"index", "4321"}},
+                                        4321.0)));
+  EXPECT_LT(requests[0].body.size(),
+            SnappyUncompress(requests[0].body).size() / 2);
+}
+
+TEST_F(RemoteWriteClientTest, sendInBatches) {
+  AddGauges(5);
+  client_.SetMaxSamplesPerSend(2);
+
+  EXPECT_EQ(200, client_.Write());
+
+  EXPECT_EQ(3u, stub_.GetRequests().size());
+  EXPECT_EQ(5u, GetSentSamples().size());
+  EXPECT_EQ(5u, client_.GetSentSamples());
+}
+
+TEST_F(RemoteWriteClientTest, keepSamplesWhileReceiverIsDown) {
+  AddGauges(2);
+  stub_.SetStatusCode(503);
+
+  EXPECT_EQ(503, client_.Write());
+  EXPECT_EQ(503, client_.Write());
+  EXPECT_EQ(4u, client_.GetQueuedSamples());
+
+  stub_.SetStatusCode(200);
+  EXPECT_EQ(200, client_.Write());
+  EXPECT_EQ(6u, GetSentSamples().size());
+  EXPECT_EQ(0u, client_.GetQueuedSamples());
+}
+
+TEST_F(RemoteWriteClientTest, dropOldestSamplesIfQueueIsFull) {
+  AddGauges(2);
+  client_.SetMaxQueuedSamples(3);
+  stub_.SetStatusCode(503);
+
+  client_.Write();
+  client_.Write();
+  EXPECT_EQ(3u, client_.GetQueuedSamples());
+  EXPECT_EQ(1u, client_.GetDroppedSamples());
+}
+
+TEST_F(RemoteWriteClientTest, dropRejectedSamples) {
+  AddGauges(4);
+  client_.SetMaxSamplesPerSend(2);
+  stub_.Fail(1, 400);
+
+  EXPECT_EQ(200, client_.Write());
+  EXPECT_EQ(2u, client_.GetDroppedSamples());
+  EXPECT_EQ(2u, client_.GetSentSamples());
+}
+
+TEST_F(RemoteWriteClientTest, registerCollectablesWhileSending) {
+  AddGauges(1);
+  stub_.SetDelay(std::chrono::milliseconds{500});
+
+  auto write =
+      std::async(std::launch::async, [this] { return client_.Write(); });
+  for (auto i = 0; i < 500 && stub_.GetRequests().empty(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+
+  // Neither waits for the request in flight
+  const auto start = std::chrono::steady_clock::now();
+  client_.RegisterCollectable(std::make_shared<Registry>());
+  EXPECT_EQ(0u, client_.GetQueuedSamples());
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds{250});
+
+  EXPECT_EQ(200, write.get());
+  EXPECT_EQ(1u, client_.GetSentSamples());
+}
+
+TEST_F(RemoteWriteClientTest, writePeriodically) {
+  AddGauges(1);
+
+  client_.Start(std::chrono::milliseconds{10});
+  for (auto i = 0; i < 500 && stub_.GetRequests().size() < 2; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{10});
+  }
+  client_.Stop();
+
+  const auto requests = stub_.GetRequests().size();
+  EXPECT_LE(3u, requests);
+  client_.Stop();
+  EXPECT_EQ(requests, stub_.GetRequests().size());
+}
+
+}  // namespace
+}  // namespace prometheus
@@ -0,0 +1,288 @@
+#include "stub_gateway.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace prometheus {
+
+constexpr int StubGateway::kDropConnection;
+
+namespace {
+
+class Reader {
+ public:
+  explicit Reader(int connection) : connection_{connection} {}
+
+  bool ReadLine(std::string& line) {
+    line.clear();
+    for (;;) {
+      const auto end = buffer_.find("\r\n");
+      if (end != std::string::npos) {
+        line = buffer_.substr(0, end);
+        buffer_.erase(0, end + 2);
+        return true;
+      }
+      if (!Fill()) {
+        return false;
+      }
+    }
+  }
+
+  bool Read(std::size_t size, std::string& data) {
+    while (buffer_.size() < size) {
+      if (!Fill()) {
+        return false;
+      }
+    }
+    data.append(buffer_, 0, size);
+    buffer_.erase(0, size);
+    return true;
+  }
+
+ private:
+  bool Fill() {
+    char data[4096];
+    const auto size = ::recv(connection_, data, sizeof(data), 0);
+    if (size <= 0) {
+      return false;
+    }
+    buffer_.append(data, static_cast<std::size_t>(size));
+    return true;
+  }
+
+  int connection_;
+  std::string buffer_;
+};
+
+bool StartsWithIgnoringCase(const std::string& str, const std::string& prefix) {
+  if (str.size() < prefix.size()) {
+    return false;
+  }
+  for (std::size_t i = 0; i < prefix.size(); ++i) {
+    if (std::tolower(str[i]) != std::tolower(prefix[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ReadRequest(Reader& reader, StubGateway::Request& request) {
+  std::string line;
+  if (!reader.ReadLine(line)) {
+    return false;
+  }
+  const auto method_end = line.find(' ');
+  const auto path_end = line.find(' ', method_end + 1);
+  request.method = line.substr(0, method_end);
+  request.path = line.substr(method_end + 1, path_end - method_end - 1);
+
+  auto content_length = std::size_t{0};
+  auto chunked = false;
+  while (reader.ReadLine(line) && !line.empty()) {
+    request.headers.push_back(line);
+    if (StartsWithIgnoringCase(line, "Content-Length:")) {
+      content_length = std::strtoul(line.c_str() + 15, nullptr, 10);
+    } else if (StartsWithIgnoringCase(line,
+                                      "Transfer-Encoding: chunked")) {
+      chunked = true;
+    }
+  }
+
+  if (!chunked) {
+    return reader.Read(content_length, request.body);
+  }
+  for (;;) {
+    if (!reader.ReadLine(line)) {
+      return false;
+    }
+    const auto size = std::strtoul(line.c_str(), nullptr, 16);
+    if (size == 0) {
+      // Skips the trailers
+      while (reader.ReadLine(line) && !line.empty()) {
+      }
+      return true;
+    }
+    if (!reader.Read(size, request.body) || !reader.ReadLine(line)) {
+      return false;
+    }
+  }
+}
+
+}  // namespace
+
+StubGateway::StubGateway()
+    : status_code_{200},
+      delay_{0},
+      concurrent_requests_{0},
+      max_concurrent_requests_{0} {
+  socket_ = ::socket(AF_INET, SOCK_STREAM, 0);
+  auto address = sockaddr_in{};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  auto address_size = socklen_t{sizeof(address)};
+  if (socket_ < 0 ||
+      ::bind(socket_, reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) != 0 ||
+      ::listen(socket_, 16) != 0 ||
+      ::getsockname(socket_, reinterpret_cast<sockaddr*>(&address),
+                    &address_size) != 0) {
+    throw std::runtime_error("cannot listen");
+  }
+  port_ = ntohs(address.sin_port);
+  acceptor_ = std::thread{&StubGateway::Accept, this};
+}
+
+StubGateway::~StubGateway() {
+  ::shutdown(socket_, SHUT_RDWR);
+  acceptor_.join();
+  ::close(socket_);
+
+  {
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (auto connection : connections_) {
+      ::shutdown(connection, SHUT_RDWR);
+    }
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  for (auto connection : connections_) {
+    ::close(connection);
+  }
+}
+
+std::string StubGateway::GetPort() const { return std::to_string(port_); }
+
+void StubGateway::Fail(const std::size_t count, const int status_code) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  scripted_status_codes_.insert(scripted_status_codes_.end(), count,
+                                status_code);
+}
+
+void StubGateway::SetStatusCode(const int status_code) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  status_code_ = status_code;
+}
+
+void StubGateway::SetDelay(const std::chrono::milliseconds delay) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  delay_ = delay;
+}
+
+std::vector<StubGateway::Request> StubGateway::GetRequests() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return requests_;
+}
+
+std::vector<std::string> StubGateway::GetAcceptedBodies() const {
+  std::vector<std::string> bodies;
+  for (auto& request : GetRequests()) {
+    if (request.status_code == 200) {
+      bodies.push_back(request.body);
+    }
+  }
+  return bodies;
+}
+
+std::size_t StubGateway::GetConnectionCount() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return connections_.size();
+}
+
+std::size_t StubGateway::GetMaxConcurrentRequests() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return max_concurrent_requests_;
+}
+
+int StubGateway::NextStatusCode() {
+  if (scripted_status_codes_.empty()) {
+    return status_code_;
+  }
+  const auto status_code = scripted_status_codes_.front();
+  scripted_status_codes_.pop_front();
+  return status_code;
+}
+
+void StubGateway::Accept() {
+  for (;;) {
+    const auto connection = ::accept(socket_, nullptr, nullptr);
+    if (connection < 0) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock{mutex_};
+    connections_.push_back(connection);
+    threads_.emplace_back(&StubGateway::Serve, this, connection);
+  }
+}
+
+void StubGateway::Serve(const int connection) {
+  Reader reader{connection};
+  for (;;) {
+    auto request = Request{};
+    if (!ReadRequest(reader, request)) {
+      break;
+    }
+    request.received = std::chrono::steady_clock::now();
+
+    auto delay = std::chrono::milliseconds{};
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      request.status_code = NextStatusCode();
+      requests_.push_back(request);
+      delay = delay_;
+      max_concurrent_requests_ =
+          std::max(max_concurrent_requests_, ++concurrent_requests_);
+    }
+    std::this_thread::sleep_for(delay);
+    {
+      std::lock_guard<std::mutex> lock{mutex_};
+      --concurrent_requests_;
+    }
+    if (request.status_code == kDropConnection) {
+      break;
+    }
+
+    const auto response = "HTTP/1.1 " + std::to_string(request.status_code) +
+                          " Stub\r\nContent-Length: 0\r\n\r\n";
+    ::send(connection, response.data(), response.size(), MSG_NOSIGNAL);
+  }
+  ::shutdown(connection, SHUT_RDWR);
+}
+
+#ifdef HAVE_ZLIB
+std::string GUnzip(const std::string& data) {
+  z_stream stream{};
+  if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+    return {};
+  }
+
+  std::string result;
+  char buffer[16 * 1024];
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  int ret;
+  do {
+    stream.next_out = reinterpret_cast<Bytef*>(buffer);
+    stream.avail_out = sizeof(buffer);
+    ret = inflate(&stream, Z_NO_FLUSH);
+    result.append(buffer, sizeof(buffer) - stream.avail_out);
+  } while (ret == Z_OK);
+  inflateEnd(&stream);
+  return ret == Z_STREAM_END ? result : std::string{};
+}
+#endif
+
+}  // namespace prometheus
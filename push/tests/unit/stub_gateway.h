@@ -0,0 +1,86 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace prometheus {
+
+/// \brief A minimal HTTP server standing in for a pushgateway.
+///
+/// It records all requests and answers them with the status codes scripted
+/// by the test, so that it can flap between failing and accepting pushes.
+class StubGateway {
+ public:
+  struct Request {
+    std::string method;
+    std::string path;
+    std::vector<std::string> headers;
+    std::string body;
+    int status_code;
+    std::chrono::steady_clock::time_point received;
+  };
+
+  /// \brief Status code which closes the connection without an answer.
+  static constexpr int kDropConnection = 0;
+
+  /// \brief Listens on a free port of the loopback interface.
+  StubGateway();
+  ~StubGateway();
+
+  StubGateway(const StubGateway&) = delete;
+  StubGateway& operator=(const StubGateway&) = delete;
+
+  std::string GetPort() const;
+
+  /// \brief Answers the next count requests with the given status code.
+  void Fail(std::size_t count, int status_code = 503);
+
+  /// \brief Answers all requests with the given status code, 200 by default.
+  void SetStatusCode(int status_code);
+
+  /// \brief Waits for the given time before answering each request.
+  void SetDelay(std::chrono::milliseconds delay);
+
+  std::vector<Request> GetRequests() const;
+
+  /// \brief Returns the bodies of the requests answered with 200.
+  std::vector<std::string> GetAcceptedBodies() const;
+
+  /// \brief Returns the number of connections accepted so far.
+  std::size_t GetConnectionCount() const;
+
+  /// \brief Returns the most requests waiting for their answer at the same
+  /// time so far.
+  std::size_t GetMaxConcurrentRequests() const;
+
+ private:
+  void Accept();
+  void Serve(int connection);
+  int NextStatusCode();
+
+  int socket_;
+  int port_;
+  mutable std::mutex mutex_;
+  std::deque<int> scripted_status_codes_;
+  int status_code_;
+  std::chrono::milliseconds delay_;
+  std::size_t concurrent_requests_;
+  std::size_t max_concurrent_requests_;
+  std::vector<Request> requests_;
+  std::vector<int> connections_;
+  std::vector<std::thread> threads_;
+  std::thread acceptor_;
+};
+
+#ifdef HAVE_ZLIB
+/// \brief Returns the decompressed gzip data, or an empty string if the data
+/// is not complete and valid gzip.
+std::string GUnzip(const std::string& data);
+#endif
+
+}  // namespace prometheus